@@ -0,0 +1,158 @@
+#include "hpet.h"
+#include "vga.h"
+#include "../kernel/acpi/acpi.h"
+#include "../kernel/mm/paging.h"
+#include "../kernel/arch/x86_64/cpu.h"
+#include "../kernel/arch/x86_64/interrupts.h"
+
+static volatile uint8_t* hpet_base = 0;
+static uint64_t hpet_caps = 0;
+static uint32_t period_fs = 0;
+static uint64_t ns_per_tick = 0;   // 32.32 fixed point
+static uint64_t ticks_per_ns = 0;  // 32.32 fixed point
+static uint8_t event_enabled = 0;
+
+static inline uint64_t hpet_reg_read(uint32_t reg) {
+    return *(volatile uint64_t*)(hpet_base + reg);
+}
+
+static inline void hpet_reg_write(uint32_t reg, uint64_t value) {
+    *(volatile uint64_t*)(hpet_base + reg) = value;
+}
+
+// Locate the HPET and start its main counter
+int hpet_init(void) {
+    if (hpet_base) {
+        return 0;
+    }
+    
+    const acpi_hpet_t* table = 0;
+    if (acpi_init() == 0) {
+        table = (const acpi_hpet_t*)acpi_find_table("HPET");
+    }
+    if (!table || table->address.space_id != ACPI_GAS_MEMORY || !table->address.address) {
+        return -1;
+    }
+    
+    paging_map_mmio(table->address.address, 0x1000);
+    volatile uint8_t* base = (volatile uint8_t*)table->address.address;
+    uint64_t caps = *(volatile uint64_t*)(base + HPET_REG_CAP);
+    uint32_t period = HPET_CAP_PERIOD(caps);
+    
+    if (period == 0 || period > HPET_MAX_PERIOD_FS || !(caps & HPET_CAP_COUNTER_64)) {
+        vga_print("[HPET] Unusable (bad period or 32-bit counter)\n", VGA_COLOR_LIGHT_BROWN);
+        return -1;
+    }
+    
+    hpet_base = base;
+    hpet_caps = caps;
+    period_fs = period;
+    ns_per_tick = ((uint64_t)period << 32) / 1000000;
+    ticks_per_ns = (1000000ULL << 32) / period;
+    
+    // Every comparator off, then restart the counter from zero
+    hpet_reg_write(HPET_REG_CONFIG, 0);
+    for (uint32_t n = 0; n < HPET_CAP_TIMERS(caps); n++) {
+        uint64_t config = hpet_reg_read(HPET_REG_TIMER_CONFIG(n));
+        hpet_reg_write(HPET_REG_TIMER_CONFIG(n), config & ~(HPET_TIMER_ENABLE | HPET_TIMER_PERIODIC));
+    }
+    hpet_reg_write(HPET_REG_COUNTER, 0);
+    hpet_reg_write(HPET_REG_CONFIG, HPET_CONFIG_ENABLE);
+    
+    vga_print("[HPET] ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int((int32_t)(1000000000000ULL / period), VGA_COLOR_LIGHT_CYAN);
+    vga_print(" kHz, ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(HPET_CAP_TIMERS(caps), VGA_COLOR_LIGHT_CYAN);
+    vga_print(" comparators", VGA_COLOR_LIGHT_GREEN);
+    vga_print((caps & HPET_CAP_LEGACY) ? ", legacy route\n" : "\n", VGA_COLOR_LIGHT_GREEN);
+    
+    return 0;
+}
+
+int hpet_available(void) {
+    return hpet_base != 0;
+}
+
+uint64_t hpet_read(void) {
+    return hpet_reg_read(HPET_REG_COUNTER);
+}
+
+uint32_t hpet_period_fs(void) {
+    return period_fs;
+}
+
+uint64_t hpet_ticks_to_ns(uint64_t ticks) {
+    return (uint64_t)(((unsigned __int128)ticks * ns_per_tick) >> 32);
+}
+
+uint64_t hpet_ns_to_ticks(uint64_t ns) {
+    return (uint64_t)(((unsigned __int128)ns * ticks_per_ns) >> 32);
+}
+
+// Busy-wait on the main counter - one MMIO read per poll, no port I/O
+void hpet_delay_us(uint32_t us) {
+    uint64_t start = hpet_read();
+    uint64_t ticks = hpet_ns_to_ticks((uint64_t)us * 1000);
+    
+    while (hpet_read() - start < ticks) {
+        cpu_relax();
+    }
+}
+
+int hpet_event_available(void) {
+    return hpet_base && (hpet_caps & HPET_CAP_LEGACY);
+}
+
+// Route timer 0 to IRQ0 in place of the PIT
+void hpet_event_enable(void) {
+    if (!hpet_event_available() || event_enabled) {
+        return;
+    }
+    
+    uint64_t flags = irq_save();
+    
+    // Edge-triggered one-shot, armed by hpet_event_program()
+    uint64_t config = hpet_reg_read(HPET_REG_TIMER_CONFIG(0));
+    config &= ~(HPET_TIMER_LEVEL | HPET_TIMER_PERIODIC | HPET_TIMER_32BIT | HPET_TIMER_ENABLE);
+    hpet_reg_write(HPET_REG_TIMER_CONFIG(0), config);
+    hpet_reg_write(HPET_REG_CONFIG, HPET_CONFIG_ENABLE | HPET_CONFIG_LEGACY);
+    event_enabled = 1;
+    
+    irq_restore(flags);
+}
+
+// Arm timer 0
+void hpet_event_program(uint64_t delta_ns) {
+    uint64_t delta = hpet_ns_to_ticks(delta_ns);
+    if (delta < HPET_MIN_DELTA) {
+        delta = HPET_MIN_DELTA;
+    }
+    
+    uint64_t config = hpet_reg_read(HPET_REG_TIMER_CONFIG(0));
+    hpet_reg_write(HPET_REG_TIMER_CONFIG(0), config | HPET_TIMER_ENABLE);
+    
+    // The comparator only matches going forward: if the counter already
+    // passed it while we were writing, try again further out
+    for (;;) {
+        uint64_t target = hpet_read() + delta;
+        hpet_reg_write(HPET_REG_TIMER_CMP(0), target);
+        if ((int64_t)(target - hpet_read()) > 0) {
+            return;
+        }
+        delta *= 2;
+    }
+}
+
+// Stop timer 0 and hand IRQ0 back
+void hpet_event_disable(void) {
+    if (!event_enabled) {
+        return;
+    }
+    
+    uint64_t flags = irq_save();
+    uint64_t config = hpet_reg_read(HPET_REG_TIMER_CONFIG(0));
+    hpet_reg_write(HPET_REG_TIMER_CONFIG(0), config & ~HPET_TIMER_ENABLE);
+    hpet_reg_write(HPET_REG_CONFIG, HPET_CONFIG_ENABLE);
+    event_enabled = 0;
+    irq_restore(flags);
+}
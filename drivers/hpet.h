@@ -0,0 +1,69 @@
+#ifndef HPET_H
+#define HPET_H
+
+#include <stdint.h>
+
+// Register offsets (memory-mapped, 64-bit)
+#define HPET_REG_CAP         0x000  // General capabilities and ID
+#define HPET_REG_CONFIG      0x010  // General configuration
+#define HPET_REG_INT_STATUS  0x020  // General interrupt status
+#define HPET_REG_COUNTER     0x0F0  // Main counter
+#define HPET_REG_TIMER_CONFIG(n) (0x100 + 0x20 * (n))
+#define HPET_REG_TIMER_CMP(n)    (0x108 + 0x20 * (n))
+
+// Capabilities
+#define HPET_CAP_TIMERS(cap) ((((cap) >> 8) & 0x1F) + 1)
+#define HPET_CAP_COUNTER_64  (1ULL << 13)
+#define HPET_CAP_LEGACY      (1ULL << 15)   // Legacy replacement route
+#define HPET_CAP_PERIOD(cap) ((uint32_t)((cap) >> 32))  // Femtoseconds per count
+
+// General configuration
+#define HPET_CONFIG_ENABLE   (1ULL << 0)    // Main counter runs
+#define HPET_CONFIG_LEGACY   (1ULL << 1)    // Timer 0 -> IRQ0, timer 1 -> IRQ8
+
+// Timer configuration
+#define HPET_TIMER_LEVEL     (1ULL << 1)
+#define HPET_TIMER_ENABLE    (1ULL << 2)    // Interrupt on comparator match
+#define HPET_TIMER_PERIODIC  (1ULL << 3)
+#define HPET_TIMER_32BIT     (1ULL << 8)
+
+// Longest valid counter period allowed by the specification (100 ns)
+#define HPET_MAX_PERIOD_FS   100000000U
+
+// Shortest one-shot interval (counts) - a comparator written in the
+// past would only match after the counter wraps
+#define HPET_MIN_DELTA       64
+
+// Find the HPET through ACPI, map its registers and start the main
+// counter. Returns 0 on success, -1 if there is none (or only a 32-bit
+// counter, which would wrap every few minutes).
+int hpet_init(void);
+
+// Check whether the main counter is running
+int hpet_available(void);
+
+// Main counter (64-bit, monotonic)
+uint64_t hpet_read(void);
+
+// Counter period in femtoseconds
+uint32_t hpet_period_fs(void);
+
+// Convert between counter ticks and nanoseconds
+uint64_t hpet_ticks_to_ns(uint64_t ticks);
+uint64_t hpet_ns_to_ticks(uint64_t ns);
+
+// Busy-wait on the main counter (works with interrupts disabled)
+void hpet_delay_us(uint32_t us);
+
+// Timer 0 as a one-shot event device on IRQ0 (legacy replacement
+// route, taking the line over from the PIT)
+int hpet_event_available(void);
+void hpet_event_enable(void);
+
+// Fire once, delta_ns from now (clamped to HPET_MIN_DELTA)
+void hpet_event_program(uint64_t delta_ns);
+
+// Disarm timer 0 and give IRQ0 back to the PIT
+void hpet_event_disable(void);
+
+#endif // HPET_H
@@ -1,5 +1,8 @@
 #include "keyboard.h"
 #include "../kernel/arch/x86_64/interrupts.h"
+#include "../kernel/sync/waitqueue.h"
+#include "../kernel/irq/softirq.h"
+#include "../kernel/irq/irqdesc.h"
 
 // US QWERTY keyboard layout (scancode set 1)
 static const char keyboard_us[128] = {
@@ -63,6 +66,18 @@ static char kb_buffer[KB_BUFFER_SIZE];
 static volatile uint16_t kb_buffer_read = 0;
 static volatile uint16_t kb_buffer_write = 0;
 
+// Readers blocked in keyboard_getchar() (its lock also guards the buffer)
+static wait_queue_t kb_waiters = WAIT_QUEUE_INIT;
+
+// Raw scancodes from the IRQ handler, translated by the tasklet
+// (one producer, one consumer: the tasklet never runs twice at once)
+static volatile uint8_t kb_scancodes[KB_SCANCODE_RING];
+static volatile uint16_t kb_scancode_head = 0;
+static volatile uint16_t kb_scancode_tail = 0;
+
+static void keyboard_bottom_half(uint64_t data);
+static tasklet_t kb_tasklet = TASKLET_INIT(keyboard_bottom_half, 0);
+
 // Add character to keyboard buffer
 static void kb_buffer_add(char c) {
     uint16_t next_write = (kb_buffer_write + 1) % KB_BUFFER_SIZE;
@@ -83,12 +98,30 @@ void keyboard_init(void) {
     while (inb(KB_STATUS_PORT) & KB_STATUS_OUTPUT_FULL) {
         inb(KB_DATA_PORT);
     }
+    
+    request_irq(KB_IRQ, keyboard_handler, 0, NULL);
 }
 
-// Keyboard interrupt handler (IRQ1)
-void keyboard_handler(void) {
+// Keyboard interrupt handler (IRQ1): only fetch the scancode, the
+// tasklet does the rest with interrupts enabled
+int keyboard_handler(uint8_t irq, void* dev) {
+    (void)irq;
+    (void)dev;
     uint8_t scancode = inb(KB_DATA_PORT);
     
+    uint16_t head = kb_scancode_head;
+    uint16_t next = (head + 1) % KB_SCANCODE_RING;
+    if (next != __atomic_load_n(&kb_scancode_tail, __ATOMIC_ACQUIRE)) {
+        kb_scancodes[head] = scancode;
+        __atomic_store_n(&kb_scancode_head, next, __ATOMIC_RELEASE);
+    }
+    
+    tasklet_schedule(&kb_tasklet);
+    return IRQ_HANDLED;
+}
+
+// Update modifier state and translate one scancode (0: no character)
+static char keyboard_translate(uint8_t scancode) {
     // Check if key release (bit 7 set)
     if (scancode & 0x80) {
         // Key released
@@ -108,26 +141,40 @@ void keyboard_handler(void) {
         // Update modifier keys
         if (scancode == KEY_LSHIFT || scancode == KEY_RSHIFT) {
             shift_pressed = 1;
-            return;
+            return 0;
         } else if (scancode == KEY_LCTRL) {
             ctrl_pressed = 1;
-            return;
+            return 0;
         } else if (scancode == KEY_LALT) {
             alt_pressed = 1;
-            return;
+            return 0;
         }
         
         // Convert scancode to ASCII
-        char c = 0;
         if (shift_pressed) {
-            c = keyboard_us_shifted[scancode];
-        } else {
-            c = keyboard_us[scancode];
+            return keyboard_us_shifted[scancode];
         }
+        return keyboard_us[scancode];
+    }
+    return 0;
+}
+
+// Keyboard tasklet: translate queued scancodes and wake readers
+static void keyboard_bottom_half(uint64_t data) {
+    (void)data;
+    
+    uint16_t tail = kb_scancode_tail;
+    while (tail != __atomic_load_n(&kb_scancode_head, __ATOMIC_ACQUIRE)) {
+        char c = keyboard_translate(kb_scancodes[tail]);
+        tail = (tail + 1) % KB_SCANCODE_RING;
+        __atomic_store_n(&kb_scancode_tail, tail, __ATOMIC_RELEASE);
         
         // Add to buffer if valid character
         if (c != 0) {
+            uint64_t flags = spin_lock_irqsave(&kb_waiters.lock);
             kb_buffer_add(c);
+            wake_up_one_locked(&kb_waiters);
+            spin_unlock_irqrestore(&kb_waiters.lock, flags);
         }
     }
 }
@@ -137,15 +184,28 @@ int keyboard_has_input(void) {
     return kb_buffer_read != kb_buffer_write;
 }
 
+// Take one character out of the buffer (kb_waiters.lock held)
+static int kb_buffer_take(char* c) {
+    if (!keyboard_has_input()) {
+        return 0;
+    }
+    *c = kb_buffer[kb_buffer_read];
+    kb_buffer_read = (kb_buffer_read + 1) % KB_BUFFER_SIZE;
+    return 1;
+}
+
 // Read character from keyboard buffer (blocking)
 char keyboard_getchar(void) {
-    // Wait for input
-    while (!keyboard_has_input()) {
-        __asm__ volatile("hlt");
+    char c = 0;
+    
+    // Before the scheduler runs there is no process to block
+    if (!get_current_process()) {
+        while (!keyboard_has_input()) {
+            __asm__ volatile("hlt");
+        }
     }
     
-    // Read from buffer
-    char c = kb_buffer[kb_buffer_read];
-    kb_buffer_read = (kb_buffer_read + 1) % KB_BUFFER_SIZE;
+    // Sleep on the wait queue until the IRQ handler queues a character
+    wait_event(&kb_waiters, kb_buffer_take(&c));
     return c;
 }
@@ -8,6 +8,9 @@
 #define KB_STATUS_PORT  0x64
 #define KB_COMMAND_PORT 0x64
 
+// ISA interrupt line
+#define KB_IRQ 1
+
 // Keyboard status flags
 #define KB_STATUS_OUTPUT_FULL 0x01
 #define KB_STATUS_INPUT_FULL  0x02
@@ -26,12 +29,14 @@
 
 // Keyboard buffer size
 #define KB_BUFFER_SIZE 256
+// Scancodes the IRQ handler can queue before the tasklet runs
+#define KB_SCANCODE_RING 64
 
-// Initialize keyboard driver
+// Initialize keyboard driver (attaches the handler to KB_IRQ)
 void keyboard_init(void);
 
-// Keyboard interrupt handler
-void keyboard_handler(void);
+// Keyboard interrupt handler (queues the scancode, translation runs in a tasklet)
+int keyboard_handler(uint8_t irq, void* dev);
 
 // Read a character from keyboard buffer (blocking)
 char keyboard_getchar(void);
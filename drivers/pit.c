@@ -4,24 +4,151 @@
 // Global tick counter
 static volatile uint64_t timer_ticks = 0;
 
+// One-shot (tickless) state
+static uint8_t periodic_mode = 1;      // Counter is reloading every tick
+static uint8_t oneshot_active = 0;     // A one-shot countdown is pending
+static uint32_t oneshot_ticks = 0;     // Ticks the pending countdown represents
+static uint32_t oneshot_cycles = 0;    // Cycles loaded into the counter
+static uint32_t carry_cycles = 0;      // Cycles already elapsed into the current tick
+static uint8_t skip_next_irq = 0;      // Pending interrupt was already accounted for
+
 // PIT interrupt handler (called from IRQ0)
-void pit_handler(void) {
-    timer_ticks++;
-    // Note: Preemption now handled in preempt_handler() called from assembly
+uint64_t pit_handler(void) {
+    uint64_t elapsed = 1;
+    
+    // Cancelled one-shot that had already fired - its ticks were credited
+    if (skip_next_irq) {
+        skip_next_irq = 0;
+        return 0;
+    }
+    
+    // A one-shot covers several ticks at once; the PIT then sits idle
+    // until the scheduler programs the next event
+    if (oneshot_active) {
+        elapsed = oneshot_ticks;
+        oneshot_active = 0;
+    }
+    
+    timer_ticks += elapsed;
+    return elapsed;
 }
 
 // Initialize the PIT
 void pit_init(void) {
-    // Calculate divisor for desired frequency
-    uint32_t divisor = PIT_FREQUENCY / TIMER_FREQUENCY;
+    periodic_mode = 1;
+    oneshot_active = 0;
+    skip_next_irq = 0;
+    carry_cycles = 0;
     
     // Send command byte: Channel 0, Mode 3 (square wave), binary mode
     // Command format: 00 (Channel 0) 11 (lobyte/hibyte) 011 (square wave) 0 (binary)
     outb(PIT_COMMAND, 0x36);
     
     // Send frequency divisor (low byte, then high byte)
-    outb(PIT_CHANNEL0, divisor & 0xFF);
-    outb(PIT_CHANNEL0, (divisor >> 8) & 0xFF);
+    outb(PIT_CHANNEL0, PIT_TICK_DIVISOR & 0xFF);
+    outb(PIT_CHANNEL0, (PIT_TICK_DIVISOR >> 8) & 0xFF);
+}
+
+// Switch back to a fixed tick
+void pit_set_periodic(void) {
+    if (periodic_mode) {
+        return;  // Already ticking - avoid the port writes
+    }
+    
+    oneshot_active = 0;
+    carry_cycles = 0;
+    periodic_mode = 1;
+    outb(PIT_COMMAND, 0x36);
+    outb(PIT_CHANNEL0, PIT_TICK_DIVISOR & 0xFF);
+    outb(PIT_CHANNEL0, (PIT_TICK_DIVISOR >> 8) & 0xFF);
+}
+
+// Program a single interrupt some ticks from now
+void pit_set_oneshot(uint32_t ticks) {
+    if (ticks == 0) {
+        ticks = 1;
+    }
+    if (ticks > PIT_MAX_ONESHOT_TICKS) {
+        ticks = PIT_MAX_ONESHOT_TICKS;
+    }
+    
+    // Subtract the part of the current tick that already passed so the
+    // interrupt still lands on a tick boundary
+    uint32_t cycles = ticks * PIT_TICK_DIVISOR - carry_cycles;
+    carry_cycles = 0;
+    
+    // Command format: 00 (Channel 0) 11 (lobyte/hibyte) 000 (interrupt on terminal count) 0 (binary)
+    outb(PIT_COMMAND, 0x30);
+    outb(PIT_CHANNEL0, cycles & 0xFF);
+    outb(PIT_CHANNEL0, (cycles >> 8) & 0xFF);
+    
+    oneshot_ticks = ticks;
+    oneshot_cycles = cycles;
+    oneshot_active = 1;
+    periodic_mode = 0;
+}
+
+// Cancel a pending one-shot and account for the time already spent
+uint64_t pit_cancel_oneshot(void) {
+    if (!oneshot_active) {
+        return 0;
+    }
+    
+    // Latch and read the current count of channel 0
+    outb(PIT_COMMAND, 0x00);
+    uint16_t count = inb(PIT_CHANNEL0);
+    count |= (uint16_t)inb(PIT_CHANNEL0) << 8;
+    
+    // Counter already ran out: the interrupt is pending, so credit the
+    // whole interval now and have the handler ignore it
+    if (count > oneshot_cycles || count == 0) {
+        oneshot_active = 0;
+        carry_cycles = 0;
+        skip_next_irq = 1;
+        timer_ticks += oneshot_ticks;
+        return oneshot_ticks;
+    }
+    
+    uint32_t elapsed = (PIT_TICK_DIVISOR * oneshot_ticks - oneshot_cycles) + (oneshot_cycles - count);
+    uint64_t ticks = elapsed / PIT_TICK_DIVISOR;
+    
+    oneshot_active = 0;
+    carry_cycles = elapsed % PIT_TICK_DIVISOR;
+    timer_ticks += ticks;
+    
+    return ticks;
+}
+
+// Advance the global tick count
+void pit_credit_ticks(uint64_t ticks) {
+    timer_ticks += ticks;
+}
+
+// Busy-wait on channel 2 - independent of channel 0 and of interrupts
+void pit_delay_us(uint32_t us) {
+    uint64_t total = ((uint64_t)PIT_FREQUENCY * us) / 1000000;
+    
+    while (total > 0) {
+        uint32_t count = total > 0xFFFF ? 0xFFFF : (uint32_t)total;
+        total -= count;
+        
+        // Gate on, speaker off
+        uint8_t port61 = (inb(0x61) & ~0x02) | 0x01;
+        outb(0x61, port61 & ~0x01);
+        
+        // Command format: 10 (Channel 2) 11 (lobyte/hibyte) 000 (interrupt on terminal count) 0 (binary)
+        outb(PIT_COMMAND, 0xB0);
+        outb(PIT_CHANNEL2, count & 0xFF);
+        outb(PIT_CHANNEL2, (count >> 8) & 0xFF);
+        
+        // Rising gate edge starts the countdown
+        outb(0x61, port61);
+        
+        // Output (bit 5) goes high at terminal count
+        while (!(inb(0x61) & 0x20)) {
+            __asm__ volatile("pause");
+        }
+    }
 }
 
 // Get current tick count
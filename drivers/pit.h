@@ -15,11 +15,18 @@
 // Target timer frequency (Hz) - 100 Hz = 10ms per tick
 #define TIMER_FREQUENCY 100
 
+// PIT input cycles per tick
+#define PIT_TICK_DIVISOR (PIT_FREQUENCY / TIMER_FREQUENCY)
+
+// Longest one-shot interval the 16-bit counter can hold (in ticks)
+#define PIT_MAX_ONESHOT_TICKS (0xFFFF / PIT_TICK_DIVISOR)
+
 // Initialize the PIT timer
 void pit_init(void);
 
 // PIT interrupt handler (called from IRQ0)
-void pit_handler(void);
+// Returns the number of ticks that elapsed since the previous timer interrupt
+uint64_t pit_handler(void);
 
 // Get the current tick count
 uint64_t pit_get_ticks(void);
@@ -27,4 +34,22 @@ uint64_t pit_get_ticks(void);
 // Sleep for a specified number of ticks
 void pit_sleep(uint64_t ticks);
 
+// Fire an interrupt every tick (no-op if already periodic)
+void pit_set_periodic(void);
+
+// Fire a single interrupt after the given number of ticks
+// (clamped to 1..PIT_MAX_ONESHOT_TICKS, stays aligned to the tick grid)
+void pit_set_oneshot(uint32_t ticks);
+
+// Advance the global tick count on behalf of another tick source
+// (used once a local APIC timer replaces the PIT interrupt)
+void pit_credit_ticks(uint64_t ticks);
+
+// Busy-wait using channel 2 (works with interrupts disabled)
+void pit_delay_us(uint32_t us);
+
+// Stop a pending one-shot early and credit the whole ticks elapsed so far
+// Returns the ticks credited (0 if no one-shot was pending)
+uint64_t pit_cancel_oneshot(void);
+
 #endif // PIT_H
@@ -0,0 +1,63 @@
+// serial.c - 16550 UART (COM1) driver implementation
+
+#include "serial.h"
+#include "../kernel/arch/x86_64/interrupts.h"
+#include "../kernel/sync/spinlock.h"
+
+static uint8_t serial_initialized = 0;
+static spinlock_t serial_lock = SPINLOCK_INIT_NAMED("serial");  // Keeps lines whole
+
+// Initialize COM1
+void serial_init(void) {
+    outb(SERIAL_COM1 + SERIAL_INT_ENABLE, 0x00);   // No UART interrupts
+    outb(SERIAL_COM1 + SERIAL_LINE_CTRL, 0x80);    // DLAB on to set the divisor
+    outb(SERIAL_COM1 + SERIAL_DATA, SERIAL_DIVISOR & 0xFF);
+    outb(SERIAL_COM1 + SERIAL_INT_ENABLE, (SERIAL_DIVISOR >> 8) & 0xFF);
+    outb(SERIAL_COM1 + SERIAL_LINE_CTRL, 0x03);    // 8 bits, no parity, 1 stop
+    outb(SERIAL_COM1 + SERIAL_FIFO_CTRL, 0xC7);    // FIFOs on, cleared, 14-byte threshold
+    outb(SERIAL_COM1 + SERIAL_MODEM_CTRL, 0x03);   // DTR + RTS
+    
+    serial_initialized = 1;
+}
+
+int serial_ready(void) {
+    return serial_initialized;
+}
+
+// Wait for room in the transmit register (lock held)
+static void serial_putchar_locked(char c) {
+    while (!(inb(SERIAL_COM1 + SERIAL_LINE_STATUS) & SERIAL_LSR_THRE)) {
+        cpu_relax();
+    }
+    outb(SERIAL_COM1 + SERIAL_DATA, (uint8_t)c);
+}
+
+// Write a character (newline becomes CR LF)
+void serial_putchar(char c) {
+    if (!serial_initialized) {
+        return;
+    }
+    
+    uint64_t flags = spin_lock_irqsave(&serial_lock);
+    if (c == '\n') {
+        serial_putchar_locked('\r');
+    }
+    serial_putchar_locked(c);
+    spin_unlock_irqrestore(&serial_lock, flags);
+}
+
+// Write a string as one unit
+void serial_print(const char* str) {
+    if (!serial_initialized) {
+        return;
+    }
+    
+    uint64_t flags = spin_lock_irqsave(&serial_lock);
+    for (int i = 0; str[i] != '\0'; i++) {
+        if (str[i] == '\n') {
+            serial_putchar_locked('\r');
+        }
+        serial_putchar_locked(str[i]);
+    }
+    spin_unlock_irqrestore(&serial_lock, flags);
+}
@@ -0,0 +1,35 @@
+// serial.h - 16550 UART (COM1) driver header
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+
+// COM1 I/O base
+#define SERIAL_COM1 0x3F8
+
+// Baud rate divisor (115200 / divisor)
+#define SERIAL_DIVISOR 1
+
+// Register offsets from the I/O base
+#define SERIAL_DATA        0  // Data (DLAB=0) / divisor low (DLAB=1)
+#define SERIAL_INT_ENABLE  1  // Interrupt enable / divisor high (DLAB=1)
+#define SERIAL_FIFO_CTRL   2
+#define SERIAL_LINE_CTRL   3
+#define SERIAL_MODEM_CTRL  4
+#define SERIAL_LINE_STATUS 5
+
+// Line status: transmit holding register empty
+#define SERIAL_LSR_THRE 0x20
+
+// Initialize COM1 (8N1, FIFOs on, interrupts off)
+void serial_init(void);
+
+// Nonzero once serial_init() has run
+int serial_ready(void);
+
+// Write a character / string (blocking, polled)
+void serial_putchar(char c);
+void serial_print(const char* str);
+
+#endif // SERIAL_H
@@ -1,10 +1,13 @@
 // vga.c - VGA text mode driver implementation
 
 #include "vga.h"
+#include "../kernel/arch/x86_64/interrupts.h"
+#include "../kernel/sync/spinlock.h"
 
 static uint16_t* vga_buffer = (uint16_t*)VGA_MEMORY;
 static uint8_t cursor_x = 0;
 static uint8_t cursor_y = 0;
+static spinlock_t vga_lock = SPINLOCK_INIT_NAMED("vga");  // Cursor is shared by all CPUs
 
 // Make a VGA entry (character + color)
 static inline uint16_t vga_entry(char c, vga_color_t fg, vga_color_t bg) {
@@ -47,8 +50,8 @@ static void vga_scroll(void) {
     cursor_y = VGA_HEIGHT - 1;
 }
 
-// Put a character on screen
-void vga_putchar(char c, vga_color_t color) {
+// Put a character on screen (vga_lock held)
+static void vga_putchar_locked(char c, vga_color_t color) {
     if (c == '\n') {
         cursor_x = 0;
         cursor_y++;
@@ -83,6 +86,13 @@ void vga_putchar(char c, vga_color_t color) {
     }
 }
 
+// Put a character on screen
+void vga_putchar(char c, vga_color_t color) {
+    uint64_t flags = spin_lock_irqsave(&vga_lock);
+    vga_putchar_locked(c, color);
+    spin_unlock_irqrestore(&vga_lock, flags);
+}
+
 // Print a string
 void vga_print(const char* str, vga_color_t color) {
     for (int i = 0; str[i] != '\0'; i++) {
@@ -0,0 +1,207 @@
+// ACPI table discovery (RSDP -> RSDT/XSDT -> MADT)
+
+#include "acpi.h"
+#include "../boot/multiboot2.h"
+#include "../mm/paging.h"
+#include "../../drivers/vga.h"
+#include <stddef.h>
+
+static const acpi_rsdp_t* rsdp = NULL;
+static const acpi_sdt_header_t* root_table = NULL;  // RSDT or XSDT
+static int root_is_xsdt = 0;
+static int acpi_ready = 0;
+static acpi_madt_info_t madt_info;
+
+// Compare a 4-byte table signature
+static int sig_equal(const char* a, const char* b, int n) {
+    for (int i = 0; i < n; i++) {
+        if (a[i] != b[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Sum bytes - valid ACPI structures sum to zero
+static uint8_t checksum(const void* data, uint32_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        sum += p[i];
+    }
+    return sum;
+}
+
+// Map a table (header first, then its full length)
+static const acpi_sdt_header_t* map_table(uint64_t phys) {
+    if (!phys) {
+        return NULL;
+    }
+    paging_identity_map(phys, sizeof(acpi_sdt_header_t), 0);
+    const acpi_sdt_header_t* table = (const acpi_sdt_header_t*)phys;
+    paging_identity_map(phys, table->length, 0);
+    return table;
+}
+
+// Scan a memory range for the RSDP signature (16-byte aligned)
+static const acpi_rsdp_t* scan_rsdp(uint64_t start, uint64_t end) {
+    for (uint64_t addr = start; addr + 20 <= end; addr += 16) {
+        const acpi_rsdp_t* candidate = (const acpi_rsdp_t*)addr;
+        if (sig_equal(candidate->signature, "RSD PTR ", 8) &&
+            checksum(candidate, 20) == 0) {
+            return candidate;
+        }
+    }
+    return NULL;
+}
+
+// Find the RSDP: bootloader copy first, then the BIOS areas
+static const acpi_rsdp_t* find_rsdp(void) {
+    const acpi_rsdp_t* found = (const acpi_rsdp_t*)multiboot2_get_rsdp();
+    if (found) {
+        return found;
+    }
+    
+    // Extended BIOS Data Area (segment stored at 0x40E). The address is
+    // loaded from a volatile so GCC cannot fold it into a constant and
+    // flag the low address as an out-of-bounds object.
+    volatile uintptr_t ebda_ptr = 0x40E;
+    uint64_t ebda = (uint64_t)(*(volatile const uint16_t*)ebda_ptr) << 4;
+    if (ebda) {
+        found = scan_rsdp(ebda, ebda + 1024);
+        if (found) {
+            return found;
+        }
+    }
+    
+    // Main BIOS area
+    return scan_rsdp(0xE0000, 0x100000);
+}
+
+// Record the interrupt topology described by the MADT
+static void parse_madt(const acpi_madt_t* madt) {
+    madt_info.lapic_address = madt->lapic_address;
+    madt_info.legacy_pic = madt->flags & 0x01;
+    
+    const uint8_t* entry = madt->entries;
+    const uint8_t* end = (const uint8_t*)madt + madt->header.length;
+    
+    while (entry + 2 <= end && entry[1] >= 2) {
+        uint8_t type = entry[0];
+        uint8_t len = entry[1];
+        
+        switch (type) {
+            case MADT_TYPE_LAPIC: {
+                uint8_t apic_id = entry[3];
+                uint32_t flags = *(const uint32_t*)(entry + 4);
+                if ((flags & (MADT_LAPIC_ENABLED | MADT_LAPIC_ONLINE_CAPABLE)) &&
+                    madt_info.cpu_count < ACPI_MAX_CPUS) {
+                    madt_info.cpu_apic_ids[madt_info.cpu_count++] = apic_id;
+                }
+                break;
+            }
+            
+            case MADT_TYPE_IOAPIC:
+                if (madt_info.ioapic_count < ACPI_MAX_IOAPICS) {
+                    acpi_ioapic_t* io = &madt_info.ioapics[madt_info.ioapic_count++];
+                    io->id = entry[2];
+                    io->address = *(const uint32_t*)(entry + 4);
+                    io->gsi_base = *(const uint32_t*)(entry + 8);
+                }
+                break;
+                
+            case MADT_TYPE_OVERRIDE:
+                if (madt_info.override_count < ACPI_MAX_OVERRIDES) {
+                    acpi_override_t* ov = &madt_info.overrides[madt_info.override_count++];
+                    ov->irq = entry[3];
+                    ov->gsi = *(const uint32_t*)(entry + 4);
+                    ov->flags = *(const uint16_t*)(entry + 8);
+                }
+                break;
+                
+            case MADT_TYPE_LAPIC_ADDRESS:
+                madt_info.lapic_address = *(const uint64_t*)(entry + 4);
+                break;
+                
+            default:
+                break;
+        }
+        
+        entry += len;
+    }
+}
+
+// Locate ACPI tables
+int acpi_init(void) {
+    if (acpi_ready) {
+        return 0;
+    }
+    
+    rsdp = find_rsdp();
+    if (!rsdp) {
+        vga_print("[ACPI] No RSDP found\n", VGA_COLOR_LIGHT_RED);
+        return -1;
+    }
+    
+    if (rsdp->revision >= 2 && rsdp->xsdt_address) {
+        root_table = map_table(rsdp->xsdt_address);
+        root_is_xsdt = 1;
+    } else {
+        root_table = map_table(rsdp->rsdt_address);
+        root_is_xsdt = 0;
+    }
+    
+    if (!root_table || checksum(root_table, root_table->length) != 0) {
+        vga_print("[ACPI] Invalid root table\n", VGA_COLOR_LIGHT_RED);
+        root_table = NULL;
+        return -1;
+    }
+    
+    acpi_ready = 1;
+    
+    const acpi_madt_t* madt = (const acpi_madt_t*)acpi_find_table("APIC");
+    if (madt) {
+        parse_madt(madt);
+    }
+    
+    vga_print("[ACPI] ", VGA_COLOR_LIGHT_GREEN);
+    vga_print(root_is_xsdt ? "XSDT" : "RSDT", VGA_COLOR_LIGHT_GREEN);
+    vga_print(" found, CPUs: ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(madt_info.cpu_count, VGA_COLOR_LIGHT_CYAN);
+    vga_print(", I/O APICs: ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(madt_info.ioapic_count, VGA_COLOR_LIGHT_CYAN);
+    vga_print("\n", VGA_COLOR_WHITE);
+    
+    return 0;
+}
+
+// Find a table by signature
+const acpi_sdt_header_t* acpi_find_table(const char* signature) {
+    if (!root_table) {
+        return NULL;
+    }
+    
+    uint32_t entry_size = root_is_xsdt ? 8 : 4;
+    uint32_t count = (root_table->length - sizeof(acpi_sdt_header_t)) / entry_size;
+    const uint8_t* entries = (const uint8_t*)root_table + sizeof(acpi_sdt_header_t);
+    
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t phys = root_is_xsdt ? *(const uint64_t*)(entries + i * 8)
+                                     : *(const uint32_t*)(entries + i * 4);
+        const acpi_sdt_header_t* table = map_table(phys);
+        if (table && sig_equal(table->signature, signature, 4) &&
+            checksum(table, table->length) == 0) {
+            return table;
+        }
+    }
+    
+    return NULL;
+}
+
+// Get MADT summary
+const acpi_madt_info_t* acpi_get_madt_info(void) {
+    if (!acpi_ready || madt_info.cpu_count == 0) {
+        return NULL;
+    }
+    return &madt_info;
+}
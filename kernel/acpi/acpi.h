@@ -0,0 +1,113 @@
+#ifndef KERNEL_ACPI_ACPI_H
+#define KERNEL_ACPI_ACPI_H
+
+#include <stdint.h>
+
+// Limits for the MADT summary
+#define ACPI_MAX_CPUS     16
+#define ACPI_MAX_IOAPICS  4
+#define ACPI_MAX_OVERRIDES 16
+
+// Root System Description Pointer
+typedef struct {
+    char signature[8];         // "RSD PTR "
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;          // 0 = ACPI 1.0, 2 = ACPI 2.0+
+    uint32_t rsdt_address;
+    // ACPI 2.0+ fields
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} __attribute__((packed)) acpi_rsdp_t;
+
+// Common header of every system description table
+typedef struct {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_sdt_header_t;
+
+// Multiple APIC Description Table
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t lapic_address;
+    uint32_t flags;
+    uint8_t entries[0];
+} __attribute__((packed)) acpi_madt_t;
+
+// Generic Address Structure
+typedef struct {
+    uint8_t space_id;          // 0 = system memory, 1 = system I/O
+    uint8_t bit_width;
+    uint8_t bit_offset;
+    uint8_t access_size;
+    uint64_t address;
+} __attribute__((packed)) acpi_gas_t;
+
+// High Precision Event Timer description table ("HPET")
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t event_timer_block_id;  // Copy of the capabilities register bits 0-31
+    acpi_gas_t address;        // Register block
+    uint8_t hpet_number;
+    uint16_t min_tick;         // Smallest periodic interval without lost interrupts
+    uint8_t page_protection;
+} __attribute__((packed)) acpi_hpet_t;
+
+#define ACPI_GAS_MEMORY 0
+
+// MADT entry types
+#define MADT_TYPE_LAPIC           0
+#define MADT_TYPE_IOAPIC          1
+#define MADT_TYPE_OVERRIDE        2
+#define MADT_TYPE_LAPIC_ADDRESS   5
+
+// MADT local APIC flags
+#define MADT_LAPIC_ENABLED        0x01
+#define MADT_LAPIC_ONLINE_CAPABLE 0x02
+
+// I/O APIC found in the MADT
+typedef struct {
+    uint8_t id;
+    uint32_t address;
+    uint32_t gsi_base;
+} acpi_ioapic_t;
+
+// ISA interrupt source override (ISA IRQ -> global system interrupt)
+typedef struct {
+    uint8_t irq;
+    uint32_t gsi;
+    uint16_t flags;            // Polarity (bits 0-1) and trigger mode (bits 2-3)
+} acpi_override_t;
+
+// Interrupt topology summarised from the MADT
+typedef struct {
+    uint64_t lapic_address;
+    uint32_t cpu_count;
+    uint8_t cpu_apic_ids[ACPI_MAX_CPUS];
+    uint32_t ioapic_count;
+    acpi_ioapic_t ioapics[ACPI_MAX_IOAPICS];
+    uint32_t override_count;
+    acpi_override_t overrides[ACPI_MAX_OVERRIDES];
+    uint8_t legacy_pic;        // PC-AT compatible 8259 pair present
+} acpi_madt_info_t;
+
+// Locate the RSDP and parse the MADT (safe to call more than once)
+// Returns 0 on success, -1 if no usable ACPI tables were found
+int acpi_init(void);
+
+// Find a system description table by signature (NULL if missing)
+const acpi_sdt_header_t* acpi_find_table(const char* signature);
+
+// Get the parsed MADT summary (NULL if ACPI is unavailable)
+const acpi_madt_info_t* acpi_get_madt_info(void);
+
+#endif // KERNEL_ACPI_ACPI_H
@@ -0,0 +1,109 @@
+; ap_trampoline.asm - Application processor startup code
+; Copied to AP_TRAMPOLINE_BASE by smp_init(); each AP starts here in real
+; mode after a STARTUP IPI and climbs to long mode on the BSP's page tables
+
+AP_TRAMPOLINE_BASE equ 0x8000
+
+; Address of a trampoline label once copied to AP_TRAMPOLINE_BASE
+%define TRAMP(label) (AP_TRAMPOLINE_BASE + (label - ap_trampoline_start))
+
+; Selectors in the trampoline GDT (0x08/0x10 match the kernel's gdt64)
+TRAMP_CODE64 equ 0x08
+TRAMP_DATA   equ 0x10
+TRAMP_CODE32 equ 0x18
+TRAMP_DATA32 equ 0x20
+
+global ap_trampoline_start
+global ap_trampoline_end
+global ap_trampoline_cr3
+global ap_trampoline_stack
+global ap_trampoline_cpu
+global ap_trampoline_entry
+
+section .text
+bits 16
+ap_trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+    
+    ; Load the temporary GDT and enter protected mode
+    lgdt [TRAMP(tramp_gdt_pointer)]
+    mov eax, cr0
+    or eax, 1
+    mov cr0, eax
+    jmp TRAMP_CODE32:TRAMP(ap_protected_mode)
+
+bits 32
+ap_protected_mode:
+    mov ax, TRAMP_DATA32
+    mov ds, ax
+    mov es, ax
+    mov ss, ax
+    
+    ; Enable PAE
+    mov eax, cr4
+    or eax, 1 << 5
+    mov cr4, eax
+    
+    ; Share the BSP's page tables
+    mov eax, [TRAMP(ap_trampoline_cr3)]
+    mov cr3, eax
+    
+    ; Enable long mode
+    mov ecx, 0xC0000080
+    rdmsr
+    or eax, 1 << 8
+    wrmsr
+    
+    ; Enable paging
+    mov eax, cr0
+    or eax, 1 << 31
+    mov cr0, eax
+    
+    jmp TRAMP_CODE64:TRAMP(ap_long_mode)
+
+bits 64
+ap_long_mode:
+    mov ax, TRAMP_DATA
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+    
+    ; Per-AP boot stack and per-CPU data pointer filled in by smp_init()
+    mov rsp, [TRAMP(ap_trampoline_stack)]
+    mov rdi, [TRAMP(ap_trampoline_cpu)]
+    mov rax, [TRAMP(ap_trampoline_entry)]
+    call rax
+    
+    ; ap_main() never returns
+.hang:
+    cli
+    hlt
+    jmp .hang
+
+align 8
+tramp_gdt:
+    dq 0                                        ; Null descriptor
+    dq (1<<43) | (1<<44) | (1<<47) | (1<<53)    ; 0x08: 64-bit code
+    dq (1<<44) | (1<<47) | (1<<41)              ; 0x10: data
+    dq 0x00CF9A000000FFFF                       ; 0x18: 32-bit code (flat)
+    dq 0x00CF92000000FFFF                       ; 0x20: 32-bit data (flat)
+tramp_gdt_pointer:
+    dw tramp_gdt_pointer - tramp_gdt - 1
+    dd TRAMP(tramp_gdt)
+
+; Parameters written by smp_init() before each STARTUP IPI
+align 8
+ap_trampoline_cr3:
+    dq 0
+ap_trampoline_stack:
+    dq 0
+ap_trampoline_cpu:
+    dq 0
+ap_trampoline_entry:
+    dq 0
+ap_trampoline_end:
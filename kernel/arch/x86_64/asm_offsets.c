@@ -0,0 +1,33 @@
+// Structure offsets for the assembly code.
+//
+// Never linked: the Makefile compiles this file to assembly and turns
+// every "->NAME value" marker into "%define NAME value" in
+// asm_offsets.inc, so NASM sources follow the C layout automatically.
+
+#include <stddef.h>
+#include "../../proc/process.h"
+#include "../../proc/syscall.h"
+#include "percpu.h"
+
+#define DEFINE(sym, val) \
+    __asm__ volatile("\n.ascii \"->" #sym " %c0\"" : : "i"(val))
+
+void asm_offsets(void);
+
+void asm_offsets(void) {
+    // process_t
+    DEFINE(PROCESS_CONTEXT_RSP, offsetof(process_t, context.rsp));
+    
+    // cpu_t
+    DEFINE(CPU_KERNEL_RSP, offsetof(cpu_t, kernel_rsp));
+    DEFINE(CPU_USER_RSP, offsetof(cpu_t, user_rsp));
+    DEFINE(CPU_IRQ_STACK, offsetof(cpu_t, irq_stack));
+    DEFINE(CPU_PREEMPT_COUNT, offsetof(cpu_t, preempt_count));
+    DEFINE(CPU_NEED_RESCHED, offsetof(cpu_t, need_resched));
+    DEFINE(CPU_USER_CYCLES, offsetof(cpu_t, sched.user_cycles));
+    DEFINE(CPU_USER_ENTRY, offsetof(cpu_t, sched.user_entry));
+    
+    // System call table
+    DEFINE(SYSCALL_COUNT, SYS_COUNT);
+    DEFINE(SYSCALL_ENOSYS, SYSCALL_ENOSYS);
+}
@@ -0,0 +1,126 @@
+#ifndef KERNEL_ARCH_X86_64_CPU_H
+#define KERNEL_ARCH_X86_64_CPU_H
+
+#include <stdint.h>
+
+// Model-specific registers
+#define MSR_IA32_APIC_BASE    0x1B
+#define MSR_IA32_TSC_DEADLINE 0x6E0
+#define MSR_EFER              0xC0000080
+#define MSR_STAR              0xC0000081    // SYSCALL/SYSRET segment bases
+#define MSR_LSTAR             0xC0000082    // SYSCALL entry point (64-bit)
+#define MSR_SFMASK            0xC0000084    // RFLAGS bits cleared by SYSCALL
+#define MSR_FS_BASE           0xC0000100
+#define MSR_GS_BASE           0xC0000101
+#define MSR_KERNEL_GS_BASE    0xC0000102
+
+// EFER bits
+#define EFER_SCE              (1ULL << 0)   // SYSCALL/SYSRET enabled
+
+// RFLAGS bits
+#define RFLAGS_RESERVED       0x2           // Always set
+#define RFLAGS_TF             0x100         // Single-step trap
+#define RFLAGS_IF             0x200         // Interrupts enabled
+#define RFLAGS_DF             0x400         // String ops count down
+#define RFLAGS_NT             0x4000        // Nested task
+#define RFLAGS_AC             0x40000       // Alignment check (SMAP override)
+
+// Segment selectors (per-CPU GDT, gdt.c). SYSRET takes the user SS and
+// CS from STAR as base + 8 and base + 16, hence user data before user code.
+#define GDT_KERNEL_CODE       0x08
+#define GDT_KERNEL_DATA       0x10
+#define GDT_USER_DATA         0x18
+#define GDT_USER_CODE         0x20
+#define GDT_TSS               0x28          // 16-byte system descriptor
+#define GDT_RPL_USER          3
+
+// Control register bits
+#define CR0_MP                (1ULL << 1)   // Monitor coprocessor (WAIT honours TS)
+#define CR0_EM                (1ULL << 2)   // x87 emulation (must be clear)
+#define CR0_TS                (1ULL << 3)   // Task switched: next FPU/SIMD use traps (#NM)
+#define CR0_NE                (1ULL << 5)   // Native x87 error reporting
+#define CR4_OSFXSR            (1ULL << 9)   // FXSAVE/FXRSTOR and SSE enabled
+#define CR4_OSXMMEXCPT        (1ULL << 10)  // Unmasked SIMD exceptions raise #XM
+#define CR4_OSXSAVE           (1ULL << 18)  // XSAVE family and XCR0 enabled
+
+// Read a model-specific register
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Write a model-specific register
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+// Execute CPUID for a leaf/subleaf
+static inline void cpuid(uint32_t leaf, uint32_t subleaf,
+                         uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    __asm__ volatile("cpuid"
+                     : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                     : "a"(leaf), "c"(subleaf));
+}
+
+static inline uint64_t read_cr0(void) {
+    uint64_t value;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr0(uint64_t value) {
+    __asm__ volatile("mov %0, %%cr0" : : "r"(value) : "memory");
+}
+
+static inline uint64_t read_cr4(void) {
+    uint64_t value;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr4(uint64_t value) {
+    __asm__ volatile("mov %0, %%cr4" : : "r"(value) : "memory");
+}
+
+// Write an extended control register (XCR0 selects the XSAVE components)
+static inline void xsetbv(uint32_t xcr, uint64_t value) {
+    __asm__ volatile("xsetbv" : : "c"(xcr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+// Clear CR0.TS (FPU/SIMD instructions stop trapping)
+static inline void clts(void) {
+    __asm__ volatile("clts" : : : "memory");
+}
+
+// Read the time-stamp counter
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Drop the TLB entry of one page on the executing CPU
+static inline void invlpg(uint64_t addr) {
+    __asm__ volatile("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+// Page fault error code bits (#PF pushes them, CR2 holds the address)
+#define PF_ERR_PRESENT (1 << 0)   // Protection violation, not a missing page
+#define PF_ERR_WRITE   (1 << 1)
+#define PF_ERR_USER    (1 << 2)
+#define PF_ERR_RSVD    (1 << 3)   // Reserved bit set in an entry
+#define PF_ERR_FETCH   (1 << 4)   // Instruction fetch
+
+static inline uint64_t read_cr2(void) {
+    uint64_t value;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(value));
+    return value;
+}
+
+// Spin-wait hint
+static inline void cpu_relax(void) {
+    __asm__ volatile("pause" : : : "memory");
+}
+
+#endif // KERNEL_ARCH_X86_64_CPU_H
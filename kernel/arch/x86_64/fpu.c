@@ -0,0 +1,245 @@
+// Lazy FPU/SSE/AVX state management (see fpu.h)
+
+#include "fpu.h"
+#include "cpu.h"
+#include "percpu.h"
+#include "../../mm/kheap.h"
+#include "../../proc/process.h"
+#include "../../../drivers/vga.h"
+
+#define FPU_ALIGN 64                 // XSAVE areas must be 64-byte aligned
+#define FXSAVE_SIZE 512
+#define FPU_INIT_FCW 0x037F          // x87 control word after FNINIT
+#define FPU_INIT_MXCSR 0x1F80        // All SIMD exceptions masked
+
+// CPUID feature bits
+#define CPUID_1_ECX_XSAVE (1U << 26)
+#define CPUID_1_ECX_AVX   (1U << 28)
+#define CPUID_D1_EAX_XSAVEOPT (1U << 0)
+
+typedef enum {
+    FPU_FXSAVE = 0,                  // Legacy 512-byte area (x87 + SSE)
+    FPU_XSAVE,
+    FPU_XSAVEOPT                     // XSAVE that skips unmodified components
+} fpu_mode_t;
+
+static fpu_mode_t fpu_mode = FPU_FXSAVE;
+static uint64_t xfeatures = 0;
+static uint32_t state_size = 0;
+static uint8_t fpu_configured = 0;
+
+#if FPU_BENCH
+static volatile uint64_t bench_traps = 0;
+static volatile uint64_t bench_saves = 0;
+#endif
+
+static inline void fpu_save(void* area) {
+    uint32_t lo = (uint32_t)xfeatures;
+    uint32_t hi = (uint32_t)(xfeatures >> 32);
+
+    switch (fpu_mode) {
+        case FPU_XSAVEOPT:
+            __asm__ volatile("xsaveopt64 (%0)" : : "r"(area), "a"(lo), "d"(hi) : "memory");
+            break;
+        case FPU_XSAVE:
+            __asm__ volatile("xsave64 (%0)" : : "r"(area), "a"(lo), "d"(hi) : "memory");
+            break;
+        default:
+            __asm__ volatile("fxsave64 (%0)" : : "r"(area) : "memory");
+            break;
+    }
+}
+
+static inline void fpu_restore(void* area) {
+    uint32_t lo = (uint32_t)xfeatures;
+    uint32_t hi = (uint32_t)(xfeatures >> 32);
+
+    if (fpu_mode == FPU_FXSAVE) {
+        __asm__ volatile("fxrstor64 (%0)" : : "r"(area) : "memory");
+    } else {
+        __asm__ volatile("xrstor64 (%0)" : : "r"(area), "a"(lo), "d"(hi) : "memory");
+    }
+}
+
+// Pick the save instruction and XCR0 components (bootstrap processor)
+static void fpu_detect(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+    if (!(ecx & CPUID_1_ECX_XSAVE)) {
+        // FXSAVE and SSE2 are architectural on x86_64
+        fpu_mode = FPU_FXSAVE;
+        xfeatures = 0;
+        state_size = FXSAVE_SIZE;
+        return;
+    }
+    int has_avx = (ecx & CPUID_1_ECX_AVX) != 0;
+
+    // Leaf 0xD: components the CPU can save
+    cpuid(0xD, 0, &eax, &ebx, &ecx, &edx);
+    uint64_t supported = ((uint64_t)edx << 32) | eax;
+
+    xfeatures = XFEATURE_X87 | XFEATURE_SSE;
+    if (has_avx && (supported & XFEATURE_AVX)) {
+        xfeatures |= XFEATURE_AVX;
+        // AVX-512 needs all three of its components enabled together
+        if ((supported & XFEATURE_AVX512) == XFEATURE_AVX512) {
+            xfeatures |= XFEATURE_AVX512;
+        }
+    }
+
+    cpuid(0xD, 1, &eax, &ebx, &ecx, &edx);
+    fpu_mode = (eax & CPUID_D1_EAX_XSAVEOPT) ? FPU_XSAVEOPT : FPU_XSAVE;
+}
+
+void fpu_init(void) {
+    cpu_t* cpu = this_cpu();
+
+    if (!fpu_configured) {
+        fpu_detect();
+    }
+
+    // Native x87 errors, no emulation
+    uint64_t cr0 = read_cr0();
+    cr0 &= ~CR0_EM;
+    cr0 |= CR0_MP | CR0_NE;
+    write_cr0(cr0);
+
+    uint64_t cr4 = read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT;
+    if (fpu_mode != FPU_FXSAVE) {
+        cr4 |= CR4_OSXSAVE;
+    }
+    write_cr4(cr4);
+
+    if (fpu_mode != FPU_FXSAVE) {
+        xsetbv(0, xfeatures);
+        if (!fpu_configured) {
+            // Size of the area for the components just enabled in XCR0
+            uint32_t eax, ebx, ecx, edx;
+            cpuid(0xD, 0, &eax, &ebx, &ecx, &edx);
+            state_size = ebx;
+        }
+    }
+
+    // Nobody's state is live yet - the first use traps
+    cpu->fpu_owner = NULL;
+    write_cr0(read_cr0() | CR0_TS);
+
+    if (!fpu_configured) {
+        fpu_configured = 1;
+
+        static const char* mode_names[] = { "fxsave", "xsave", "xsaveopt" };
+        vga_print("[FPU] ", VGA_COLOR_LIGHT_GREEN);
+        vga_print(mode_names[fpu_mode], VGA_COLOR_LIGHT_GREEN);
+        vga_print(xfeatures & XFEATURE_AVX512 ? ", AVX-512" :
+                  xfeatures & XFEATURE_AVX ? ", AVX" : ", SSE", VGA_COLOR_LIGHT_GREEN);
+        vga_print(", ", VGA_COLOR_LIGHT_GREEN);
+        vga_print_int(state_size, VGA_COLOR_LIGHT_GREEN);
+        vga_print("-byte task state (lazy)\n", VGA_COLOR_LIGHT_GREEN);
+    }
+}
+
+// Allocate a 64-byte aligned save area holding the initial FPU state.
+// The pointer kmalloc() returned is kept just below the aligned area.
+static void* fpu_alloc_state(void) {
+    uint8_t* raw = kmalloc(state_size + FPU_ALIGN + sizeof(void*));
+    if (!raw) {
+        return NULL;
+    }
+
+    uintptr_t aligned = ((uintptr_t)raw + sizeof(void*) + FPU_ALIGN - 1) & ~(uintptr_t)(FPU_ALIGN - 1);
+    uint8_t* area = (uint8_t*)aligned;
+    ((void**)area)[-1] = raw;
+
+    // Zeroed legacy region and XSAVE header (XSTATE_BV = 0: every
+    // component starts in its init state), plus the two control words
+    // that are always loaded from memory
+    for (uint32_t i = 0; i < state_size; i++) {
+        area[i] = 0;
+    }
+    *(uint16_t*)(area + 0) = FPU_INIT_FCW;
+    *(uint32_t*)(area + 24) = FPU_INIT_MXCSR;
+
+    return area;
+}
+
+void fpu_switch(process_t* prev, process_t* next) {
+    cpu_t* cpu = this_cpu();
+    uint64_t cr0 = read_cr0();
+
+    // TS clear: prev took the #NM trap this slice and owns the registers
+    if (!(cr0 & CR0_TS)) {
+        if (prev->state == PROCESS_ZOMBIE) {
+            cpu->fpu_owner = NULL;
+            prev->fpu_cpu = FPU_CPU_NONE;
+        } else {
+            fpu_save(prev->fpu_state);
+#if FPU_BENCH
+            __atomic_fetch_add(&bench_saves, 1, __ATOMIC_RELAXED);
+#endif
+        }
+    }
+
+    // Back on the CPU that still holds its registers: nothing to load
+    if (cpu->fpu_owner == next && next->fpu_cpu == cpu->id) {
+        if (cr0 & CR0_TS) {
+            clts();
+        }
+    } else if (!(cr0 & CR0_TS)) {
+        write_cr0(cr0 | CR0_TS);
+    }
+}
+
+void fpu_handle_nm(void) {
+    cpu_t* cpu = this_cpu();
+    process_t* current = cpu->sched.current_process;
+
+    clts();
+
+    if (cpu->fpu_owner == current && current->fpu_cpu == cpu->id) {
+        return;  // Registers are already current's
+    }
+
+    // First FPU instruction of this task
+    if (!current->fpu_state) {
+        current->fpu_state = fpu_alloc_state();
+        if (!current->fpu_state) {
+            vga_print("[FPU] Out of memory for task state: ", VGA_COLOR_LIGHT_RED);
+            vga_print(current->name, VGA_COLOR_LIGHT_RED);
+            vga_print("\n", VGA_COLOR_WHITE);
+            for (;;) {
+                __asm__ volatile("cli; hlt");
+            }
+        }
+    }
+
+    // The previous owner (if any) was saved when it was switched out
+    fpu_restore(current->fpu_state);
+#if FPU_BENCH
+    __atomic_fetch_add(&bench_traps, 1, __ATOMIC_RELAXED);
+#endif
+    cpu->fpu_owner = current;
+    current->fpu_cpu = cpu->id;
+}
+
+void fpu_release(process_t* proc) {
+    if (proc->fpu_state) {
+        kfree(((void**)proc->fpu_state)[-1]);
+        proc->fpu_state = NULL;
+    }
+}
+
+uint32_t fpu_state_size(void) {
+    return state_size;
+}
+
+uint64_t fpu_xfeatures(void) {
+    return xfeatures;
+}
+
+#if FPU_BENCH
+void fpu_bench_counts(uint64_t* traps, uint64_t* saves) {
+    *traps = __atomic_load_n(&bench_traps, __ATOMIC_RELAXED);
+    *saves = __atomic_load_n(&bench_saves, __ATOMIC_RELAXED);
+}
+#endif
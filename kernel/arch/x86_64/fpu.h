@@ -0,0 +1,72 @@
+#ifndef KERNEL_ARCH_X86_64_FPU_H
+#define KERNEL_ARCH_X86_64_FPU_H
+
+#include <stdint.h>
+
+// Extended (x87/SSE/AVX) register state, one save area per task.
+//
+// A task gets its save area the first time it executes an FPU or SIMD
+// instruction: CR0.TS is set whenever the CPU's registers do not hold
+// the running task's state, so that first instruction raises #NM and
+// fpu_handle_nm() loads (or initialises) the task's state. A task that
+// used the FPU during its slice is saved when it is switched out
+// (XSAVEOPT skips components it did not modify), so its state can be
+// restored on any CPU; if it comes back to the CPU that still holds its
+// registers nothing is reloaded. Tasks that never touch the FPU pay one
+// CR0 access per switch and nothing else.
+//
+// Interrupt handlers and the rest of the kernel are built with -mno-sse
+// and must not use FPU/SIMD instructions. Kernel code that does is built
+// with SIMD_CFLAGS (Makefile) and runs in task context only: its first
+// SIMD instruction traps like a user task's, and every register is
+// caller-saved, so nothing it calls may itself be built with SIMD_CFLAGS
+// while it keeps values in them (interrupts and the scheduler never are).
+
+// Set to 1 to run tasks that keep SSE/AVX registers live across yields
+// and CPU migrations at scheduler start and check them afterwards
+#define FPU_BENCH 0
+
+#define FPU_CPU_NONE 0xFFFFFFFF  // process_t.fpu_cpu: state not live on any CPU
+
+// XCR0 component bits
+#define XFEATURE_X87       (1ULL << 0)
+#define XFEATURE_SSE       (1ULL << 1)
+#define XFEATURE_AVX       (1ULL << 2)
+#define XFEATURE_OPMASK    (1ULL << 5)
+#define XFEATURE_ZMM_HI256 (1ULL << 6)
+#define XFEATURE_HI16_ZMM  (1ULL << 7)
+#define XFEATURE_AVX512    (XFEATURE_OPMASK | XFEATURE_ZMM_HI256 | XFEATURE_HI16_ZMM)
+
+struct process_t;
+
+// Enable FPU/SSE (and XSAVE/AVX when present) on the executing CPU and
+// leave CR0.TS set. The bootstrap processor detects the features; the
+// application processors apply the same configuration.
+void fpu_init(void);
+
+// Switch the extended state from prev to next (rq lock held, interrupts
+// off). Saves prev if it used the FPU in this slice, then arms the #NM
+// trap unless next's registers are still live on this CPU.
+void fpu_switch(struct process_t* prev, struct process_t* next);
+
+// #NM handler: give the running task the FPU
+void fpu_handle_nm(void);
+
+// Free a task's save area (task is off-CPU for good)
+void fpu_release(struct process_t* proc);
+
+// Bytes in a per-task save area (0 before fpu_init)
+uint32_t fpu_state_size(void);
+
+// XCR0 components in use (0 when saving with FXSAVE)
+uint64_t fpu_xfeatures(void);
+
+#if FPU_BENCH
+// #NM traps taken and states saved at switch, over all CPUs
+void fpu_bench_counts(uint64_t* traps, uint64_t* saves);
+
+// Queue the register check (fpu_bench.c)
+void fpu_bench_start(void);
+#endif
+
+#endif // KERNEL_ARCH_X86_64_FPU_H
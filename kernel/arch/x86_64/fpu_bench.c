@@ -0,0 +1,172 @@
+// Lazy FPU check (FPU_BENCH, see fpu.h): tasks keep SSE or AVX registers
+// live across yields and CPU migrations and compare them afterwards.
+// Built with SIMD_CFLAGS; runs in task context only.
+
+#include "fpu.h"
+#include "percpu.h"
+#include "../../proc/process.h"
+#include "../../../drivers/vga.h"
+
+#if FPU_BENCH
+#define FPU_BENCH_TASKS 4              // Checker tasks, sharing the CPUs
+#define FPU_BENCH_ROUNDS 2000          // Load, switch, compare rounds per task
+#define FPU_BENCH_REGS 16              // xmm0-15, or ymm0-15 with AVX
+#define FPU_BENCH_LANES (FPU_BENCH_REGS * 2)  // 16-byte lanes, enough for ymm
+
+typedef uint32_t v4u __attribute__((vector_size(16)));
+
+// One round as the asm reads it (the offsets are fixed)
+typedef struct {
+    const v4u* pattern;        // 0: register contents to load
+    v4u* result;               // 8: register contents after the switch
+    process_t* self;           // 16: first argument of hop
+    uint64_t mask;             // 24: second argument of hop
+    void (*hop)(void);         // 32: scheduler_yield() or process_set_affinity()
+} fpu_bench_round_t;
+
+static v4u fpu_bench_pattern[FPU_BENCH_TASKS][FPU_BENCH_LANES] __attribute__((aligned(32)));
+static v4u fpu_bench_result[FPU_BENCH_TASKS][FPU_BENCH_LANES] __attribute__((aligned(32)));
+static volatile uint32_t fpu_bench_next = 0;
+static volatile uint64_t fpu_bench_mismatches = 0;
+static volatile uint64_t fpu_bench_migrations = 0;
+
+#define FPU_BENCH_EACH(op) \
+    op(0) op(1) op(2) op(3) op(4) op(5) op(6) op(7) \
+    op(8) op(9) op(10) op(11) op(12) op(13) op(14) op(15)
+
+#define FPU_BENCH_XMM_LOAD(n)  "movdqu " #n "*16(%%rsi), %%xmm" #n "\n\t"
+#define FPU_BENCH_XMM_STORE(n) "movdqu %%xmm" #n ", " #n "*16(%%rsi)\n\t"
+#define FPU_BENCH_YMM_LOAD(n)  "vmovdqu " #n "*32(%%rsi), %%ymm" #n "\n\t"
+#define FPU_BENCH_YMM_STORE(n) "vmovdqu %%ymm" #n ", " #n "*32(%%rsi)\n\t"
+
+// Call hop(self, mask) on a 16-byte aligned stack. Everything it can
+// reach is built without SSE, so only a switch can touch the registers.
+#define FPU_BENCH_HOP \
+    "mov %%rsp, %%rbx\n\t" \
+    "and $-16, %%rsp\n\t" \
+    "mov 16(%0), %%rdi\n\t" \
+    "mov 24(%0), %%rsi\n\t" \
+    "call *32(%0)\n\t" \
+    "mov %%rbx, %%rsp\n\t"
+
+#define FPU_BENCH_CLOBBERS \
+    "rax", "rbx", "rcx", "rdx", "rsi", "rdi", "r8", "r9", "r10", "r11", \
+    "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", \
+    "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", \
+    "memory", "cc"
+
+// Load the pattern, switch away, store what the registers hold on return.
+// A single asm statement, so the compiler cannot use the registers between.
+static void fpu_bench_round_sse(fpu_bench_round_t* round) {
+    __asm__ volatile("mov 0(%0), %%rsi\n\t"
+                     FPU_BENCH_EACH(FPU_BENCH_XMM_LOAD)
+                     FPU_BENCH_HOP
+                     "mov 8(%0), %%rsi\n\t"
+                     FPU_BENCH_EACH(FPU_BENCH_XMM_STORE)
+                     : : "r"(round) : FPU_BENCH_CLOBBERS);
+}
+
+static void fpu_bench_round_avx(fpu_bench_round_t* round) {
+    __asm__ volatile("mov 0(%0), %%rsi\n\t"
+                     FPU_BENCH_EACH(FPU_BENCH_YMM_LOAD)
+                     FPU_BENCH_HOP
+                     "mov 8(%0), %%rsi\n\t"
+                     FPU_BENCH_EACH(FPU_BENCH_YMM_STORE)
+                     "vzeroupper\n\t"
+                     : : "r"(round) : FPU_BENCH_CLOBBERS);
+}
+
+// Checker: odd rounds yield in place, even rounds move to the next CPU,
+// so the state is restored both on the CPU that saved it and elsewhere
+static void fpu_bench_task(void) {
+    uint32_t index = __atomic_fetch_add(&fpu_bench_next, 1, __ATOMIC_RELAXED);
+    v4u* pattern = fpu_bench_pattern[index];
+    v4u* result = fpu_bench_result[index];
+    int avx = (fpu_xfeatures() & XFEATURE_AVX) != 0;
+    uint32_t lanes = avx ? FPU_BENCH_LANES : FPU_BENCH_REGS;
+    uint32_t cpus = cpu_count();
+    uint64_t mismatches = 0;
+    uint64_t migrations = 0;
+
+    fpu_bench_round_t round = { pattern, result, get_current_process(), 0, NULL };
+    v4u lane = { 0, 1, 2, 3 };
+
+    for (uint32_t r = 0; r < FPU_BENCH_ROUNDS; r++) {
+        // Distinct per task, round and lane
+        v4u seed = lane + ((round.self->pid << 20) ^ r);
+        for (uint32_t i = 0; i < lanes; i++) {
+            pattern[i] = (seed + i * 4) * 0x9E3779B1u;
+        }
+
+        uint32_t cpu = this_cpu()->id;
+        if ((r & 1) || cpus == 1) {
+            round.hop = scheduler_yield;
+        } else {
+            round.mask = 1u << ((cpu + 1) % cpus);
+            round.hop = (void (*)(void))process_set_affinity;
+        }
+
+        if (avx) {
+            fpu_bench_round_avx(&round);
+        } else {
+            fpu_bench_round_sse(&round);
+        }
+
+        if (this_cpu()->id != cpu) {
+            migrations++;
+        }
+        v4u diff = { 0, 0, 0, 0 };
+        for (uint32_t i = 0; i < lanes; i++) {
+            diff |= pattern[i] ^ result[i];
+        }
+        if (diff[0] | diff[1] | diff[2] | diff[3]) {
+            mismatches++;
+        }
+    }
+
+    __atomic_fetch_add(&fpu_bench_mismatches, mismatches, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&fpu_bench_migrations, migrations, __ATOMIC_RELAXED);
+}
+
+// Coordinator: start the checkers, wait for them, report
+static void fpu_bench_main(void) {
+    uint32_t pids[FPU_BENCH_TASKS];
+    uint32_t started = 0;
+
+    for (uint32_t i = 0; i < FPU_BENCH_TASKS; i++) {
+        process_t* proc = process_create("fpucheck", fpu_bench_task, DEFAULT_PRIORITY);
+        if (proc) {
+            pids[started++] = proc->pid;
+        }
+    }
+    if (started == 0) {
+        vga_print("[BENCH] fpu: failed to create tasks\n", VGA_COLOR_LIGHT_RED);
+        return;
+    }
+    for (uint32_t i = 0; i < started; i++) {
+        process_wait(pids[i], NULL);
+    }
+
+    uint64_t traps, saves;
+    fpu_bench_counts(&traps, &saves);
+    vga_color_t color = fpu_bench_mismatches ? VGA_COLOR_LIGHT_RED : VGA_COLOR_LIGHT_GREEN;
+
+    vga_print("\n[BENCH] fpu: ", color);
+    vga_print_int(started, color);
+    vga_print(" tasks x ", color);
+    vga_print_int(FPU_BENCH_ROUNDS, color);
+    vga_print(fpu_xfeatures() & XFEATURE_AVX ? " rounds of ymm0-15, " : " rounds of xmm0-15, ", color);
+    vga_print_int((int32_t)fpu_bench_migrations, color);
+    vga_print(" migrations, ", color);
+    vga_print_int((int32_t)fpu_bench_mismatches, color);
+    vga_print(" mismatches\n[BENCH] fpu: ", color);
+    vga_print_int((int32_t)traps, color);
+    vga_print(" #NM traps, ", color);
+    vga_print_int((int32_t)saves, color);
+    vga_print(" saves at switch\n", color);
+}
+
+void fpu_bench_start(void) {
+    process_create("fpubench", fpu_bench_main, DEFAULT_PRIORITY);
+}
+#endif
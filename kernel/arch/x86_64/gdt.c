@@ -0,0 +1,53 @@
+// Per-CPU GDT and TSS
+
+#include "gdt.h"
+#include "cpu.h"
+#include "percpu.h"
+
+// Descriptor bits
+#define SEG_WRITABLE  (1ULL << 41)   // Data: writable
+#define SEG_CODE      (1ULL << 43)
+#define SEG_NON_SYS   (1ULL << 44)   // Code or data (not a system descriptor)
+#define SEG_DPL_USER  (3ULL << 45)
+#define SEG_PRESENT   (1ULL << 47)
+#define SEG_LONG      (1ULL << 53)   // 64-bit code
+#define SEG_TSS_AVAIL (0x9ULL << 40) // Available 64-bit TSS
+
+#define SEG_KERNEL_CODE (SEG_PRESENT | SEG_NON_SYS | SEG_CODE | SEG_LONG)
+#define SEG_KERNEL_DATA (SEG_PRESENT | SEG_NON_SYS | SEG_WRITABLE)
+
+// Fill in and load this CPU's descriptor tables
+void gdt_init_cpu(struct cpu* cpu) {
+    uint64_t* gdt = cpu->gdt;
+    tss_t* tss = &cpu->tss;
+    uint8_t* raw = (uint8_t*)tss;
+    
+    for (uint32_t i = 0; i < sizeof(*tss); i++) {
+        raw[i] = 0;
+    }
+    tss->iomap_base = sizeof(*tss);
+    for (uint32_t i = 0; i < IST_COUNT; i++) {
+        tss->ist[i] = (uint64_t)cpu->ist_stack + (i + 1) * IST_STACK_SIZE;
+    }
+    
+    // Same kernel selectors as the boot GDT, so CS/SS stay valid across
+    // the lgdt and nothing has to be reloaded
+    gdt[0] = 0;
+    gdt[GDT_KERNEL_CODE / 8] = SEG_KERNEL_CODE;
+    gdt[GDT_KERNEL_DATA / 8] = SEG_KERNEL_DATA;
+    gdt[GDT_USER_DATA / 8] = SEG_KERNEL_DATA | SEG_DPL_USER;
+    gdt[GDT_USER_CODE / 8] = SEG_KERNEL_CODE | SEG_DPL_USER;
+    
+    uint64_t base = (uint64_t)tss;
+    uint64_t limit = sizeof(*tss) - 1;
+    gdt[GDT_TSS / 8] = (limit & 0xFFFF) | ((base & 0xFFFFFF) << 16) | SEG_TSS_AVAIL |
+                       SEG_PRESENT | (((limit >> 16) & 0xF) << 48) | (((base >> 24) & 0xFF) << 56);
+    gdt[GDT_TSS / 8 + 1] = base >> 32;
+    
+    gdt_ptr_t ptr = { .limit = sizeof(cpu->gdt) - 1, .base = (uint64_t)gdt };
+    
+    // ltr marks the descriptor busy; nothing else touches GS or FS here,
+    // which would reset the per-CPU base
+    __asm__ volatile("lgdt %0" : : "m"(ptr) : "memory");
+    __asm__ volatile("ltr %w0" : : "r"((uint16_t)GDT_TSS));
+}
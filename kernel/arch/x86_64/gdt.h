@@ -0,0 +1,55 @@
+#ifndef KERNEL_ARCH_X86_64_GDT_H
+#define KERNEL_ARCH_X86_64_GDT_H
+
+#include <stdint.h>
+
+// Per-CPU GDT and TSS. boot.asm only has the kernel segments needed to
+// reach long mode; every CPU then switches to its own table with the
+// user segments and a TSS, whose RSP0 is the stack the CPU moves to when
+// an interrupt or exception arrives in ring 3.
+
+// Null, kernel code/data, user data/code, TSS (two slots)
+#define GDT_ENTRIES 7
+
+// Interrupt stack table slots (IDT gate ist field, TSS ist[slot - 1]).
+// These exceptions always switch to a known-good stack: a double fault
+// is usually a task running into the guard below its kernel stack
+// (mm/kstack.h), and NMIs and machine checks can hit any instruction,
+// including the first ones of an entry stub.
+#define IST_NMI           1
+#define IST_DOUBLE_FAULT  2
+#define IST_MACHINE_CHECK 3
+#define IST_COUNT         3
+#define IST_STACK_SIZE    4096
+
+// Per-CPU stack the IRQ handlers run on (isr.asm), so
+// they do not eat into the interrupted task's kernel stack
+#define IRQ_STACK_SIZE    8192
+
+// 64-bit task state segment
+typedef struct {
+    uint32_t reserved0;
+    uint64_t rsp0;             // Stack for entries from ring 3
+    uint64_t rsp1;
+    uint64_t rsp2;
+    uint64_t reserved1;
+    uint64_t ist[7];           // Interrupt stack table (IST1..IST7)
+    uint64_t reserved2;
+    uint16_t reserved3;
+    uint16_t iomap_base;       // Past the limit: no I/O permission bitmap
+} __attribute__((packed)) tss_t;
+
+// GDT pointer (lgdt operand)
+typedef struct {
+    uint16_t limit;
+    uint64_t base;
+} __attribute__((packed)) gdt_ptr_t;
+
+struct cpu;
+
+// Build the GDT and TSS in the CPU's per-CPU data and load them on the
+// executing CPU (after percpu_init, before the first ring-3 entry). The
+// IST slots point into cpu->ist_stack, which must be set up already.
+void gdt_init_cpu(struct cpu* cpu);
+
+#endif // KERNEL_ARCH_X86_64_GDT_H
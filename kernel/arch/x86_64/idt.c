@@ -15,11 +15,16 @@ void idt_set_gate(uint8_t num, uint64_t handler, uint16_t selector, uint8_t flag
     idt[num].offset_high = (handler >> 32) & 0xFFFFFFFF;
     
     idt[num].selector = selector;
-    idt[num].ist = 0;  // No IST for now
+    idt[num].ist = 0;  // Current stack, see idt_set_ist()
     idt[num].type_attr = flags;
     idt[num].zero = 0;
 }
 
+// Switch a gate to an IST stack
+void idt_set_ist(uint8_t num, uint8_t ist) {
+    idt[num].ist = ist & 0x7;
+}
+
 // Initialize the IDT
 void idt_init(void) {
     // Set up the IDT pointer
@@ -40,3 +45,8 @@ void idt_init(void) {
     // Load the IDT
     idt_load((uint64_t)&idtp);
 }
+
+// Load the shared IDT on another CPU
+void idt_reload(void) {
+    idt_load((uint64_t)&idtp);
+}
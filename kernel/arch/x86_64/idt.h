@@ -26,7 +26,13 @@ typedef struct {
 // Initialize the IDT
 void idt_init(void);
 
+// Load the (already initialized) IDT on the executing CPU
+void idt_reload(void);
+
 // Set an IDT entry
 void idt_set_gate(uint8_t num, uint64_t handler, uint16_t selector, uint8_t flags);
 
+// Run a vector on an interrupt stack table slot (1-7, 0 = current stack)
+void idt_set_ist(uint8_t num, uint8_t ist);
+
 #endif // IDT_H
@@ -1,8 +1,15 @@
 #include "interrupts.h"
 #include "idt.h"
+#include "cpu.h"
+#include "gdt.h"
+#include "lapic.h"
+#include "percpu.h"
+#include "fpu.h"
+#include "ioapic.h"
+#include "../../proc/cputime.h"
+#include "../../irq/irqdesc.h"
+#include "../../mm/paging.h"
 #include "../../../drivers/vga.h"
-#include "../../../drivers/pit.h"
-#include "../../../drivers/keyboard.h"
 
 // Exception messages
 const char *exception_messages[] = {
@@ -77,8 +84,93 @@ void pic_send_eoi(uint8_t irq) {
     outb(PIC1_COMMAND, PIC_EOI);
 }
 
+// Mask a single PIC line
+void pic_mask_irq(uint8_t irq) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    outb(port, inb(port) | (1 << (irq & 7)));
+}
+
+// Unmask a single PIC line
+void pic_unmask_irq(uint8_t irq) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    outb(port, inb(port) & ~(1 << (irq & 7)));
+}
+
+// End of interrupt: a single local APIC write once the I/O APIC
+// delivers ISA IRQs, instead of one or two slow port writes
+void irq_eoi(uint8_t irq) {
+    if (ioapic_active()) {
+        lapic_eoi();
+    } else {
+        pic_send_eoi(irq);
+    }
+}
+
+void irq_mask(uint8_t irq) {
+    if (ioapic_active()) {
+        ioapic_mask_irq(irq);
+    } else {
+        pic_mask_irq(irq);
+    }
+}
+
+void irq_unmask(uint8_t irq) {
+    if (ioapic_active()) {
+        ioapic_unmask_irq(irq);
+    } else {
+        pic_unmask_irq(irq);
+    }
+}
+
+// Route an ISA IRQ to a logical CPU
+int irq_set_affinity(uint8_t irq, uint32_t cpu) {
+    cpu_t* target = cpu_get(cpu);
+    if (!ioapic_active() || !target) {
+        return -1;
+    }
+    ioapic_set_dest(irq, target->apic_id);
+    return 0;
+}
+
 // ISR handler (called from assembly)
-void isr_handler(uint64_t isr_number) {
+void isr_handler(uint64_t isr_number, uint64_t error_code, uint64_t cs) {
+    // Device not available: first FPU/SIMD use since the last switch
+    if (isr_number == 7) {
+        fpu_handle_nm();
+        return;
+    }
+    
+    // NMIs, double faults and machine checks (on IST stacks) are not the
+    // interrupted task's doing, whatever its ring
+    int task_fault = isr_number != 2 && isr_number != 8 && isr_number != 18;
+    
+    if ((cs & 3) && task_fault) {
+        // A page opened to user mode after this CPU cached the old entry
+        // (paging_grant_user() only flushes its own TLB): drop it, retry.
+        // Only if the tables now allow this very access, and once - a
+        // second fault at the same address is not a stale entry.
+        if (isr_number == 14 && !(error_code & PF_ERR_RSVD)) {
+            uint64_t addr = read_cr2();
+            int allowed = (error_code & PF_ERR_FETCH) ? paging_user_exec_ok(addr)
+                                                      : paging_user_range_ok(addr, 1, error_code & PF_ERR_WRITE);
+            cpu_t* cpu = this_cpu();
+            if (allowed && cpu->pf_retry_addr != (addr & ~0xFFFULL)) {
+                cpu->pf_retry_addr = addr & ~0xFFFULL;
+                invlpg(addr);
+                return;
+            }
+        }
+        
+        // Faults in user mode only take down the task
+        process_t* proc = get_current_process();
+        vga_print("[USER] ", VGA_COLOR_LIGHT_RED);
+        vga_print(proc->name, VGA_COLOR_LIGHT_RED);
+        vga_print(" killed: ", VGA_COLOR_LIGHT_RED);
+        vga_print(isr_number < 32 ? exception_messages[isr_number] : "Unknown", VGA_COLOR_LIGHT_RED);
+        vga_print("\n", VGA_COLOR_WHITE);
+        process_exit(PROCESS_EXIT_KILLED);
+    }
+    
     vga_print("Exception: ", VGA_COLOR_LIGHT_RED);
     if (isr_number < 32) {
         vga_print(exception_messages[isr_number], VGA_COLOR_LIGHT_RED);
@@ -95,21 +187,17 @@ void isr_handler(uint64_t isr_number) {
 
 // IRQ handler (called from assembly)
 void irq_handler(uint64_t irq_number) {
-    // Handle specific IRQs
-    switch (irq_number) {
-        case 0:  // PIT Timer
-            pit_handler();
-            break;
-        case 1:  // Keyboard
-            keyboard_handler();
-            break;
-        // Add more IRQ handlers here as needed
-        default:
-            break;
-    }
+    uint64_t start = cputime_irq_enter();
     
-    // Send End of Interrupt to PIC
-    pic_send_eoi(irq_number);
+    // Every handler on the line (irq/irqdesc.c); unclaimed interrupts
+    // are still acknowledged
+    irq_dispatch((uint8_t)irq_number);
+    
+    // Send End of Interrupt to the PIC or local APIC
+    irq_eoi(irq_number);
+    
+    irq_account((uint8_t)irq_number, rdtsc() - start, 0);
+    cputime_irq_exit(start);
 }
 
 // Initialize interrupts
@@ -117,61 +205,35 @@ void interrupts_init(void) {
     // Initialize IDT
     idt_init();
     
-    // Remap PIC (IRQs 0-15 to interrupts 32-47)
-    pic_remap(0x20, 0x28);
+    // Remap PIC (IRQs 0-15 to interrupts 32-47); it delivers them until
+    // smp_init() hands them to the I/O APIC
+    pic_remap(IRQ_BASE_VECTOR, IRQ_BASE_VECTOR + 8);
     
-    // Install ISRs for CPU exceptions (0-31)
+    // Install ISRs for CPU exceptions (0-31) and the ISA IRQs (32-47)
     // Flags: 0x8E = Present, Ring 0, 64-bit Interrupt Gate
-    idt_set_gate(0, (uint64_t)isr0, 0x08, 0x8E);
-    idt_set_gate(1, (uint64_t)isr1, 0x08, 0x8E);
-    idt_set_gate(2, (uint64_t)isr2, 0x08, 0x8E);
-    idt_set_gate(3, (uint64_t)isr3, 0x08, 0x8E);
-    idt_set_gate(4, (uint64_t)isr4, 0x08, 0x8E);
-    idt_set_gate(5, (uint64_t)isr5, 0x08, 0x8E);
-    idt_set_gate(6, (uint64_t)isr6, 0x08, 0x8E);
-    idt_set_gate(7, (uint64_t)isr7, 0x08, 0x8E);
-    idt_set_gate(8, (uint64_t)isr8, 0x08, 0x8E);
-    idt_set_gate(9, (uint64_t)isr9, 0x08, 0x8E);
-    idt_set_gate(10, (uint64_t)isr10, 0x08, 0x8E);
-    idt_set_gate(11, (uint64_t)isr11, 0x08, 0x8E);
-    idt_set_gate(12, (uint64_t)isr12, 0x08, 0x8E);
-    idt_set_gate(13, (uint64_t)isr13, 0x08, 0x8E);
-    idt_set_gate(14, (uint64_t)isr14, 0x08, 0x8E);
-    idt_set_gate(15, (uint64_t)isr15, 0x08, 0x8E);
-    idt_set_gate(16, (uint64_t)isr16, 0x08, 0x8E);
-    idt_set_gate(17, (uint64_t)isr17, 0x08, 0x8E);
-    idt_set_gate(18, (uint64_t)isr18, 0x08, 0x8E);
-    idt_set_gate(19, (uint64_t)isr19, 0x08, 0x8E);
-    idt_set_gate(20, (uint64_t)isr20, 0x08, 0x8E);
-    idt_set_gate(21, (uint64_t)isr21, 0x08, 0x8E);
-    idt_set_gate(22, (uint64_t)isr22, 0x08, 0x8E);
-    idt_set_gate(23, (uint64_t)isr23, 0x08, 0x8E);
-    idt_set_gate(24, (uint64_t)isr24, 0x08, 0x8E);
-    idt_set_gate(25, (uint64_t)isr25, 0x08, 0x8E);
-    idt_set_gate(26, (uint64_t)isr26, 0x08, 0x8E);
-    idt_set_gate(27, (uint64_t)isr27, 0x08, 0x8E);
-    idt_set_gate(28, (uint64_t)isr28, 0x08, 0x8E);
-    idt_set_gate(29, (uint64_t)isr29, 0x08, 0x8E);
-    idt_set_gate(30, (uint64_t)isr30, 0x08, 0x8E);
-    idt_set_gate(31, (uint64_t)isr31, 0x08, 0x8E);
-    
-    // Install IRQ handlers (32-47)
-    idt_set_gate(32, (uint64_t)irq0, 0x08, 0x8E);
-    idt_set_gate(33, (uint64_t)irq1, 0x08, 0x8E);
-    idt_set_gate(34, (uint64_t)irq2, 0x08, 0x8E);
-    idt_set_gate(35, (uint64_t)irq3, 0x08, 0x8E);
-    idt_set_gate(36, (uint64_t)irq4, 0x08, 0x8E);
-    idt_set_gate(37, (uint64_t)irq5, 0x08, 0x8E);
-    idt_set_gate(38, (uint64_t)irq6, 0x08, 0x8E);
-    idt_set_gate(39, (uint64_t)irq7, 0x08, 0x8E);
-    idt_set_gate(40, (uint64_t)irq8, 0x08, 0x8E);
-    idt_set_gate(41, (uint64_t)irq9, 0x08, 0x8E);
-    idt_set_gate(42, (uint64_t)irq10, 0x08, 0x8E);
-    idt_set_gate(43, (uint64_t)irq11, 0x08, 0x8E);
-    idt_set_gate(44, (uint64_t)irq12, 0x08, 0x8E);
-    idt_set_gate(45, (uint64_t)irq13, 0x08, 0x8E);
-    idt_set_gate(46, (uint64_t)irq14, 0x08, 0x8E);
-    idt_set_gate(47, (uint64_t)irq15, 0x08, 0x8E);
+    for (uint8_t i = 0; i < 32; i++) {
+        idt_set_gate(i, isr_stub_table[i], 0x08, 0x8E);
+    }
+    for (uint8_t i = 0; i < ISA_IRQ_COUNT; i++) {
+        idt_set_gate(IRQ_BASE_VECTOR + i, irq_stub_table[i], 0x08, 0x8E);
+    }
+    
+    // Local APIC vectors
+    idt_set_gate(LAPIC_TIMER_VECTOR, (uint64_t)irq17, 0x08, 0x8E);
+    idt_set_gate(LAPIC_RESCHED_VECTOR, (uint64_t)irq18, 0x08, 0x8E);
+    idt_set_gate(LAPIC_SPURIOUS_VECTOR, (uint64_t)lapic_spurious_isr, 0x08, 0x8E);
+    
+    // Per-CPU data must be reachable before the first interrupt arrives
+    percpu_init_boot_cpu();
+    
+    // Known-good stacks for the exceptions that can strike anywhere (the
+    // TSS now has them)
+    idt_set_ist(2, IST_NMI);
+    idt_set_ist(8, IST_DOUBLE_FAULT);
+    idt_set_ist(18, IST_MACHINE_CHECK);
+    
+    // FPU/SSE on, first use by each task traps to fpu_handle_nm()
+    fpu_init();
     
     // Enable interrupts
     enable_interrupts();
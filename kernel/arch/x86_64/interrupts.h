@@ -21,6 +21,9 @@ typedef struct {
 // PIC commands
 #define PIC_EOI      0x20  // End of Interrupt
 
+// Vector of ISA IRQ 0 (PIC and I/O APIC alike)
+#define IRQ_BASE_VECTOR 0x20
+
 // Initialize interrupts (IDT + PIC)
 void interrupts_init(void);
 
@@ -30,6 +33,19 @@ void pic_remap(uint8_t offset1, uint8_t offset2);
 // Send End of Interrupt to PIC
 void pic_send_eoi(uint8_t irq);
 
+// Mask/unmask a single PIC line
+void pic_mask_irq(uint8_t irq);
+void pic_unmask_irq(uint8_t irq);
+
+// ISA IRQ control through whichever controller delivers it (the I/O
+// APIC once ioapic_init() has taken over, the 8259 before that)
+void irq_eoi(uint8_t irq);
+void irq_mask(uint8_t irq);
+void irq_unmask(uint8_t irq);
+
+// Deliver an ISA IRQ to a CPU (I/O APIC only; -1 if not possible)
+int irq_set_affinity(uint8_t irq, uint32_t cpu);
+
 // Enable/disable interrupts
 static inline void enable_interrupts(void) {
     __asm__ volatile("sti");
@@ -39,6 +55,20 @@ static inline void disable_interrupts(void) {
     __asm__ volatile("cli");
 }
 
+// Save RFLAGS and disable interrupts (returns saved flags)
+static inline uint64_t irq_save(void) {
+    uint64_t flags;
+    __asm__ volatile("pushfq; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+// Re-enable interrupts only if they were enabled when irq_save() was called
+static inline void irq_restore(uint64_t flags) {
+    if (flags & 0x200) {
+        __asm__ volatile("sti" : : : "memory");
+    }
+}
+
 // I/O port functions
 static inline void outb(uint16_t port, uint8_t value) {
     __asm__ volatile("outb %0, %1" : : "a"(value), "Nd"(port));
@@ -50,56 +80,14 @@ static inline uint8_t inb(uint16_t port) {
     return ret;
 }
 
-// CPU exception handlers (0-31)
-extern void isr0(void);
-extern void isr1(void);
-extern void isr2(void);
-extern void isr3(void);
-extern void isr4(void);
-extern void isr5(void);
-extern void isr6(void);
-extern void isr7(void);
-extern void isr8(void);
-extern void isr9(void);
-extern void isr10(void);
-extern void isr11(void);
-extern void isr12(void);
-extern void isr13(void);
-extern void isr14(void);
-extern void isr15(void);
-extern void isr16(void);
-extern void isr17(void);
-extern void isr18(void);
-extern void isr19(void);
-extern void isr20(void);
-extern void isr21(void);
-extern void isr22(void);
-extern void isr23(void);
-extern void isr24(void);
-extern void isr25(void);
-extern void isr26(void);
-extern void isr27(void);
-extern void isr28(void);
-extern void isr29(void);
-extern void isr30(void);
-extern void isr31(void);
-
-// IRQ handlers (32-47)
-extern void irq0(void);
-extern void irq1(void);
-extern void irq2(void);
-extern void irq3(void);
-extern void irq4(void);
-extern void irq5(void);
-extern void irq6(void);
-extern void irq7(void);
-extern void irq8(void);
-extern void irq9(void);
-extern void irq10(void);
-extern void irq11(void);
-extern void irq12(void);
-extern void irq13(void);
-extern void irq14(void);
-extern void irq15(void);
+// Entry stubs of the CPU exceptions (0-31) and ISA IRQs (32-47), in
+// vector order (isr.asm)
+extern const uint64_t isr_stub_table[32];
+extern const uint64_t irq_stub_table[16];
+
+// Local APIC vectors
+extern void irq17(void);  // Local APIC timer
+extern void irq18(void);  // Reschedule IPI
+extern void lapic_spurious_isr(void);
 
 #endif // INTERRUPTS_H
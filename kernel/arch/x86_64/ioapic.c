@@ -0,0 +1,186 @@
+// I/O APIC driver - ISA interrupts through redirection entries
+
+#include "ioapic.h"
+#include "lapic.h"
+#include "interrupts.h"
+#include "../../acpi/acpi.h"
+#include "../../mm/paging.h"
+#include "../../sync/spinlock.h"
+#include "../../../drivers/vga.h"
+
+typedef struct {
+    volatile uint32_t* base;
+    uint32_t gsi_base;
+    uint32_t entries;          // Redirection entries (GSIs gsi_base..+entries-1)
+} ioapic_t;
+
+// Where an ISA IRQ ended up
+typedef struct {
+    ioapic_t* ioapic;          // NULL if no I/O APIC covers its GSI
+    uint32_t pin;              // Redirection entry on that I/O APIC
+    uint32_t low;              // Low dword without the mask bit
+} isa_route_t;
+
+static ioapic_t ioapics[ACPI_MAX_IOAPICS];
+static uint32_t ioapic_count = 0;
+static isa_route_t isa_routes[ISA_IRQ_COUNT];
+static uint8_t ioapic_enabled = 0;
+
+// IOREGSEL/IOWIN is a two-step access shared by every CPU
+static spinlock_t ioapic_lock = SPINLOCK_INIT_NAMED("ioapic");
+
+static uint32_t ioapic_read(ioapic_t* io, uint32_t reg) {
+    io->base[IOAPIC_REGSEL / 4] = reg;
+    return io->base[IOAPIC_WINDOW / 4];
+}
+
+static void ioapic_write(ioapic_t* io, uint32_t reg, uint32_t value) {
+    io->base[IOAPIC_REGSEL / 4] = reg;
+    io->base[IOAPIC_WINDOW / 4] = value;
+}
+
+// I/O APIC serving a global system interrupt
+static ioapic_t* ioapic_for_gsi(uint32_t gsi) {
+    for (uint32_t i = 0; i < ioapic_count; i++) {
+        if (gsi >= ioapics[i].gsi_base && gsi < ioapics[i].gsi_base + ioapics[i].entries) {
+            return &ioapics[i];
+        }
+    }
+    return 0;
+}
+
+// Work out GSI, polarity and trigger of an ISA IRQ. ISA lines are
+// edge-triggered and active high unless the MADT overrides them.
+static void isa_route(const acpi_madt_info_t* madt, uint8_t irq, isa_route_t* route) {
+    uint32_t gsi = irq;
+    uint32_t low = IRQ_BASE_VECTOR + irq;
+    int overridden = 0;
+    
+    for (uint32_t i = 0; i < madt->override_count; i++) {
+        const acpi_override_t* ov = &madt->overrides[i];
+        if (ov->irq != irq) {
+            continue;
+        }
+        overridden = 1;
+        gsi = ov->gsi;
+        if ((ov->flags & 0x3) == 0x3) {
+            low |= IOAPIC_REDIR_LOW_ACTIVE;
+        }
+        if (((ov->flags >> 2) & 0x3) == 0x3) {
+            low |= IOAPIC_REDIR_LEVEL;
+        }
+        break;
+    }
+    
+    // Identity-mapped pin taken by another IRQ (usually the PIT on GSI 2)
+    for (uint32_t i = 0; i < madt->override_count && !overridden; i++) {
+        if (madt->overrides[i].gsi == gsi && madt->overrides[i].irq != irq) {
+            route->ioapic = 0;
+            return;
+        }
+    }
+    
+    route->ioapic = ioapic_for_gsi(gsi);
+    route->pin = route->ioapic ? gsi - route->ioapic->gsi_base : 0;
+    route->low = low;
+}
+
+// Take over the ISA interrupts from the 8259
+int ioapic_init(void) {
+    const acpi_madt_info_t* madt = acpi_get_madt_info();
+    if (!madt || madt->ioapic_count == 0 || !lapic_available()) {
+        return -1;
+    }
+    
+    for (uint32_t i = 0; i < madt->ioapic_count && i < ACPI_MAX_IOAPICS; i++) {
+        ioapic_t* io = &ioapics[ioapic_count++];
+        paging_map_mmio(madt->ioapics[i].address, 0x1000);
+        io->base = (volatile uint32_t*)(uint64_t)madt->ioapics[i].address;
+        io->gsi_base = madt->ioapics[i].gsi_base;
+        io->entries = ((ioapic_read(io, IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+        
+        // Start from a clean slate: everything masked
+        for (uint32_t pin = 0; pin < io->entries; pin++) {
+            ioapic_write(io, IOAPIC_REG_REDIR + 2 * pin, IOAPIC_REDIR_MASKED);
+            ioapic_write(io, IOAPIC_REG_REDIR + 2 * pin + 1, 0);
+        }
+    }
+    
+    uint64_t flags = irq_save();
+    
+    // Lines the PIC had enabled stay enabled (the cascade has no device)
+    uint16_t pic_mask = inb(PIC1_DATA) | ((uint16_t)inb(PIC2_DATA) << 8) | (1 << 2);
+    uint32_t bsp = lapic_get_id();
+    
+    for (uint8_t irq = 0; irq < ISA_IRQ_COUNT; irq++) {
+        isa_route_t* route = &isa_routes[irq];
+        isa_route(madt, irq, route);
+        if (!route->ioapic) {
+            continue;
+        }
+        
+        uint32_t low = route->low;
+        if (pic_mask & (1 << irq)) {
+            low |= IOAPIC_REDIR_MASKED;
+        }
+        ioapic_write(route->ioapic, IOAPIC_REG_REDIR + 2 * route->pin + 1, bsp << 24);
+        ioapic_write(route->ioapic, IOAPIC_REG_REDIR + 2 * route->pin, low);
+    }
+    
+    // The 8259 stays remapped (stray vectors land on the IRQ stubs) but
+    // raises nothing any more, and LINT0 no longer listens to it
+    outb(PIC1_DATA, 0xFF);
+    outb(PIC2_DATA, 0xFF);
+    lapic_disable_extint();
+    ioapic_enabled = 1;
+    
+    irq_restore(flags);
+    
+    vga_print("[IOAPIC] ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(ioapic_count, VGA_COLOR_LIGHT_CYAN);
+    vga_print(" I/O APIC(s), ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(ioapics[0].entries, VGA_COLOR_LIGHT_CYAN);
+    vga_print(" pins, PIC masked, local APIC in ", VGA_COLOR_LIGHT_GREEN);
+    vga_print(lapic_is_x2apic() ? "x2APIC" : "xAPIC", VGA_COLOR_LIGHT_CYAN);
+    vga_print(" mode\n", VGA_COLOR_LIGHT_GREEN);
+    
+    return 0;
+}
+
+// Check whether the I/O APIC delivers the ISA interrupts
+int ioapic_active(void) {
+    return ioapic_enabled;
+}
+
+// Set or clear the mask bit of an ISA IRQ's entry
+static void ioapic_set_masked(uint8_t irq, int masked) {
+    if (irq >= ISA_IRQ_COUNT || !isa_routes[irq].ioapic) {
+        return;
+    }
+    
+    isa_route_t* route = &isa_routes[irq];
+    uint64_t flags = spin_lock_irqsave(&ioapic_lock);
+    ioapic_write(route->ioapic, IOAPIC_REG_REDIR + 2 * route->pin,
+                 route->low | (masked ? IOAPIC_REDIR_MASKED : 0));
+    spin_unlock_irqrestore(&ioapic_lock, flags);
+}
+
+void ioapic_mask_irq(uint8_t irq) {
+    ioapic_set_masked(irq, 1);
+}
+
+void ioapic_unmask_irq(uint8_t irq) {
+    ioapic_set_masked(irq, 0);
+}
+
+// Route an ISA IRQ to another CPU (physical destination mode)
+void ioapic_set_dest(uint8_t irq, uint32_t apic_id) {
+    if (irq >= ISA_IRQ_COUNT || !isa_routes[irq].ioapic) {
+        return;
+    }
+    
+    isa_route_t* route = &isa_routes[irq];
+    uint64_t flags = spin_lock_irqsave(&ioapic_lock);
+    ioapic_write(route->ioapic, IOAPIC_REG_REDIR + 2 * route->pin + 1, apic_id << 24);
+    spin_unlock_irqrestore(&ioapic_lock, flags);
+}
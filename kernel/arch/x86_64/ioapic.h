@@ -0,0 +1,40 @@
+#ifndef KERNEL_ARCH_X86_64_IOAPIC_H
+#define KERNEL_ARCH_X86_64_IOAPIC_H
+
+#include <stdint.h>
+
+// Register window (index written to IOREGSEL, data through IOWIN)
+#define IOAPIC_REGSEL         0x00
+#define IOAPIC_WINDOW         0x10
+
+// Registers
+#define IOAPIC_REG_ID         0x00
+#define IOAPIC_REG_VERSION    0x01
+#define IOAPIC_REG_REDIR      0x10  // Entry n: 0x10 + 2n (low), 0x11 + 2n (high)
+
+// Redirection entry bits (low dword)
+#define IOAPIC_REDIR_LOW_ACTIVE  (1 << 13)  // Polarity: active low
+#define IOAPIC_REDIR_LEVEL       (1 << 15)  // Trigger: level
+#define IOAPIC_REDIR_MASKED      (1 << 16)
+
+// Legacy ISA interrupt lines
+#define ISA_IRQ_COUNT 16
+
+// Take over the ISA interrupts from the 8259: program a redirection
+// entry for each (vector 32 + irq, MADT overrides applied, delivered to
+// the bootstrap processor), keep the lines that were enabled on the PIC
+// enabled, then mask the PIC and LINT0 (BSP, interrupts disabled).
+// Returns 0 on success, -1 if there is no I/O APIC (PIC stays in use).
+int ioapic_init(void);
+
+// Check whether ISA interrupts arrive through the I/O APIC
+int ioapic_active(void);
+
+// Mask/unmask an ISA IRQ
+void ioapic_mask_irq(uint8_t irq);
+void ioapic_unmask_irq(uint8_t irq);
+
+// Deliver an ISA IRQ to the CPU with the given local APIC ID
+void ioapic_set_dest(uint8_t irq, uint32_t apic_id);
+
+#endif // KERNEL_ARCH_X86_64_IOAPIC_H
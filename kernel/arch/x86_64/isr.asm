@@ -1,16 +1,24 @@
 ; Interrupt Service Routines and IRQ handlers
+
+%include "asm_offsets.inc"
+%include "user_time.inc"
+
+MSR_GS_BASE equ 0xC0000101
+
 section .text
 
 ; External C handlers
 extern isr_handler
 extern irq_handler
 extern preempt_handler
+extern resched_handler
+extern irq_exit
+extern preempt_schedule_irq
 
 ; Macro to create ISR stubs without error code
 %macro ISR_NOERRCODE 1
 global isr%1
 isr%1:
-    cli                     ; Disable interrupts
     push qword 0           ; Push dummy error code
     push qword %1          ; Push interrupt number
     jmp isr_common_stub
@@ -20,32 +28,42 @@ isr%1:
 %macro ISR_ERRCODE 1
 global isr%1
 isr%1:
-    cli                     ; Disable interrupts
     ; Error code already pushed by CPU
     push qword %1          ; Push interrupt number
     jmp isr_common_stub
 %endmacro
 
-; Macro to create IRQ stubs
-%macro IRQ 2
+; Macro to create stubs for exceptions on an IST stack (error code
+; pushed by the CPU or not)
+%macro ISR_PARANOID 2
+global isr%1
+isr%1:
+%if %2 == 0
+    push qword 0
+%endif
+    push qword %1
+    jmp isr_paranoid_stub
+%endmacro
+
+; Macro to create IRQ stubs (IRQ number, vector, common stub). All
+; gates are interrupt gates, so interrupts are already off here.
+%macro IRQ 2-3 irq_common_stub
 global irq%1
 irq%1:
-    cli                     ; Disable interrupts
-    push qword 0           ; Push dummy error code
-    push qword %2          ; Push IRQ number
-    jmp irq_common_stub
+    push qword %1          ; Push IRQ number
+    jmp %3
 %endmacro
 
 ; CPU Exception ISRs (0-31)
 ISR_NOERRCODE 0     ; Division By Zero
 ISR_NOERRCODE 1     ; Debug
-ISR_NOERRCODE 2     ; Non Maskable Interrupt
+ISR_PARANOID  2, 0  ; Non Maskable Interrupt
 ISR_NOERRCODE 3     ; Breakpoint
 ISR_NOERRCODE 4     ; Into Detected Overflow
 ISR_NOERRCODE 5     ; Out of Bounds
 ISR_NOERRCODE 6     ; Invalid Opcode
 ISR_NOERRCODE 7     ; No Coprocessor
-ISR_ERRCODE   8     ; Double Fault
+ISR_PARANOID  8, 1  ; Double Fault
 ISR_NOERRCODE 9     ; Coprocessor Segment Overrun
 ISR_ERRCODE   10    ; Bad TSS
 ISR_ERRCODE   11    ; Segment Not Present
@@ -55,7 +73,7 @@ ISR_ERRCODE   14    ; Page Fault
 ISR_NOERRCODE 15    ; Reserved
 ISR_NOERRCODE 16    ; Coprocessor Fault
 ISR_ERRCODE   17    ; Alignment Check
-ISR_NOERRCODE 18    ; Machine Check
+ISR_PARANOID  18, 0 ; Machine Check
 ISR_NOERRCODE 19    ; Reserved
 ISR_NOERRCODE 20    ; Reserved
 ISR_NOERRCODE 21    ; Reserved
@@ -71,7 +89,7 @@ ISR_ERRCODE   30    ; Security Exception
 ISR_NOERRCODE 31    ; Reserved
 
 ; IRQ handlers (0-15 mapped to 32-47)
-IRQ 0, 32   ; PIT Timer
+IRQ 0, 32, irq_timer_stub   ; PIT Timer
 IRQ 1, 33   ; Keyboard
 IRQ 2, 34   ; Cascade
 IRQ 3, 35   ; COM2
@@ -88,8 +106,47 @@ IRQ 13, 45  ; FPU
 IRQ 14, 46  ; Primary ATA
 IRQ 15, 47  ; Secondary ATA
 
+; Local APIC vectors
+IRQ 17, 49, irq_timer_stub   ; Local APIC timer (per-CPU tick)
+IRQ 18, 50, irq_resched_stub ; Reschedule IPI (work was queued for this CPU)
+
+; Spurious local APIC interrupt - no EOI, nothing to do
+global lapic_spurious_isr
+lapic_spurious_isr:
+    iretq
+
+; Entered from ring 3 (CS of the interrupted code at [rsp + %1]): the
+; GS base still holds the user value, swap in the per-CPU one and stop
+; the task's user-time clock
+%macro SWAPGS_ENTRY_IF_USER 1
+    test qword [rsp + %1], 3
+    jz %%kernel
+    swapgs
+    push rax
+    push rdx
+    USER_TIME_EXIT
+    pop rdx
+    pop rax
+%%kernel:
+%endmacro
+
+; Going back to ring 3: restart the clock and swap the user GS base in
+%macro SWAPGS_EXIT_IF_USER 1
+    test qword [rsp + %1], 3
+    jz %%kernel
+    push rax
+    push rdx
+    USER_TIME_ENTER
+    pop rdx
+    pop rax
+    swapgs
+%%kernel:
+%endmacro
+
 ; Common ISR stub
 isr_common_stub:
+    SWAPGS_ENTRY_IF_USER 24
+    
     ; Save all registers
     push rax
     push rbx
@@ -109,6 +166,8 @@ isr_common_stub:
     
     ; Call C handler (interrupt number is already on stack)
     mov rdi, [rsp + 120]   ; Get interrupt number (after all pushes)
+    mov rsi, [rsp + 128]   ; Error code
+    mov rdx, [rsp + 144]   ; Interrupted CS
     call isr_handler
     
     ; Restore all registers
@@ -128,15 +187,19 @@ isr_common_stub:
     pop rbx
     pop rax
     
+    SWAPGS_EXIT_IF_USER 24
+    
     ; Clean up error code and interrupt number
     add rsp, 16
     
     ; Return from interrupt
     iretq
 
-; Common IRQ stub
-irq_common_stub:
-    ; Save all registers
+; Common stub of the IST exceptions. They can interrupt an entry stub
+; before its swapgs, or an exit path after it, where CS already says
+; kernel but the user GS base is still loaded. So the GS base itself
+; decides: user mode always runs with a zero one.
+isr_paranoid_stub:
     push rax
     push rbx
     push rcx
@@ -153,26 +216,24 @@ irq_common_stub:
     push r14
     push r15
     
-    ; Get IRQ number
-    mov rdi, [rsp + 120]   ; Get IRQ number (after all pushes)
-    sub rdi, 32             ; Convert to IRQ 0-15
-    
-    ; Check if this is IRQ0 (timer) - special handling for preemption
-    cmp rdi, 0
-    jne .regular_irq
-    
-    ; Timer IRQ - handle preemption
-    mov rdi, rsp           ; Pass current stack pointer
-    call preempt_handler
-    mov rsp, rax           ; Use returned stack pointer (may be different process)
-    jmp .restore_and_return
+    xor ebx, ebx            ; RBX = 1 if we swapped (callee-saved)
+    mov ecx, MSR_GS_BASE
+    rdmsr
+    or eax, edx
+    jnz .kernel_gs
+    swapgs
+    mov ebx, 1
+.kernel_gs:
     
-.regular_irq:
-    ; Regular IRQ handling  
-    call irq_handler
+    mov rdi, [rsp + 120]   ; Interrupt number
+    mov rsi, [rsp + 128]   ; Error code
+    mov rdx, [rsp + 144]   ; Interrupted CS
+    call isr_handler
     
-.restore_and_return:
-    ; Restore all registers
+    test ebx, ebx
+    jz .restore
+    swapgs
+.restore:
     pop r15
     pop r14
     pop r13
@@ -189,8 +250,122 @@ irq_common_stub:
     pop rbx
     pop rax
     
-    ; Clean up error code and interrupt number
     add rsp, 16
+    iretq
+
+; Lean IRQ entry. Only the registers a C function may clobber are
+; saved, plus RBX to hold the task stack pointer: the handler preserves
+; the rest itself. It runs on this CPU's IRQ stack - interrupts stay
+; off and no handler switches tasks (they only flag a switch), so that
+; stack is never in use twice. irq_exit then runs pending softirqs on
+; the task stack. Only if a switch was flagged and the interrupted code
+; can be preempted does the stub complete the register frame and call
+; preempt_schedule_irq, which leaves it on the task's stack until the
+; task is resumed.
+;
+; On entry: IRQ number, then the CPU's RIP, CS, RFLAGS, RSP, SS.
+%macro IRQ_ENTRY 1
+    SWAPGS_ENTRY_IF_USER 16
+    
+    ; Caller-clobbered registers (and RBX)
+    push rax
+    push rbx
+    push rcx
+    push rdx
+    push rsi
+    push rdi
+    push r8
+    push r9
+    push r10
+    push r11
+    
+    mov rdi, [rsp + 80]     ; IRQ number (irq_handler's argument)
+    mov rbx, rsp            ; Task stack, kept across the call
+    mov rax, [gs:CPU_IRQ_STACK]
+    test rax, rax
+    jz %%call               ; Not set up yet (early boot)
+    mov rsp, rax
+%%call:
+    call %1
+    mov rsp, rbx
+    
+    ; Device acknowledged - run deferred work with interrupts enabled
+    call irq_exit
+    
+    ; Switch flagged by a handler (or held back earlier)?
+    cmp byte [gs:CPU_NEED_RESCHED], 0
+    jne %%resched
+    
+%%restore:
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rdi
+    pop rsi
+    pop rdx
+    pop rcx
+    pop rbx
+    pop rax
+    
+    SWAPGS_EXIT_IF_USER 16
+    
+    ; Clean up IRQ number
+    add rsp, 8
     
     ; Return from interrupt
     iretq
+    
+%%resched:
+    ; Inside preempt_disable() preempt_enable() makes the switch
+    cmp dword [gs:CPU_PREEMPT_COUNT], 0
+    jne %%restore
+    
+    ; Full frame: the callee-saved registers join the rest
+    push rbp
+    push r12
+    push r13
+    push r14
+    push r15
+    sub rsp, 8              ; Keep RSP 16-byte aligned
+    call preempt_schedule_irq
+    add rsp, 8
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop rbp
+    jmp %%restore
+%endmacro
+
+; Device IRQs (irq/irqdesc.c)
+irq_common_stub:
+    IRQ_ENTRY irq_handler
+
+; PIT / HPET / local APIC timer tick
+irq_timer_stub:
+    IRQ_ENTRY preempt_handler
+
+; Reschedule IPI - another CPU queued work for us
+irq_resched_stub:
+    IRQ_ENTRY resched_handler
+
+; Stub addresses in vector order, for interrupts_init()
+section .rodata
+align 8
+
+global isr_stub_table
+isr_stub_table:
+%assign i 0
+%rep 32
+    dq isr %+ i
+%assign i i + 1
+%endrep
+
+global irq_stub_table
+irq_stub_table:
+%assign i 0
+%rep 16
+    dq irq %+ i
+%assign i i + 1
+%endrep
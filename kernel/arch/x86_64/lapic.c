@@ -0,0 +1,331 @@
+// Local APIC driver (x2APIC through MSRs, or memory-mapped xAPIC)
+
+#include "lapic.h"
+#include "cpu.h"
+#include "percpu.h"
+#include "interrupts.h"
+#include "../../time/ktime.h"
+#include "../../acpi/acpi.h"
+#include "../../mm/paging.h"
+#include "../../../drivers/pit.h"
+#include "../../../drivers/hpet.h"
+#include "../../../drivers/vga.h"
+
+// Per-CPU timer state (indexed by logical CPU number)
+typedef struct {
+    uint8_t periodic;          // Reloading every tick
+    uint8_t oneshot_active;    // One-shot countdown pending
+    uint8_t skip_next_irq;     // Pending interrupt already accounted for
+    uint8_t deadline_mode;     // LVT timer is in TSC-deadline mode
+    uint32_t oneshot_ticks;    // Ticks the pending countdown represents
+    uint32_t oneshot_count;    // Count loaded for the pending countdown
+    uint32_t carry;            // Counts already elapsed into the current tick
+} lapic_timer_state_t;
+
+static volatile uint32_t* lapic_base = 0;
+static uint8_t x2apic = 0;             // Registers are MSRs (all CPUs agree)
+static uint32_t counts_per_tick = 0;
+static lapic_timer_state_t timer_state[MAX_CPUS];
+
+// x2APIC register n lives in MSR 0x800 + n / 16
+static inline uint32_t lapic_read(uint32_t reg) {
+    if (x2apic) {
+        return (uint32_t)rdmsr(MSR_X2APIC_BASE + (reg >> 4));
+    }
+    return lapic_base[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    if (x2apic) {
+        wrmsr(MSR_X2APIC_BASE + (reg >> 4), value);
+        return;
+    }
+    lapic_base[reg / 4] = value;
+}
+
+// Send an IPI. The xAPIC ICR is two registers (high half first) and
+// reports delivery status; the x2APIC ICR is a single MSR write.
+static void lapic_write_icr(uint32_t apic_id, uint32_t low) {
+    if (x2apic) {
+        wrmsr(MSR_X2APIC_BASE + (LAPIC_REG_ICR_LOW >> 4), ((uint64_t)apic_id << 32) | low);
+        return;
+    }
+    
+    lapic_write(LAPIC_REG_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_REG_ICR_LOW, low);
+    while (lapic_read(LAPIC_REG_ICR_LOW) & (1 << 12)) {
+        cpu_relax();
+    }
+}
+
+// Switch the executing CPU's APIC into x2APIC mode (xAPIC first, as
+// going straight from disabled to x2APIC is not allowed)
+static void lapic_enable_x2apic(void) {
+    uint64_t base = rdmsr(MSR_IA32_APIC_BASE);
+    if (!(base & APIC_BASE_ENABLE)) {
+        base |= APIC_BASE_ENABLE;
+        wrmsr(MSR_IA32_APIC_BASE, base);
+    }
+    wrmsr(MSR_IA32_APIC_BASE, base | APIC_BASE_X2APIC);
+}
+
+// Enable the local APIC
+int lapic_init(void) {
+    if (!lapic_available()) {
+        // Only the BSP gets here - pick the mode every CPU will use
+        uint32_t eax, ebx, ecx, edx;
+        cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+        if (!(edx & (1 << 9))) {
+            return -1;  // No local APIC
+        }
+        
+#if LAPIC_USE_X2APIC
+        if (ecx & (1 << 21)) {
+            x2apic = 1;
+        }
+#endif
+        if (!x2apic) {
+            uint64_t phys = rdmsr(MSR_IA32_APIC_BASE) & ~0xFFFULL;
+            const acpi_madt_info_t* madt = acpi_get_madt_info();
+            if (madt && madt->lapic_address) {
+                phys = madt->lapic_address;
+            }
+            
+            paging_map_mmio(phys, 0x1000);
+            lapic_base = (volatile uint32_t*)phys;
+        }
+    }
+    
+    // Globally enable in the APIC base MSR
+    if (x2apic) {
+        lapic_enable_x2apic();
+    } else {
+        wrmsr(MSR_IA32_APIC_BASE, rdmsr(MSR_IA32_APIC_BASE) | APIC_BASE_ENABLE);
+    }
+    
+    // Accept all priorities, software-enable with our spurious vector
+    lapic_write(LAPIC_REG_TPR, 0);
+    lapic_write(LAPIC_REG_SVR, 0x100 | LAPIC_SPURIOUS_VECTOR);
+    
+    // The BSP keeps LINT0 as ExtINT so the 8259 still reaches it;
+    // application processors mask both local interrupt pins
+    if (this_cpu()->id != 0) {
+        lapic_write(LAPIC_REG_LVT_LINT0, 1 << 16);
+        lapic_write(LAPIC_REG_LVT_LINT1, 1 << 16);
+    }
+    
+    // Timer stays masked until the scheduler takes it over
+    lapic_write(LAPIC_REG_LVT_TIMER, (1 << 16) | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_TIMER_DIV, 0x3);  // Divide by 16
+    
+    // Clear any stale error state
+    lapic_write(LAPIC_REG_ESR, 0);
+    lapic_write(LAPIC_REG_ESR, 0);
+    lapic_eoi();
+    
+    return 0;
+}
+
+// Check whether the local APIC is usable
+int lapic_available(void) {
+    return x2apic || lapic_base != 0;
+}
+
+// Check whether the registers are accessed through MSRs
+int lapic_is_x2apic(void) {
+    return x2apic;
+}
+
+// Get local APIC ID (full 32 bits in x2APIC mode)
+uint32_t lapic_get_id(void) {
+    uint32_t id = lapic_read(LAPIC_REG_ID);
+    return x2apic ? id : id >> 24;
+}
+
+// End of interrupt - one MSR write in x2APIC mode (no MMIO exit)
+void lapic_eoi(void) {
+    if (x2apic) {
+        wrmsr(MSR_X2APIC_EOI, 0);
+        return;
+    }
+    lapic_base[LAPIC_REG_EOI / 4] = 0;
+}
+
+// Stop passing 8259 interrupts through LINT0 (the I/O APIC took over)
+void lapic_disable_extint(void) {
+    lapic_write(LAPIC_REG_LVT_LINT0, 1 << 16);
+}
+
+// INIT IPI (assert, level triggered)
+void lapic_send_init(uint32_t apic_id) {
+    lapic_write_icr(apic_id, 0x00004500);
+}
+
+// STARTUP IPI - AP starts in real mode at vector_page * 4096
+void lapic_send_sipi(uint32_t apic_id, uint8_t vector_page) {
+    lapic_write_icr(apic_id, 0x00004600 | vector_page);
+}
+
+// Fixed-delivery IPI (xAPIC ICR is written in two halves - keep interrupts out)
+void lapic_send_ipi(uint32_t apic_id, uint8_t vector) {
+    uint64_t flags = irq_save();
+    lapic_write_icr(apic_id, 0x00004000 | vector);
+    irq_restore(flags);
+}
+
+// Calibrate the timer against one tick of the HPET (or the PIT)
+void lapic_timer_calibrate(void) {
+    lapic_write(LAPIC_REG_TIMER_DIV, 0x3);
+    lapic_write(LAPIC_REG_LVT_TIMER, (1 << 16) | LAPIC_TIMER_VECTOR);
+    
+    if (hpet_available()) {
+        // Scale by the measured window rather than trusting the delay
+        uint64_t flags = irq_save();
+        uint64_t start = hpet_read();
+        lapic_write(LAPIC_REG_TIMER_INIT, 0xFFFFFFFF);
+        hpet_delay_us(1000000 / TIMER_FREQUENCY);
+        uint32_t counts = 0xFFFFFFFF - lapic_read(LAPIC_REG_TIMER_CUR);
+        uint64_t ns = hpet_ticks_to_ns(hpet_read() - start);
+        irq_restore(flags);
+        counts_per_tick = (uint32_t)(((uint64_t)counts * TICK_NSEC) / ns);
+    } else {
+        lapic_write(LAPIC_REG_TIMER_INIT, 0xFFFFFFFF);
+        pit_delay_us(1000000 / TIMER_FREQUENCY);
+        counts_per_tick = 0xFFFFFFFF - lapic_read(LAPIC_REG_TIMER_CUR);
+    }
+    lapic_write(LAPIC_REG_TIMER_INIT, 0);
+    
+    vga_print("[LAPIC] Timer: ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(counts_per_tick, VGA_COLOR_LIGHT_CYAN);
+    vga_print(" counts per tick\n", VGA_COLOR_LIGHT_GREEN);
+}
+
+// Longest one-shot interval
+uint32_t lapic_timer_max_ticks(void) {
+    if (!counts_per_tick) {
+        return 1;
+    }
+    return 0xFFFFFFFF / counts_per_tick;
+}
+
+// Fire every tick
+void lapic_timer_set_periodic(void) {
+    lapic_timer_state_t* st = &timer_state[this_cpu()->id];
+    if (st->periodic) {
+        return;
+    }
+    
+    st->periodic = 1;
+    st->oneshot_active = 0;
+    st->carry = 0;
+    st->deadline_mode = 0;
+    lapic_write(LAPIC_REG_LVT_TIMER, (1 << 17) | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_TIMER_INIT, counts_per_tick);
+}
+
+// Fire once after some ticks
+void lapic_timer_set_oneshot(uint32_t ticks) {
+    lapic_timer_state_t* st = &timer_state[this_cpu()->id];
+    uint32_t max = lapic_timer_max_ticks();
+    
+    if (ticks == 0) ticks = 1;
+    if (ticks > max) ticks = max;
+    
+    // Stay aligned to the tick grid
+    uint32_t count = ticks * counts_per_tick - st->carry;
+    st->carry = 0;
+    
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_TIMER_INIT, count);
+    
+    st->deadline_mode = 0;
+    st->periodic = 0;
+    st->oneshot_active = 1;
+    st->oneshot_ticks = ticks;
+    st->oneshot_count = count;
+}
+
+// Stop a pending one-shot and credit elapsed whole ticks
+uint64_t lapic_timer_cancel_oneshot(void) {
+    lapic_timer_state_t* st = &timer_state[this_cpu()->id];
+    if (!st->oneshot_active) {
+        return 0;
+    }
+    
+    uint32_t current = lapic_read(LAPIC_REG_TIMER_CUR);
+    lapic_write(LAPIC_REG_TIMER_INIT, 0);
+    st->oneshot_active = 0;
+    
+    // Already expired: the interrupt is pending, credit it now
+    if (current == 0) {
+        st->carry = 0;
+        st->skip_next_irq = 1;
+        return st->oneshot_ticks;
+    }
+    
+    uint32_t elapsed = (st->oneshot_ticks * counts_per_tick - st->oneshot_count) +
+                       (st->oneshot_count - current);
+    st->carry = elapsed % counts_per_tick;
+    return elapsed / counts_per_tick;
+}
+
+// Timer interrupt bookkeeping
+uint64_t lapic_timer_handler(void) {
+    lapic_timer_state_t* st = &timer_state[this_cpu()->id];
+    
+    if (st->skip_next_irq) {
+        st->skip_next_irq = 0;
+        return 0;
+    }
+    if (st->oneshot_active) {
+        st->oneshot_active = 0;
+        return st->oneshot_ticks;
+    }
+    return 1;
+}
+
+// TSC-deadline mode: the timer fires when the TSC reaches a value
+int lapic_timer_has_tsc_deadline(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+    return (ecx & (1 << 24)) != 0;
+}
+
+// Fire once the TSC reaches 'tsc' (a deadline in the past fires at once)
+void lapic_timer_set_deadline(uint64_t tsc) {
+    lapic_timer_state_t* st = &timer_state[this_cpu()->id];
+    
+    if (!st->deadline_mode) {
+        lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_MODE_DEADLINE | LAPIC_TIMER_VECTOR);
+        // The MMIO write must land before the MSR write arms the timer
+        __asm__ volatile("mfence" : : : "memory");
+        st->deadline_mode = 1;
+        st->periodic = 0;
+        st->oneshot_active = 0;
+    }
+    wrmsr(MSR_IA32_TSC_DEADLINE, tsc ? tsc : 1);
+}
+
+// Fire once after 'ns' nanoseconds (rounded to timer counts)
+void lapic_timer_set_oneshot_ns(uint64_t ns) {
+    lapic_timer_state_t* st = &timer_state[this_cpu()->id];
+    uint64_t count = (ns * counts_per_tick) / TICK_NSEC;
+    
+    if (count == 0) count = 1;
+    if (count > 0xFFFFFFFF) count = 0xFFFFFFFF;
+    
+    st->deadline_mode = 0;
+    st->periodic = 0;
+    st->oneshot_active = 0;
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_REG_TIMER_INIT, (uint32_t)count);
+}
+
+// Disarm whichever mode is in use
+void lapic_timer_stop(void) {
+    if (timer_state[this_cpu()->id].deadline_mode) {
+        wrmsr(MSR_IA32_TSC_DEADLINE, 0);
+    } else {
+        lapic_write(LAPIC_REG_TIMER_INIT, 0);
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef KERNEL_ARCH_X86_64_LAPIC_H
+#define KERNEL_ARCH_X86_64_LAPIC_H
+
+#include <stdint.h>
+
+// Set to 1 to drive the local APIC through MSRs when the CPU supports
+// x2APIC (no MMIO, cheaper EOI and IPIs under virtualization)
+#define LAPIC_USE_X2APIC 1
+
+// APIC base MSR bits
+#define APIC_BASE_X2APIC      (1ULL << 10)
+#define APIC_BASE_ENABLE      (1ULL << 11)
+
+// x2APIC register MSRs (MSR_X2APIC_BASE + offset / 16)
+#define MSR_X2APIC_BASE       0x800
+#define MSR_X2APIC_EOI        0x80B
+
+// Local APIC register offsets
+#define LAPIC_REG_ID          0x020
+#define LAPIC_REG_VERSION     0x030
+#define LAPIC_REG_TPR         0x080
+#define LAPIC_REG_EOI         0x0B0
+#define LAPIC_REG_SVR         0x0F0
+#define LAPIC_REG_ESR         0x280
+#define LAPIC_REG_ICR_LOW     0x300
+#define LAPIC_REG_ICR_HIGH    0x310
+#define LAPIC_REG_LVT_TIMER   0x320
+#define LAPIC_REG_LVT_LINT0   0x350
+#define LAPIC_REG_LVT_LINT1   0x360
+#define LAPIC_REG_LVT_ERROR   0x370
+#define LAPIC_REG_TIMER_INIT  0x380
+#define LAPIC_REG_TIMER_CUR   0x390
+#define LAPIC_REG_TIMER_DIV   0x3E0
+
+// LVT timer modes (bits 17-18)
+#define LAPIC_TIMER_MODE_PERIODIC (1 << 17)
+#define LAPIC_TIMER_MODE_DEADLINE (2 << 17)
+
+// Vectors owned by the local APIC (handled like IRQ 17/18 and spurious)
+#define LAPIC_TIMER_VECTOR    0x31
+#define LAPIC_RESCHED_VECTOR  0x32
+#define LAPIC_SPURIOUS_VECTOR 0xFF
+
+// Enable the local APIC of the executing CPU
+// Returns 0 on success, -1 if there is no usable local APIC
+int lapic_init(void);
+
+// Check whether the local APIC has been set up
+int lapic_available(void);
+
+// Check whether it runs in x2APIC mode
+int lapic_is_x2apic(void);
+
+// Local APIC ID of the executing CPU
+uint32_t lapic_get_id(void);
+
+// Signal end of interrupt
+void lapic_eoi(void);
+
+// Mask LINT0 on the executing CPU (8259 virtual wire no longer used)
+void lapic_disable_extint(void);
+
+// Send INIT and STARTUP IPIs to wake an application processor
+void lapic_send_init(uint32_t apic_id);
+void lapic_send_sipi(uint32_t apic_id, uint8_t vector_page);
+
+// Send a fixed interrupt to another CPU
+void lapic_send_ipi(uint32_t apic_id, uint8_t vector);
+
+// Measure timer counts per scheduler tick against the PIT (once, on the BSP)
+void lapic_timer_calibrate(void);
+
+// Longest one-shot interval the timer can hold (in ticks)
+uint32_t lapic_timer_max_ticks(void);
+
+// Timer programming for the executing CPU (same contract as the PIT helpers)
+void lapic_timer_set_periodic(void);
+void lapic_timer_set_oneshot(uint32_t ticks);
+uint64_t lapic_timer_cancel_oneshot(void);
+
+// Timer interrupt bookkeeping - returns ticks elapsed since the previous one
+uint64_t lapic_timer_handler(void);
+
+// Clock-event programming (time/clockevent.c). These bypass the tick
+// bookkeeping above: one interrupt at an absolute TSC value, or after
+// a relative number of nanoseconds.
+int lapic_timer_has_tsc_deadline(void);
+void lapic_timer_set_deadline(uint64_t tsc);
+void lapic_timer_set_oneshot_ns(uint64_t ns);
+void lapic_timer_stop(void);
+
+#endif // KERNEL_ARCH_X86_64_LAPIC_H
@@ -0,0 +1,66 @@
+#ifndef KERNEL_ARCH_X86_64_PERCPU_H
+#define KERNEL_ARCH_X86_64_PERCPU_H
+
+#include <stdint.h>
+#include "gdt.h"
+#include "../../proc/process.h"
+#include "../../sync/rcu_types.h"
+#include "../../irq/softirq_types.h"
+#include "../../irq/irqdesc_types.h"
+#include "../../time/hrtimer_types.h"
+
+#define MAX_CPUS 16
+
+// Per-CPU data, reached through the GS base
+typedef struct cpu {
+    struct cpu* self;          // Must stay first: this_cpu() loads %gs:0
+    uint32_t id;               // Logical CPU number (0 = bootstrap processor)
+    uint32_t apic_id;          // Local APIC ID
+    volatile uint8_t online;   // Set by the CPU once it can run tasks
+    uint8_t lapic_timer;       // Ticks come from the local APIC timer
+    void* boot_stack;          // Stack used until the first task switch (APs)
+    uint64_t kernel_rsp;       // Top of the running task's kernel stack (SYSCALL entry)
+    uint64_t user_rsp;         // User RSP while the SYSCALL entry switches stacks
+    uint64_t pf_retry_addr;    // Last user page fault retried as a stale TLB entry
+    scheduler_t sched;         // This CPU's run queue
+    volatile uint32_t preempt_count;  // Nonzero: no involuntary switches (preempt.h)
+    volatile uint8_t need_resched;    // A switch was held back by preempt_count
+    rcu_cpu_t rcu;             // Pending RCU callbacks (sync/rcu.h)
+    process_t* fpu_owner;      // Task whose FPU state is in the registers (fpu.h)
+    softirq_cpu_t softirq;     // Pending bottom halves (irq/softirq.h)
+    hrtimer_cpu_t hrtimer;     // Pending high-resolution timers (time/hrtimer.h)
+    uint64_t gdt[GDT_ENTRIES]; // This CPU's descriptor table (gdt.h)
+    tss_t tss;                 // RSP0 follows the running task
+    uint8_t* ist_stack;        // IST_COUNT stacks of IST_STACK_SIZE (gdt.h)
+    uint64_t irq_stack;        // Top of the IRQ handler stack (isr.asm)
+    irq_stat_t irq_stats[IRQ_LINES];  // Interrupts taken per line (irq/irqdesc.h)
+} cpu_t;
+
+// Get the per-CPU data of the executing CPU
+static inline cpu_t* this_cpu(void) {
+    cpu_t* cpu;
+    __asm__ volatile("mov %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+// Kernel stack for entries from ring 3: TSS RSP0 for interrupts and
+// exceptions, kernel_rsp for SYSCALL (called on every task switch)
+static inline void cpu_set_kernel_stack(uint64_t top) {
+    cpu_t* cpu = this_cpu();
+    cpu->tss.rsp0 = top;
+    cpu->kernel_rsp = top;
+}
+
+// Point the GS base of the executing CPU at its per-CPU data
+void percpu_init(cpu_t* cpu);
+
+// Set up per-CPU data for the bootstrap processor (before interrupts)
+void percpu_init_boot_cpu(void);
+
+// Get per-CPU data by logical CPU number (NULL if out of range)
+cpu_t* cpu_get(uint32_t id);
+
+// Number of CPUs brought online
+uint32_t cpu_count(void);
+
+#endif // KERNEL_ARCH_X86_64_PERCPU_H
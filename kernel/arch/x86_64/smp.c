@@ -0,0 +1,191 @@
+// SMP bring-up - per-CPU data and application processor startup
+
+#include "smp.h"
+#include "cpu.h"
+#include "fpu.h"
+#include "gdt.h"
+#include "lapic.h"
+#include "ioapic.h"
+#include "idt.h"
+#include "interrupts.h"
+#include "../../acpi/acpi.h"
+#include "../../mm/kheap.h"
+#include "../../proc/process.h"
+#include "../../proc/syscall.h"
+#include "../../time/tick.h"
+#include "../../time/clockevent.h"
+#include "../../time/ktime.h"
+#include "../../../drivers/vga.h"
+
+// Trampoline image and its parameter block (ap_trampoline.asm)
+extern uint8_t ap_trampoline_start[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_trampoline_cr3[];
+extern uint8_t ap_trampoline_stack[];
+extern uint8_t ap_trampoline_cpu[];
+extern uint8_t ap_trampoline_entry[];
+
+static cpu_t cpus[MAX_CPUS];
+
+// Exception and interrupt stacks of the bootstrap processor (the heap
+// may not be up yet when it loads its TSS); APs get theirs from kmalloc
+static uint8_t bsp_ist_stacks[IST_COUNT * IST_STACK_SIZE] __attribute__((aligned(16)));
+static uint8_t bsp_irq_stack[IRQ_STACK_SIZE] __attribute__((aligned(16)));
+static volatile uint32_t cpus_online = 0;
+
+// Address of a trampoline symbol inside the copy at AP_TRAMPOLINE_BASE
+static inline volatile uint64_t* trampoline_param(uint8_t* symbol) {
+    return (volatile uint64_t*)(AP_TRAMPOLINE_BASE + (uint64_t)(symbol - ap_trampoline_start));
+}
+
+// Point GS at per-CPU data
+void percpu_init(cpu_t* cpu) {
+    cpu->self = cpu;
+    wrmsr(MSR_GS_BASE, (uint64_t)cpu);
+}
+
+// Bootstrap processor per-CPU data
+void percpu_init_boot_cpu(void) {
+    cpu_t* cpu = &cpus[0];
+    
+    cpu->id = 0;
+    cpu->apic_id = 0;
+    cpu->lapic_timer = 0;
+    cpu->boot_stack = 0;
+    cpu->ist_stack = bsp_ist_stacks;
+    cpu->irq_stack = (uint64_t)bsp_irq_stack + IRQ_STACK_SIZE;
+    percpu_init(cpu);
+    gdt_init_cpu(cpu);
+    
+    cpu->online = 1;
+    cpus_online = 1;
+}
+
+// Per-CPU data by logical number
+cpu_t* cpu_get(uint32_t id) {
+    if (id >= cpus_online) {
+        return 0;
+    }
+    return &cpus[id];
+}
+
+// Number of CPUs online
+uint32_t cpu_count(void) {
+    return cpus_online;
+}
+
+// Wake one application processor and wait for it to report in
+static int smp_start_ap(cpu_t* cpu) {
+    // Parameters for this AP (one AP is started at a time)
+    *trampoline_param(ap_trampoline_stack) = (uint64_t)cpu->boot_stack + AP_STACK_SIZE;
+    *trampoline_param(ap_trampoline_cpu) = (uint64_t)cpu;
+    
+    // INIT-SIPI-SIPI (the second STARTUP IPI only if the first was missed)
+    lapic_send_init(cpu->apic_id);
+    ktime_udelay(10000);
+    
+    lapic_send_sipi(cpu->apic_id, AP_TRAMPOLINE_BASE >> 12);
+    ktime_udelay(200);
+    if (!cpu->online) {
+        lapic_send_sipi(cpu->apic_id, AP_TRAMPOLINE_BASE >> 12);
+    }
+    
+    for (uint32_t waited = 0; !cpu->online && waited < AP_STARTUP_TIMEOUT_US; waited += 100) {
+        ktime_udelay(100);
+    }
+    
+    return cpu->online ? 0 : -1;
+}
+
+// Start every application processor listed in the MADT
+void smp_init(void) {
+    cpu_t* bsp = &cpus[0];
+    
+    if (acpi_init() != 0 || lapic_init() != 0) {
+        vga_print("[SMP] No ACPI/local APIC - running on the boot CPU only\n", VGA_COLOR_LIGHT_BROWN);
+        return;
+    }
+    
+    bsp->apic_id = lapic_get_id();
+    lapic_timer_calibrate();
+    clockevent_init();
+    
+    // ISA interrupts through the I/O APIC from now on (the 8259 is kept
+    // if there is none)
+    ioapic_init();
+    
+    const acpi_madt_info_t* madt = acpi_get_madt_info();
+    if (!madt || madt->cpu_count <= 1) {
+        vga_print("[SMP] 1 CPU online\n", VGA_COLOR_LIGHT_GREEN);
+        return;
+    }
+    
+    // Install the trampoline below 1 MB, sharing the kernel page tables
+    uint8_t* dest = (uint8_t*)AP_TRAMPOLINE_BASE;
+    for (uint8_t* src = ap_trampoline_start; src < ap_trampoline_end; src++) {
+        *dest++ = *src;
+    }
+    
+    uint64_t cr3;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(cr3));
+    *trampoline_param(ap_trampoline_cr3) = cr3;
+    *trampoline_param(ap_trampoline_entry) = (uint64_t)ap_main;
+    
+    for (uint32_t i = 0; i < madt->cpu_count && cpus_online < MAX_CPUS; i++) {
+        if (madt->cpu_apic_ids[i] == bsp->apic_id) {
+            continue;
+        }
+        
+        cpu_t* cpu = &cpus[cpus_online];
+        cpu->id = cpus_online;
+        cpu->apic_id = madt->cpu_apic_ids[i];
+        cpu->online = 0;
+        cpu->lapic_timer = 0;
+        cpu->boot_stack = cpu->boot_stack ? cpu->boot_stack : kmalloc(AP_STACK_SIZE);
+        cpu->ist_stack = cpu->ist_stack ? cpu->ist_stack : (uint8_t*)kmalloc(IST_COUNT * IST_STACK_SIZE);
+        if (!cpu->irq_stack) {
+            void* irq_stack = kmalloc(IRQ_STACK_SIZE);
+            cpu->irq_stack = irq_stack ? ((uint64_t)irq_stack + IRQ_STACK_SIZE) & ~0xFULL : 0;
+        }
+        if (!cpu->boot_stack || !cpu->ist_stack || !cpu->irq_stack) {
+            vga_print("[SMP] Out of memory for AP stacks\n", VGA_COLOR_LIGHT_RED);
+            break;
+        }
+        
+        if (smp_start_ap(cpu) == 0) {
+            cpus_online++;
+        } else {
+            // Slot (and stack) is reused for the next candidate
+            vga_print("[SMP] CPU with APIC ID ", VGA_COLOR_LIGHT_RED);
+            vga_print_int(cpu->apic_id, VGA_COLOR_LIGHT_RED);
+            vga_print(" did not start\n", VGA_COLOR_LIGHT_RED);
+        }
+    }
+    
+    vga_print("[SMP] ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(cpus_online, VGA_COLOR_LIGHT_GREEN);
+    vga_print(" CPUs online\n", VGA_COLOR_LIGHT_GREEN);
+}
+
+// Application processor entry (on its boot stack, interrupts disabled)
+void ap_main(cpu_t* cpu) {
+    percpu_init(cpu);
+    gdt_init_cpu(cpu);
+    idt_reload();
+    fpu_init();
+    syscall_init_cpu();
+    lapic_init();
+    
+    // Own run queue and idle task, ticked by the local APIC timer
+    scheduler_init_cpu();
+    tick_use_lapic();
+    
+    cpu->online = 1;
+    
+    // Run the idle task until work is queued on this CPU
+    scheduler_start_cpu();
+    
+    for (;;) {
+        __asm__ volatile("cli; hlt");
+    }
+}
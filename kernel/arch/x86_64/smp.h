@@ -0,0 +1,24 @@
+#ifndef KERNEL_ARCH_X86_64_SMP_H
+#define KERNEL_ARCH_X86_64_SMP_H
+
+#include <stdint.h>
+#include "percpu.h"
+
+// Physical page the AP startup code is copied to (must be below 1 MB and
+// match AP_TRAMPOLINE_BASE in ap_trampoline.asm)
+#define AP_TRAMPOLINE_BASE 0x8000
+
+// Boot stack for each application processor
+#define AP_STACK_SIZE 16384
+
+// How long to wait for an AP to report in (microseconds)
+#define AP_STARTUP_TIMEOUT_US 1000000
+
+// Enumerate CPUs from the ACPI MADT and start every application processor
+// (BSP only; each AP comes up running its own idle task)
+void smp_init(void);
+
+// First C code run by an application processor (called from the trampoline)
+void ap_main(cpu_t* cpu);
+
+#endif // KERNEL_ARCH_X86_64_SMP_H
@@ -0,0 +1,184 @@
+; System call entry points (see proc/syscall.h)
+; SYSCALL arrives with RCX = user RIP, R11 = user RFLAGS, interrupts off
+; (SFMASK) and the user's RSP and GS base still loaded. swapgs makes the
+; per-CPU data reachable, which holds the running task's kernel stack.
+; The int 0x80 gate gets the same registers through a normal interrupt
+; frame instead. Both index syscall_table with RAX and hand back every
+; register except RAX unchanged.
+
+%include "asm_offsets.inc"
+%include "user_time.inc"
+
+GDT_USER_DATA equ 0x18
+GDT_USER_CODE equ 0x20
+USER_RIP_MAX  equ 0x00007FFFFFFFF000
+
+global syscall_entry
+global syscall_int80_entry
+global user_enter
+
+extern syscall_table
+
+section .text
+bits 64
+
+syscall_entry:
+    swapgs
+    mov [gs:CPU_USER_RSP], rsp
+    mov rsp, [gs:CPU_KERNEL_RSP]
+
+    ; Return state first: the stack is ours, interrupts may come in
+    push qword [gs:CPU_USER_RSP]
+    push r11
+    push rcx
+
+    ; RCX and R11 are saved, they keep RAX and RDX meanwhile
+    mov rcx, rdx
+    mov r11, rax
+    USER_TIME_EXIT
+    mov rax, r11
+    mov rdx, rcx
+    sti
+
+    push rdi
+    push rsi
+    push rdx
+    push r10
+    push r8
+    push r9
+    sub rsp, 8              ; 10 slots: keep the call 16-byte aligned
+
+    cmp rax, SYSCALL_COUNT
+    jae .bad_nr
+    mov rcx, r10            ; Fourth argument in the C convention
+    lea r11, [rel syscall_table]
+    call [r11 + rax * 8]
+.done:
+    cli
+    mov r11, rax            ; Reloaded from the frame below
+    USER_TIME_ENTER
+    mov rax, r11
+
+    add rsp, 8
+    pop r9
+    pop r8
+    pop r10
+    pop rdx
+    pop rsi
+    pop rdi
+
+    ; SYSRET to a non-canonical RIP faults in ring 0 on some CPUs; let
+    ; iretq raise that fault in ring 3 instead
+    mov rcx, [rsp]
+    mov r11, USER_RIP_MAX
+    cmp rcx, r11
+    jae .iret
+
+    mov r11, [rsp + 8]
+    mov rsp, [rsp + 16]
+    swapgs
+    o64 sysret
+
+.iret:
+    ; Rebuild [RIP, RFLAGS, RSP] as an interrupt frame in place
+    mov rcx, [rsp + 8]
+    mov r11, [rsp + 16]
+    mov qword [rsp + 16], GDT_USER_DATA | 3
+    mov [rsp + 8], r11
+    mov r11, [rsp]
+    mov [rsp], rcx
+    push qword GDT_USER_CODE | 3
+    push r11
+    swapgs
+    iretq
+
+.bad_nr:
+    mov rax, -SYSCALL_ENOSYS
+    jmp .done
+
+; int 0x80: interrupt gate, DPL 3
+syscall_int80_entry:
+    ; From user mode the GS base is still the user's
+    test qword [rsp + 8], 3
+    jz .from_kernel
+    swapgs
+    push rax
+    push rdx
+    USER_TIME_EXIT
+    pop rdx
+    pop rax
+.from_kernel:
+    sti
+
+    push rdi
+    push rsi
+    push rdx
+    push r10
+    push r8
+    push r9
+    push rcx
+    push r11
+    sub rsp, 8              ; CPU frame (5) + 9 slots: aligned
+
+    cmp rax, SYSCALL_COUNT
+    jae .bad_nr
+    mov rcx, r10
+    lea r11, [rel syscall_table]
+    call [r11 + rax * 8]
+.done:
+    add rsp, 8
+    pop r11
+    pop rcx
+    pop r9
+    pop r8
+    pop r10
+    pop rdx
+    pop rsi
+    pop rdi
+
+    cli
+    test qword [rsp + 8], 3
+    jz .to_kernel
+    push rax
+    push rdx
+    USER_TIME_ENTER
+    pop rdx
+    pop rax
+    swapgs
+.to_kernel:
+    iretq
+
+.bad_nr:
+    mov rax, -SYSCALL_ENOSYS
+    jmp .done
+
+; void user_enter(uint64_t rip, uint64_t rsp) - first entry of a task
+; into ring 3, through an interrupt frame built here
+user_enter:
+    cli
+    USER_TIME_ENTER
+    push qword GDT_USER_DATA | 3
+    push rsi
+    push qword 0x202        ; IF (and the always-set bit)
+    push qword GDT_USER_CODE | 3
+    push rdi
+
+    ; No kernel values reach user mode
+    xor eax, eax
+    xor ebx, ebx
+    xor ecx, ecx
+    xor edx, edx
+    xor esi, esi
+    xor edi, edi
+    xor ebp, ebp
+    xor r8d, r8d
+    xor r9d, r9d
+    xor r10d, r10d
+    xor r11d, r11d
+    xor r12d, r12d
+    xor r13d, r13d
+    xor r14d, r14d
+    xor r15d, r15d
+
+    swapgs
+    iretq
@@ -5,6 +5,7 @@
 static const multiboot_tag_mmap_t* mmap_tag = 0;
 static const multiboot_tag_basic_meminfo_t* meminfo_tag = 0;
 static const multiboot_tag_string_t* bootloader_tag = 0;
+static const multiboot_tag_acpi_t* acpi_tag = 0;
 
 // Helper to convert number to string
 static void uint64_to_str(uint64_t num, char* buf) {
@@ -51,6 +52,14 @@ void multiboot2_parse(uint32_t magic, uint64_t addr) {
                 // Command line
                 break;
                 
+            case MULTIBOOT_TAG_TYPE_ACPI_OLD:
+            case MULTIBOOT_TAG_TYPE_ACPI_NEW:
+                // Prefer the ACPI 2.0+ RSDP (XSDT) when both are present
+                if (!acpi_tag || tag->type == MULTIBOOT_TAG_TYPE_ACPI_NEW) {
+                    acpi_tag = (multiboot_tag_acpi_t*)tag;
+                }
+                break;
+                
             case MULTIBOOT_TAG_TYPE_BOOT_LOADER_NAME:
                 bootloader_tag = (multiboot_tag_string_t*)tag;
                 vga_print("    Bootloader: ", VGA_COLOR_WHITE);
@@ -144,3 +153,11 @@ const char* multiboot2_get_bootloader_name(void) {
     }
     return "Unknown";
 }
+
+// Get ACPI RSDP
+const void* multiboot2_get_rsdp(void) {
+    if (acpi_tag) {
+        return acpi_tag->rsdp;
+    }
+    return 0;
+}
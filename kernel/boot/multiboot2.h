@@ -75,6 +75,13 @@ typedef struct {
     char string[0];
 } __attribute__((packed)) multiboot_tag_string_t;
 
+// ACPI RSDP copy (old = ACPI 1.0, new = ACPI 2.0+)
+typedef struct {
+    uint32_t type;
+    uint32_t size;
+    uint8_t rsdp[0];
+} __attribute__((packed)) multiboot_tag_acpi_t;
+
 // Multiboot info structure
 typedef struct {
     uint32_t total_size;
@@ -94,4 +101,7 @@ const multiboot_tag_basic_meminfo_t* multiboot2_get_basic_meminfo(void);
 // Get bootloader name
 const char* multiboot2_get_bootloader_name(void);
 
+// Get the ACPI RSDP copied by the bootloader (NULL if none)
+const void* multiboot2_get_rsdp(void);
+
 #endif // MULTIBOOT2_H
@@ -0,0 +1,308 @@
+// Hardware interrupt handler registration and statistics (see irqdesc.h)
+
+#include "irqdesc.h"
+#include "../arch/x86_64/percpu.h"
+#include "../arch/x86_64/interrupts.h"
+#include "../arch/x86_64/ioapic.h"
+#include "../arch/x86_64/lapic.h"
+#include "../mm/kheap.h"
+#include "../sync/rcu.h"
+#include "../sync/spinlock.h"
+#include "../proc/process.h"
+#include "../proc/preempt.h"
+#include "../time/clockevent.h"
+#include "../time/hrtimer.h"
+#include "../time/tsc.h"
+#include "../../drivers/serial.h"
+#include "../../drivers/vga.h"
+
+// One handler on a line's chain
+typedef struct irq_action {
+    struct irq_action* next;
+    irq_handler_t handler;
+    void* dev;
+    uint32_t flags;
+} irq_action_t;
+
+// Handler chains, indexed by vector - IRQ_BASE_VECTOR. Readers are the
+// interrupt handlers: interrupts off, so no switch and no quiescent
+// state until they return, which is all synchronize_rcu() waits for.
+static irq_action_t* irq_actions[IRQ_LINES];
+static spinlock_t irq_desc_lock = SPINLOCK_INIT_NAMED("irq_desc");
+
+// What usually sits on each line, for the report
+static const char* const irq_names[IRQ_LINES] = {
+    "timer", "keyboard", "cascade", "COM2", "COM1", "LPT2", "floppy", "LPT1",
+    "RTC", "free", "free", "free", "mouse", "FPU", "ATA0", "ATA1",
+    "-", "lapic-timer", "resched"
+};
+
+// Lines drivers may attach to: the ISA lines except the tick and the
+// PIC cascade (the timer and IPI lines never reach irq_handler)
+static int irq_requestable(uint8_t irq) {
+    return irq < ISA_IRQ_COUNT && irq != 0 && irq != 2;
+}
+
+int request_irq(uint8_t irq, irq_handler_t handler, uint32_t flags, void* dev) {
+    if (!irq_requestable(irq) || !handler || ((flags & IRQF_SHARED) && !dev)) {
+        return -1;
+    }
+    
+    irq_action_t* action = (irq_action_t*)kmalloc(sizeof(irq_action_t));
+    if (!action) {
+        return -1;
+    }
+    action->next = NULL;
+    action->handler = handler;
+    action->dev = dev;
+    action->flags = flags;
+    
+    uint64_t irqflags = spin_lock_irqsave(&irq_desc_lock);
+    
+    // Everyone on a line must agree to share it
+    irq_action_t* head = irq_actions[irq];
+    if (head && !(head->flags & flags & IRQF_SHARED)) {
+        spin_unlock_irqrestore(&irq_desc_lock, irqflags);
+        kfree(action);
+        return -1;
+    }
+    
+    // Append, so handlers run in registration order
+    irq_action_t** link = &irq_actions[irq];
+    while (*link) {
+        link = &(*link)->next;
+    }
+    rcu_assign_pointer(*link, action);
+    
+    if (!head) {
+        irq_unmask(irq);
+    }
+    
+    spin_unlock_irqrestore(&irq_desc_lock, irqflags);
+    return 0;
+}
+
+void free_irq(uint8_t irq, void* dev) {
+    if (irq >= IRQ_LINES) {
+        return;
+    }
+    
+    uint64_t irqflags = spin_lock_irqsave(&irq_desc_lock);
+    
+    irq_action_t** link = &irq_actions[irq];
+    while (*link && (*link)->dev != dev) {
+        link = &(*link)->next;
+    }
+    irq_action_t* action = *link;
+    if (action) {
+        rcu_assign_pointer(*link, action->next);
+        if (!irq_actions[irq]) {
+            irq_mask(irq);
+        }
+    }
+    
+    spin_unlock_irqrestore(&irq_desc_lock, irqflags);
+    
+    // A CPU may still be walking past it
+    if (action) {
+        synchronize_rcu();
+        kfree(action);
+    }
+}
+
+int irq_dispatch(uint8_t irq) {
+    int ret = IRQ_NONE;
+    
+    if (irq >= IRQ_LINES) {
+        return ret;
+    }
+    
+    for (irq_action_t* action = rcu_dereference(irq_actions[irq]); action;
+         action = rcu_dereference(action->next)) {
+        ret |= action->handler(irq, action->dev);
+    }
+    return ret;
+}
+
+void irq_account(uint8_t irq, uint64_t cycles, uint64_t latency_ns) {
+    if (irq >= IRQ_LINES) {
+        return;
+    }
+    
+    irq_stat_t* stat = &this_cpu()->irq_stats[irq];
+    stat->count++;
+    stat->cycles += cycles;
+    if (cycles > stat->max_cycles) {
+        stat->max_cycles = cycles;
+    }
+    if (latency_ns > stat->max_latency_ns) {
+        stat->max_latency_ns = latency_ns;
+    }
+}
+
+// Line building helpers (no printf in the kernel)
+static uint32_t irq_put_str(char* buf, uint32_t pos, const char* str) {
+    while (*str) {
+        buf[pos++] = *str++;
+    }
+    return pos;
+}
+
+// Right-aligned in a field of width characters
+static uint32_t irq_put_dec(char* buf, uint32_t pos, uint64_t value, int width) {
+    char digits[20];
+    int count = 0;
+    
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    
+    while (width-- > count) {
+        buf[pos++] = ' ';
+    }
+    while (count > 0) {
+        buf[pos++] = digits[--count];
+    }
+    return pos;
+}
+
+void irq_print_stats(void) {
+    char line[256];
+    uint32_t pos;
+    uint32_t cpus = cpu_count();
+    
+    if (!serial_ready()) {
+        serial_init();
+    }
+    
+    // Header: one count column per CPU, then totals over all CPUs
+    pos = irq_put_str(line, 0, "IRQ VEC");
+    for (uint32_t i = 0; i < cpus; i++) {
+        pos = irq_put_str(line, pos, "      CPU");
+        pos = irq_put_dec(line, pos, i, 2);
+    }
+    pos = irq_put_str(line, pos, "    kcycles  max-handler  max-lat-ns  name\n");
+    line[pos] = '\0';
+    serial_print(line);
+    
+    for (uint8_t irq = 0; irq < IRQ_LINES; irq++) {
+        uint64_t count = 0;
+        uint64_t cycles = 0;
+        uint64_t max_cycles = 0;
+        uint64_t max_latency = 0;
+        
+        for (uint32_t i = 0; i < cpus; i++) {
+            irq_stat_t* stat = &cpu_get(i)->irq_stats[irq];
+            count += stat->count;
+            cycles += stat->cycles;
+            if (stat->max_cycles > max_cycles) {
+                max_cycles = stat->max_cycles;
+            }
+            if (stat->max_latency_ns > max_latency) {
+                max_latency = stat->max_latency_ns;
+            }
+        }
+        if (!count && !irq_actions[irq]) {
+            continue;
+        }
+        
+        pos = irq_put_dec(line, 0, irq, 3);
+        pos = irq_put_dec(line, pos, IRQ_BASE_VECTOR + irq, 4);
+        for (uint32_t i = 0; i < cpus; i++) {
+            pos = irq_put_dec(line, pos, cpu_get(i)->irq_stats[irq].count, 11);
+        }
+        pos = irq_put_dec(line, pos, cycles / 1000, 11);
+        pos = irq_put_dec(line, pos, max_cycles, 13);
+        if (max_latency) {
+            pos = irq_put_dec(line, pos, max_latency, 12);
+        } else {
+            pos = irq_put_str(line, pos, "           -");  // No deadline on this line
+        }
+        pos = irq_put_str(line, pos, "  ");
+        pos = irq_put_str(line, pos, irq_names[irq]);
+        line[pos++] = '\n';
+        line[pos] = '\0';
+        serial_print(line);
+    }
+}
+
+#if IRQ_BENCH
+#define IRQ_BENCH_PERIOD_NS 20000      // Bench timer period (50 kHz)
+#define IRQ_BENCH_WINDOW_MS 200        // Length of each run
+
+typedef struct {
+    uint64_t loops;            // Rounds of the spin loop
+    uint64_t irqs;             // Timer interrupts taken meanwhile
+    uint64_t handler_cycles;   // Spent in preempt_handler itself
+} irq_bench_run_t;
+
+static hrtimer_t irq_bench_timer;
+
+static hrtimer_restart_t irq_bench_tick(hrtimer_t* timer) {
+    hrtimer_forward(timer, IRQ_BENCH_PERIOD_NS);
+    return HRTIMER_RESTART;
+}
+
+// Spin for a fixed number of cycles, counting loop rounds and the timer
+// interrupts that took some of them (preemption off: one CPU throughout)
+static void irq_bench_run(uint64_t window, irq_bench_run_t* run) {
+    cpu_t* cpu = this_cpu();
+    irq_stat_t* stat = &cpu->irq_stats[cpu->lapic_timer ? LAPIC_TIMER_VECTOR - IRQ_BASE_VECTOR : 0];
+    uint64_t count = stat->count;
+    uint64_t cycles = stat->cycles;
+    uint64_t loops = 0;
+    
+    uint64_t start = rdtsc();
+    while (rdtsc() - start < window) {
+        loops++;
+    }
+    
+    run->loops = loops;
+    run->irqs = stat->count - count;
+    run->handler_cycles = stat->cycles - cycles;
+}
+
+// Every interrupt costs the loop the rounds it would have run in the
+// meantime: comparing a run with only the regular tick against one
+// with a fast hrtimer gives the full cost per interrupt - entry stub,
+// handler, softirq and exit, cache misses included
+static void irq_bench(void) {
+    uint64_t window = tsc_khz() * IRQ_BENCH_WINDOW_MS;
+    irq_bench_run_t base, fast;
+    
+    if (!window || !clockevent_available()) {
+        vga_print("[IRQ] bench: needs the TSC and a clock-event device\n", VGA_COLOR_LIGHT_RED);
+        return;
+    }
+    
+    hrtimer_init(&irq_bench_timer, irq_bench_tick, 0);
+    
+    preempt_disable();
+    irq_bench_run(window, &base);
+    hrtimer_start(&irq_bench_timer, IRQ_BENCH_PERIOD_NS, irq_bench_tick);
+    irq_bench_run(window, &fast);
+    preempt_enable();
+    hrtimer_cancel(&irq_bench_timer);
+    
+    if (fast.irqs <= base.irqs || fast.loops >= base.loops) {
+        vga_print("[IRQ] bench: the timer did not speed up\n", VGA_COLOR_LIGHT_RED);
+        return;
+    }
+    
+    uint64_t irqs = fast.irqs - base.irqs;
+    uint64_t stolen = window * (base.loops - fast.loops) / base.loops;
+    
+    vga_print("[IRQ] bench: ", VGA_COLOR_LIGHT_CYAN);
+    vga_print_int((int32_t)irqs, VGA_COLOR_LIGHT_CYAN);
+    vga_print(" timer interrupts, ", VGA_COLOR_LIGHT_CYAN);
+    vga_print_int((int32_t)(stolen / irqs), VGA_COLOR_LIGHT_CYAN);
+    vga_print(" cycles each (", VGA_COLOR_LIGHT_CYAN);
+    vga_print_int((int32_t)(fast.handler_cycles / fast.irqs), VGA_COLOR_LIGHT_CYAN);
+    vga_print(" in the handler)\n", VGA_COLOR_LIGHT_CYAN);
+}
+
+void irq_bench_start(void) {
+    process_create("irq_bench", irq_bench, DEFAULT_PRIORITY);
+}
+#endif
@@ -0,0 +1,55 @@
+#ifndef KERNEL_IRQ_IRQDESC_H
+#define KERNEL_IRQ_IRQDESC_H
+
+#include <stdint.h>
+#include "irqdesc_types.h"
+
+// Hardware interrupt handlers. Drivers attach a handler to a line with
+// request_irq(); irq_handler() (interrupts.c) runs every handler on the
+// line's chain with interrupts off, on the CPU's IRQ stack. A shared
+// line (IRQF_SHARED) may carry several handlers, each of which checks
+// its own device and returns IRQ_NONE if it did not raise the interrupt.
+// The timer and reschedule lines have their own paths in isr.asm and
+// cannot be requested, but are counted like the rest.
+
+// Set to 1 to measure the cost of an interrupt at scheduler start
+#define IRQ_BENCH 0
+
+// Handler return values
+#define IRQ_NONE    0          // Not our device
+#define IRQ_HANDLED 1
+
+// request_irq() flags
+#define IRQF_SHARED (1 << 0)   // Other handlers may share the line
+
+typedef int (*irq_handler_t)(uint8_t irq, void* dev);
+
+// Attach a handler to a line and unmask it. dev is passed back to the
+// handler and identifies it to free_irq() (required for shared lines).
+// Returns 0, or -1 if the line is out of range, reserved, taken without
+// IRQF_SHARED on both sides, or out of memory.
+int request_irq(uint8_t irq, irq_handler_t handler, uint32_t flags, void* dev);
+
+// Detach the handler registered with dev, masking the line if it was
+// the last one. Waits for running handlers to finish (task context).
+void free_irq(uint8_t irq, void* dev);
+
+// Run the handlers of a line (interrupts off). Returns IRQ_HANDLED if
+// any of them claimed the interrupt.
+int irq_dispatch(uint8_t irq);
+
+// Charge one interrupt on a line to this CPU (interrupts off).
+// latency_ns is the delay from the programmed deadline to the handler,
+// known only for timer events (0 otherwise).
+void irq_account(uint8_t irq, uint64_t cycles, uint64_t latency_ns);
+
+// Write a per-line, per-CPU table of counts, handler cycles and timer
+// delivery latency to the serial port, like /proc/interrupts
+void irq_print_stats(void);
+
+#if IRQ_BENCH
+// Cycles per timer interrupt, entry to exit, under a high-rate hrtimer
+void irq_bench_start(void);
+#endif
+
+#endif // KERNEL_IRQ_IRQDESC_H
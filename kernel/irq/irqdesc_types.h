@@ -0,0 +1,19 @@
+#ifndef KERNEL_IRQ_IRQDESC_TYPES_H
+#define KERNEL_IRQ_IRQDESC_TYPES_H
+
+#include <stdint.h>
+
+// Interrupt lines, numbered from IRQ_BASE_VECTOR like the isr.asm stubs:
+// 0-15 ISA, 17 local APIC timer, 18 reschedule IPI (16 is unused)
+#define IRQ_LINES 19
+
+// Per-CPU counters of one line (touched only by the owning CPU, with
+// interrupts off)
+typedef struct {
+    uint64_t count;            // Interrupts taken
+    uint64_t cycles;           // TSC cycles spent in the handlers
+    uint64_t max_cycles;       // Longest single handler run
+    uint64_t max_latency_ns;   // Longest deadline-to-handler delay (timer lines)
+} irq_stat_t;
+
+#endif // KERNEL_IRQ_IRQDESC_TYPES_H
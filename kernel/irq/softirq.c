@@ -0,0 +1,201 @@
+// Softirqs and tasklets (see softirq.h)
+
+#include "softirq.h"
+#include "../arch/x86_64/cpu.h"
+#include "../arch/x86_64/percpu.h"
+#include "../arch/x86_64/interrupts.h"
+#include "../proc/preempt.h"
+#include "../proc/process.h"
+#include "../proc/cputime.h"
+#include "../sync/rcu.h"
+#include "../../drivers/vga.h"
+
+#define RFLAGS_IF 0x200
+
+static void tasklet_action(void);
+static void tasklet_hi_action(void);
+
+static softirq_handler_t softirq_vec[SOFTIRQ_COUNT] = {
+    [SOFTIRQ_HI] = tasklet_hi_action,
+    [SOFTIRQ_RCU] = rcu_softirq,
+    [SOFTIRQ_TASKLET] = tasklet_action,
+};
+
+static const char* softirq_names[SOFTIRQ_COUNT] = {
+    "hi", "timer", "rcu", "tasklet"
+};
+
+void softirq_register(softirq_nr_t nr, softirq_handler_t handler) {
+    if (nr < SOFTIRQ_COUNT) {
+        softirq_vec[nr] = handler;
+    }
+}
+
+void softirq_raise(softirq_nr_t nr) {
+    uint64_t flags = irq_save();
+    this_cpu()->softirq.pending |= 1u << nr;
+    irq_restore(flags);
+
+    // Any point with interrupts enabled could be an irq_exit(), so task
+    // context may run the handlers itself instead of waiting for one
+    if (flags & RFLAGS_IF) {
+        softirq_run();
+    }
+}
+
+// Run the pending softirqs. A switch the handlers held back is made
+// here only from task context: on the way out of an interrupt the entry
+// stub makes it (preempt_schedule_irq), with the full register frame.
+static void softirq_do(int may_yield) {
+    uint64_t flags = irq_save();
+    cpu_t* cpu = this_cpu();
+    softirq_cpu_t* sd = &cpu->softirq;
+
+    if (sd->active || !sd->pending) {
+        irq_restore(flags);
+        return;
+    }
+
+    // Interrupts on, but no switch away: per-CPU state stays ours
+    sd->active = 1;
+    preempt_disable();
+    uint64_t start = cputime_irq_enter();
+
+    uint32_t pending;
+    uint32_t restart = SOFTIRQ_MAX_RESTART;
+    while ((pending = sd->pending) != 0 && restart-- > 0) {
+        sd->pending = 0;
+        enable_interrupts();
+
+        for (uint32_t nr = 0; nr < SOFTIRQ_COUNT; nr++) {
+            if ((pending & (1u << nr)) && softirq_vec[nr]) {
+                softirq_vec[nr]();
+                sd->runs[nr]++;
+            }
+        }
+
+        disable_interrupts();
+    }
+
+    sd->cycles += rdtsc() - start;
+    cputime_irq_exit(start);
+    sd->active = 0;
+    preempt_enable_no_resched();
+
+    // A tick during the handlers may have held back a switch
+    if (may_yield && preempt_count() == 0 && cpu->need_resched) {
+        scheduler_yield();
+    }
+    irq_restore(flags);
+}
+
+void softirq_run(void) {
+    softirq_do(1);
+}
+
+void irq_exit(void) {
+    if (this_cpu()->softirq.pending) {
+        softirq_do(0);
+    }
+}
+
+void tasklet_init(tasklet_t* t, void (*func)(uint64_t data), uint64_t data) {
+    t->next = NULL;
+    t->state = 0;
+    t->func = func;
+    t->data = data;
+}
+
+// Append to this CPU's list (interrupts off)
+static void tasklet_enqueue(tasklet_t* t, int hi) {
+    softirq_cpu_t* sd = &this_cpu()->softirq;
+
+    t->next = NULL;
+    if (sd->tasklet_tail[hi]) {
+        sd->tasklet_tail[hi]->next = t;
+    } else {
+        sd->tasklet_head[hi] = t;
+    }
+    sd->tasklet_tail[hi] = t;
+    sd->pending |= 1u << (hi ? SOFTIRQ_HI : SOFTIRQ_TASKLET);
+}
+
+static void tasklet_queue(tasklet_t* t, int hi) {
+    if (__atomic_fetch_or(&t->state, TASKLET_STATE_SCHED, __ATOMIC_ACQ_REL) & TASKLET_STATE_SCHED) {
+        return;  // Already queued, it will see our update
+    }
+
+    uint64_t flags = irq_save();
+    tasklet_enqueue(t, hi);
+    irq_restore(flags);
+
+    if (flags & RFLAGS_IF) {
+        softirq_run();
+    }
+}
+
+void tasklet_schedule(tasklet_t* t) {
+    tasklet_queue(t, 0);
+}
+
+void tasklet_hi_schedule(tasklet_t* t) {
+    tasklet_queue(t, 1);
+}
+
+// Run every tasklet queued on this CPU so far
+static void tasklet_run_list(int hi) {
+    softirq_cpu_t* sd = &this_cpu()->softirq;
+
+    disable_interrupts();
+    tasklet_t* list = sd->tasklet_head[hi];
+    sd->tasklet_head[hi] = NULL;
+    sd->tasklet_tail[hi] = NULL;
+    enable_interrupts();
+
+    while (list) {
+        tasklet_t* t = list;
+        list = t->next;
+
+        // Still running on another CPU - try again next round
+        if (__atomic_fetch_or(&t->state, TASKLET_STATE_RUN, __ATOMIC_ACQUIRE) & TASKLET_STATE_RUN) {
+            disable_interrupts();
+            tasklet_enqueue(t, hi);
+            enable_interrupts();
+            continue;
+        }
+
+        // Clear SCHED first so the function may schedule itself again
+        __atomic_and_fetch(&t->state, (uint8_t)~TASKLET_STATE_SCHED, __ATOMIC_ACQ_REL);
+        t->func(t->data);
+        __atomic_and_fetch(&t->state, (uint8_t)~TASKLET_STATE_RUN, __ATOMIC_RELEASE);
+    }
+}
+
+static void tasklet_action(void) {
+    tasklet_run_list(0);
+}
+
+static void tasklet_hi_action(void) {
+    tasklet_run_list(1);
+}
+
+void softirq_print_stats(void) {
+    uint64_t cycles = 0;
+    vga_print("[SOFTIRQ] Runs:", VGA_COLOR_LIGHT_GREEN);
+    for (uint32_t nr = 0; nr < SOFTIRQ_COUNT; nr++) {
+        uint32_t runs = 0;
+        for (uint32_t i = 0; i < cpu_count(); i++) {
+            runs += cpu_get(i)->softirq.runs[nr];
+        }
+        vga_print(" ", VGA_COLOR_LIGHT_GREEN);
+        vga_print(softirq_names[nr], VGA_COLOR_LIGHT_GREEN);
+        vga_print("=", VGA_COLOR_LIGHT_GREEN);
+        vga_print_int(runs, VGA_COLOR_LIGHT_GREEN);
+    }
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        cycles += cpu_get(i)->softirq.cycles;
+    }
+    vga_print(", kcycles ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int((int32_t)(cycles / 1000), VGA_COLOR_LIGHT_GREEN);
+    vga_print("\n", VGA_COLOR_WHITE);
+}
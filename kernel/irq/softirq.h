@@ -0,0 +1,58 @@
+#ifndef KERNEL_IRQ_SOFTIRQ_H
+#define KERNEL_IRQ_SOFTIRQ_H
+
+#include <stdint.h>
+#include "softirq_types.h"
+
+// Bottom halves. A hard interrupt handler does the minimum with
+// interrupts off (acknowledge the device, grab its data), then raises a
+// softirq or schedules a tasklet for the rest. Pending softirqs run when
+// the outermost interrupt returns (irq_exit), with interrupts enabled
+// but preemption disabled, so they must not sleep. Work that may sleep
+// goes to a workqueue (proc/workqueue.h).
+
+// Rounds of newly raised softirqs handled before leaving the rest for
+// the next interrupt
+#define SOFTIRQ_MAX_RESTART 10
+
+typedef void (*softirq_handler_t)(void);
+
+// Tasklet: deferred function run from a softirq on the CPU that
+// scheduled it. A tasklet never runs on two CPUs at once, and
+// scheduling it again before it runs is a no-op.
+typedef struct tasklet {
+    struct tasklet* next;
+    volatile uint8_t state;    // TASKLET_STATE_* bits
+    void (*func)(uint64_t data);
+    uint64_t data;
+} tasklet_t;
+
+#define TASKLET_STATE_SCHED (1 << 0)  // Queued on some CPU
+#define TASKLET_STATE_RUN   (1 << 1)  // Running right now
+
+#define TASKLET_INIT(fn, d) { NULL, 0, (fn), (d) }
+
+// Install the handler of a vector (SOFTIRQ_HI/TASKLET/RCU are built in)
+void softirq_register(softirq_nr_t nr, softirq_handler_t handler);
+
+// Mark a vector pending on this CPU. From task context with interrupts
+// enabled it runs right away, otherwise at the next irq_exit().
+void softirq_raise(softirq_nr_t nr);
+
+// Run pending softirqs on this CPU (no-op if already running here)
+void softirq_run(void);
+
+// Called by the IRQ entry stubs after every hardware interrupt handler.
+// Unlike softirq_run() it never switches tasks: the stub does that next.
+void irq_exit(void);
+
+void tasklet_init(tasklet_t* t, void (*func)(uint64_t data), uint64_t data);
+
+// Queue a tasklet on this CPU (SOFTIRQ_TASKLET / SOFTIRQ_HI)
+void tasklet_schedule(tasklet_t* t);
+void tasklet_hi_schedule(tasklet_t* t);
+
+// Print per-vector run counts and time spent in softirqs
+void softirq_print_stats(void);
+
+#endif // KERNEL_IRQ_SOFTIRQ_H
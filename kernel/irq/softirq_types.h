@@ -0,0 +1,27 @@
+#ifndef KERNEL_IRQ_SOFTIRQ_TYPES_H
+#define KERNEL_IRQ_SOFTIRQ_TYPES_H
+
+#include <stdint.h>
+
+// Softirq vectors, run in this order (lower number first)
+typedef enum {
+    SOFTIRQ_HI = 0,            // High-priority tasklets
+    SOFTIRQ_TIMER,             // Timer expiry
+    SOFTIRQ_RCU,               // RCU callbacks whose grace period ended
+    SOFTIRQ_TASKLET,           // Normal tasklets
+    SOFTIRQ_COUNT
+} softirq_nr_t;
+
+struct tasklet;
+
+// Per-CPU softirq state (touched only by the owning CPU)
+typedef struct {
+    volatile uint32_t pending;            // Raised vectors (bit n = vector n)
+    uint8_t active;                       // softirq_run() is in progress
+    struct tasklet* tasklet_head[2];      // Scheduled tasklets: [0] normal, [1] high
+    struct tasklet* tasklet_tail[2];
+    uint32_t runs[SOFTIRQ_COUNT];         // Handler invocations per vector
+    uint64_t cycles;                      // TSC cycles spent in handlers
+} softirq_cpu_t;
+
+#endif // KERNEL_IRQ_SOFTIRQ_TYPES_H
@@ -1,6 +1,8 @@
 #include "kheap.h"
 #include "pmm.h"
 #include "../../drivers/vga.h"
+#include "../arch/x86_64/interrupts.h"
+#include "../sync/mcslock.h"
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
@@ -23,6 +25,7 @@ typedef struct block_header {
 static block_header_t* heap_start = NULL;
 static size_t total_heap_size = 0;
 static size_t used_heap_size = 0;
+static mcs_lock_t heap_lock = MCS_LOCK_INIT;  // Queue lock: every CPU allocates here
 
 // Helper: Align size up to alignment boundary
 static size_t align_up(size_t size, size_t alignment) {
@@ -147,6 +150,9 @@ void* kmalloc(size_t size) {
     // Align size to 8-byte boundary for performance
     size = align_up(size, 8);
 
+    mcs_node_t node;
+    uint64_t flags = mcs_lock_irqsave(&heap_lock, &node);
+
     // First-fit algorithm: find first free block large enough
     block_header_t* current = heap_start;
     while (current) {
@@ -156,6 +162,8 @@ void* kmalloc(size_t size) {
             current->is_free = false;
             used_heap_size += size + BLOCK_HEADER_SIZE;
 
+            mcs_unlock_irqrestore(&heap_lock, &node, flags);
+
             // Return pointer to usable data (after header)
             return (void*)((uint8_t*)current + BLOCK_HEADER_SIZE);
         }
@@ -165,6 +173,7 @@ void* kmalloc(size_t size) {
     // No suitable block found, expand heap
     block_header_t* new_block = expand_heap(size + BLOCK_HEADER_SIZE);
     if (!new_block) {
+        mcs_unlock_irqrestore(&heap_lock, &node, flags);
         KHEAP_PRINT("[KHEAP] kmalloc failed: out of memory\n");
         return NULL;
     }
@@ -174,6 +183,8 @@ void* kmalloc(size_t size) {
     new_block->is_free = false;
     used_heap_size += size + BLOCK_HEADER_SIZE;
 
+    mcs_unlock_irqrestore(&heap_lock, &node, flags);
+
     return (void*)((uint8_t*)new_block + BLOCK_HEADER_SIZE);
 }
 
@@ -207,7 +218,11 @@ void kfree(void* ptr) {
     // Get block header (it's right before the data)
     block_header_t* block = (block_header_t*)((uint8_t*)ptr - BLOCK_HEADER_SIZE);
 
+    mcs_node_t node;
+    uint64_t flags = mcs_lock_irqsave(&heap_lock, &node);
+
     if (block->is_free) {
+        mcs_unlock_irqrestore(&heap_lock, &node, flags);
         KHEAP_PRINT("[KHEAP] Warning: Double free detected!\n");
         return;
     }
@@ -218,6 +233,8 @@ void kfree(void* ptr) {
 
     // Coalesce with adjacent free blocks
     coalesce_blocks(block);
+
+    mcs_unlock_irqrestore(&heap_lock, &node, flags);
 }
 
 void kheap_print_stats(void) {
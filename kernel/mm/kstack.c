@@ -0,0 +1,54 @@
+// Guarded kernel stacks (see kstack.h)
+
+#include "kstack.h"
+#include "paging.h"
+#include "pmm.h"
+#include "../proc/process.h"
+#include "../sync/spinlock.h"
+
+static spinlock_t kstack_lock = SPINLOCK_INIT_NAMED("kstack");
+static uint32_t kstack_slots = 0;     // Slots mapped so far
+static void* kstack_pool = NULL;      // Free stacks, linked through their first word
+
+void* kstack_alloc(void) {
+    uint64_t flags = spin_lock_irqsave(&kstack_lock);
+    
+    void* stack = kstack_pool;
+    if (stack) {
+        kstack_pool = *(void**)stack;
+        spin_unlock_irqrestore(&kstack_lock, flags);
+        return stack;
+    }
+    
+    if (kstack_slots >= KSTACK_MAX) {
+        spin_unlock_irqrestore(&kstack_lock, flags);
+        return NULL;
+    }
+    
+    // Map the top of a fresh slot, the guard below stays empty
+    uint64_t base = KSTACK_BASE + (uint64_t)(kstack_slots + 1) * KSTACK_SLOT_SIZE - PROCESS_STACK_SIZE;
+    for (uint64_t off = 0; off < PROCESS_STACK_SIZE; off += PAGE_SIZE) {
+        void* page = pmm_alloc_page();
+        if (!page) {
+            // Never used, so no other CPU can have these cached
+            for (uint64_t done = 0; done < off; done += PAGE_SIZE) {
+                pmm_free_page((void*)paging_get_physical(base + done));
+                paging_unmap_page(base + done);
+            }
+            spin_unlock_irqrestore(&kstack_lock, flags);
+            return NULL;
+        }
+        paging_map_page(base + off, (uint64_t)page, PAGE_PRESENT | PAGE_WRITABLE);
+    }
+    kstack_slots++;
+    
+    spin_unlock_irqrestore(&kstack_lock, flags);
+    return (void*)base;
+}
+
+void kstack_free(void* stack) {
+    uint64_t flags = spin_lock_irqsave(&kstack_lock);
+    *(void**)stack = kstack_pool;
+    kstack_pool = stack;
+    spin_unlock_irqrestore(&kstack_lock, flags);
+}
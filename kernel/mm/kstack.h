@@ -0,0 +1,26 @@
+#ifndef KERNEL_MM_KSTACK_H
+#define KERNEL_MM_KSTACK_H
+
+#include <stdint.h>
+
+// Kernel stacks of tasks. Each lives in its own slot of a dedicated
+// virtual region, at the top, with the rest of the slot left unmapped:
+// running off the bottom faults on the guard instead of corrupting
+// whatever the heap put below. The #PF then cannot push its frame on
+// the same stack and escalates to a double fault, which has its own
+// IST stack (gdt.h) and gets reported.
+//
+// Stacks are recycled rather than unmapped, so no page ever changes
+// hands while another CPU may still cache its translation.
+
+#define KSTACK_BASE      0xFFFFFFFF40000000ULL
+#define KSTACK_SLOT_SIZE 0x4000ULL     // Stack plus guard (PROCESS_STACK_SIZE below it)
+#define KSTACK_MAX       1024          // Slots in the region (16 MB)
+
+// Get a PROCESS_STACK_SIZE stack (lowest address), or NULL
+void* kstack_alloc(void);
+
+// Give one back for reuse (nothing may run on it any more)
+void kstack_free(void* stack);
+
+#endif // KERNEL_MM_KSTACK_H
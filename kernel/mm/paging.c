@@ -34,22 +34,22 @@ static void uint64_to_str(uint64_t num, char* buf) {
 
 // Get or create page table
 static page_table_t* get_or_create_table(pte_t* entry, uint64_t flags) {
+    if (*entry & PAGE_HUGE) {
+        // Already covered by a large page (e.g. the boot identity map)
+        return NULL;
+    }
+    
     if (*entry & PAGE_PRESENT) {
         // Table exists, return its address
         return (page_table_t*)(*entry & ~0xFFF);
     }
     
-    // Allocate new table
-    page_table_t* table = (page_table_t*)pmm_alloc_page();
+    // Allocate new (already cleared) table
+    page_table_t* table = (page_table_t*)pmm_alloc_zeroed_page();
     if (!table) {
         return NULL; // Out of memory
     }
     
-    // Clear the table
-    for (int i = 0; i < 512; i++) {
-        table->entries[i] = 0;
-    }
-    
     // Set entry to point to new table
     *entry = (uint64_t)table | flags | PAGE_PRESENT | PAGE_WRITABLE;
     
@@ -105,6 +105,26 @@ void paging_map_page(uint64_t virt, uint64_t phys, uint64_t flags) {
     pt->entries[pt_idx] = (phys & ~0xFFF) | flags;
 }
 
+// Identity-map a physical range
+void paging_identity_map(uint64_t phys, uint64_t size, uint64_t flags) {
+    uint64_t start = phys & ~0xFFFULL;
+    uint64_t end = (phys + size + 0xFFF) & ~0xFFFULL;
+    
+    for (uint64_t addr = start; addr < end; addr += 0x1000) {
+        // Leave existing mappings (including the boot 2 MB page) alone
+        if (paging_get_physical(addr) == addr) {
+            continue;
+        }
+        paging_map_page(addr, addr, flags | PAGE_PRESENT);
+        __asm__ volatile("invlpg (%0)" :: "r"(addr) : "memory");
+    }
+}
+
+// Identity-map device registers
+void paging_map_mmio(uint64_t phys, uint64_t size) {
+    paging_identity_map(phys, size, PAGE_WRITABLE | PAGE_CACHE_DISABLE | PAGE_WRITE_THROUGH);
+}
+
 // Unmap a virtual address
 void paging_unmap_page(uint64_t virt) {
     uint64_t pml4_idx = pml4_index(virt);
@@ -145,6 +165,10 @@ uint64_t paging_get_physical(uint64_t virt) {
     page_table_t* pd = (page_table_t*)(pdpt->entries[pdpt_idx] & ~0xFFF);
     
     if (!(pd->entries[pd_idx] & PAGE_PRESENT)) return 0;
+    if (pd->entries[pd_idx] & PAGE_HUGE) {
+        // 2 MB page
+        return (pd->entries[pd_idx] & ~0x1FFFFFULL & ~PAGE_NO_EXECUTE) | (virt & 0x1FFFFF);
+    }
     page_table_t* pt = (page_table_t*)(pd->entries[pd_idx] & ~0xFFF);
     
     if (!(pt->entries[pt_idx] & PAGE_PRESENT)) return 0;
@@ -152,6 +176,105 @@ uint64_t paging_get_physical(uint64_t virt) {
     return (pt->entries[pt_idx] & ~0xFFF) | (virt & 0xFFF);
 }
 
+// An entry grants the access if it has every bit of need and, for an
+// instruction fetch, no NX bit
+static inline int user_entry_ok(pte_t entry, uint64_t need, int exec) {
+    return (entry & need) == need && !(exec && (entry & PAGE_NO_EXECUTE));
+}
+
+// Walk [virt, virt + size) page by page
+static int user_walk_ok(uint64_t virt, uint64_t size, uint64_t need, int exec) {
+    uint64_t end = virt + size;
+    
+    if (end < virt) {
+        return 0;
+    }
+    
+    for (uint64_t page = virt & ~0xFFFULL; page < end; page += 0x1000) {
+        pte_t entry = kernel_pml4->entries[pml4_index(page)];
+        if (!user_entry_ok(entry, need, exec)) return 0;
+        page_table_t* pdpt = (page_table_t*)(entry & ~0xFFF & ~PAGE_NO_EXECUTE);
+        
+        entry = pdpt->entries[pdpt_index(page)];
+        if (!user_entry_ok(entry, need, exec)) return 0;
+        if (entry & PAGE_HUGE) continue;
+        page_table_t* pd = (page_table_t*)(entry & ~0xFFF & ~PAGE_NO_EXECUTE);
+        
+        entry = pd->entries[pd_index(page)];
+        if (!user_entry_ok(entry, need, exec)) return 0;
+        if (entry & PAGE_HUGE) continue;
+        page_table_t* pt = (page_table_t*)(entry & ~0xFFF & ~PAGE_NO_EXECUTE);
+        
+        entry = pt->entries[pt_index(page)];
+        if (!user_entry_ok(entry, need, exec)) return 0;
+    }
+    return 1;
+}
+
+// Check user access to a range
+int paging_user_range_ok(uint64_t virt, uint64_t size, int write) {
+    return user_walk_ok(virt, size, PAGE_PRESENT | PAGE_USER | (write ? PAGE_WRITABLE : 0), 0);
+}
+
+// Check that user code may run from a page
+int paging_user_exec_ok(uint64_t virt) {
+    return user_walk_ok(virt, 1, PAGE_PRESENT | PAGE_USER, 1);
+}
+
+// Replace a 2 MB page with a page table of 4 KB pages, same attributes
+static page_table_t* split_huge_page(pte_t* entry) {
+    page_table_t* pt = (page_table_t*)pmm_alloc_zeroed_page();
+    if (!pt) return NULL;
+    
+    uint64_t base = *entry & ~0x1FFFFFULL & ~PAGE_NO_EXECUTE;
+    uint64_t flags = (*entry & 0xFFF & ~PAGE_HUGE) | (*entry & PAGE_NO_EXECUTE);
+    for (int i = 0; i < 512; i++) {
+        pt->entries[i] = (base + (uint64_t)i * 0x1000) | flags;
+    }
+    
+    *entry = (uint64_t)pt | (*entry & (PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER));
+    return pt;
+}
+
+// Open a mapped range to user mode
+int paging_grant_user(uint64_t virt, uint64_t size, int write) {
+    uint64_t leaf = PAGE_USER | (write ? PAGE_WRITABLE : 0);
+    uint64_t end = virt + size;
+    
+    for (uint64_t page = virt & ~0xFFFULL; page < end; page += 0x1000) {
+        // Upper levels only allow; the leaf entry decides
+        pte_t* entry = &kernel_pml4->entries[pml4_index(page)];
+        if (!(*entry & PAGE_PRESENT)) return -1;
+        *entry |= PAGE_USER;
+        page_table_t* pdpt = (page_table_t*)(*entry & ~0xFFF & ~PAGE_NO_EXECUTE);
+        
+        entry = &pdpt->entries[pdpt_index(page)];
+        if (!(*entry & PAGE_PRESENT) || (*entry & PAGE_HUGE)) return -1;
+        *entry |= PAGE_USER;
+        page_table_t* pd = (page_table_t*)(*entry & ~0xFFF & ~PAGE_NO_EXECUTE);
+        
+        entry = &pd->entries[pd_index(page)];
+        if (!(*entry & PAGE_PRESENT)) return -1;
+        page_table_t* pt;
+        if (*entry & PAGE_HUGE) {
+            pt = split_huge_page(entry);
+            if (!pt) return -1;
+        } else {
+            pt = (page_table_t*)(*entry & ~0xFFF & ~PAGE_NO_EXECUTE);
+        }
+        *entry |= PAGE_USER;
+        
+        entry = &pt->entries[pt_index(page)];
+        if (!(*entry & PAGE_PRESENT)) return -1;
+        *entry |= leaf;
+        
+        // Other CPUs may still hold the old entry; their first user
+        // access faults and is retried (interrupts.c)
+        __asm__ volatile("invlpg (%0)" :: "r"(page) : "memory");
+    }
+    return 0;
+}
+
 // Switch to different page directory
 void paging_switch_directory(page_table_t* pml4) {
     kernel_pml4 = pml4;
@@ -165,14 +288,9 @@ page_table_t* paging_get_current_directory(void) {
 
 // Create new address space
 page_table_t* paging_create_address_space(void) {
-    page_table_t* pml4 = (page_table_t*)pmm_alloc_page();
+    page_table_t* pml4 = (page_table_t*)pmm_alloc_zeroed_page();
     if (!pml4) return NULL;
     
-    // Clear PML4
-    for (int i = 0; i < 512; i++) {
-        pml4->entries[i] = 0;
-    }
-    
     // Copy kernel mappings (top half)
     for (int i = 256; i < 512; i++) {
         pml4->entries[i] = kernel_pml4->entries[i];
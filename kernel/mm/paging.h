@@ -29,12 +29,30 @@ void paging_init(void);
 // Map a virtual address to a physical address
 void paging_map_page(uint64_t virt, uint64_t phys, uint64_t flags);
 
+// Identity-map a physical range (pages already mapped are left alone)
+void paging_identity_map(uint64_t phys, uint64_t size, uint64_t flags);
+
+// Identity-map device registers (uncached)
+void paging_map_mmio(uint64_t phys, uint64_t size);
+
 // Unmap a virtual address
 void paging_unmap_page(uint64_t virt);
 
 // Get physical address for virtual address
 uint64_t paging_get_physical(uint64_t virt);
 
+// Check that every page of [virt, virt + size) is mapped user-accessible
+// (and writable if write is set) at every level of the page tables
+int paging_user_range_ok(uint64_t virt, uint64_t size, int write);
+
+// Same for an instruction fetch at virt (no NX bit on the way either)
+int paging_user_exec_ok(uint64_t virt);
+
+// Let user mode access an already-mapped range (writable if write is
+// set). 2 MB pages are split so only the pages of the range change.
+// Returns 0, or -1 if part of it is unmapped or out of memory.
+int paging_grant_user(uint64_t virt, uint64_t size, int write);
+
 // Create a new page directory for a process
 page_table_t* paging_create_address_space(void);
 
@@ -3,12 +3,21 @@
 #include "pmm.h"
 #include "../boot/multiboot2.h"
 #include "../../drivers/vga.h"
+#include "../arch/x86_64/interrupts.h"
+#include "../arch/x86_64/smp.h"
+#include "../sync/spinlock.h"
 
 // Bitmap to track page allocation (1 bit per page)
 static uint8_t* bitmap = 0;
 static uint64_t total_pages = 0;
 static uint64_t used_pages = 0;
 static uint64_t memory_size = 0;
+static spinlock_t pmm_lock = SPINLOCK_INIT_NAMED("pmm");
+
+// Pool of pages zeroed ahead of time by the idle task
+static void* zero_pool[PMM_ZERO_POOL_SIZE];
+static volatile uint32_t zero_pool_count = 0;
+static spinlock_t zero_pool_lock = SPINLOCK_INIT_NAMED("pmm_zero_pool");
 
 // Kernel end address (defined in linker script)
 extern uint8_t kernel_end;
@@ -121,6 +130,15 @@ void pmm_init(void) {
         }
     }
     
+    // Reserve the real-mode IVT/BDA page and the AP startup trampoline
+    uint64_t low_pages[] = { 0, AP_TRAMPOLINE_BASE / PAGE_SIZE };
+    for (uint64_t i = 0; i < sizeof(low_pages) / sizeof(low_pages[0]); i++) {
+        if (low_pages[i] < total_pages && !bitmap_test(low_pages[i])) {
+            bitmap_set(low_pages[i]);
+            used_pages++;
+        }
+    }
+    
     char buf[32];
     vga_print("    Total memory: ", VGA_COLOR_WHITE);
     uint64_to_str_dec(memory_size / 1024 / 1024, buf);
@@ -142,15 +160,20 @@ void pmm_init(void) {
 
 // Allocate a physical page
 void* pmm_alloc_page(void) {
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
+    
     // Find first free page
     for (uint64_t i = 0; i < total_pages; i++) {
         if (!bitmap_test(i)) {
             bitmap_set(i);
             used_pages++;
+            spin_unlock_irqrestore(&pmm_lock, flags);
             return (void*)(i * PAGE_SIZE);
         }
     }
     
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    
     // Out of memory
     return 0;
 }
@@ -163,12 +186,70 @@ void pmm_free_page(void* page) {
         return; // Invalid page
     }
     
-    if (!bitmap_test(pfn)) {
-        return; // Already free
+    uint64_t flags = spin_lock_irqsave(&pmm_lock);
+    
+    if (bitmap_test(pfn)) {
+        bitmap_clear(pfn);
+        used_pages--;
     }
     
-    bitmap_clear(pfn);
-    used_pages--;
+    spin_unlock_irqrestore(&pmm_lock, flags);
+}
+
+// Fill a page with zeros
+static void zero_page(void* page) {
+    uint64_t* p = (uint64_t*)page;
+    for (uint64_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        p[i] = 0;
+    }
+}
+
+// Allocate a zero-filled physical page
+void* pmm_alloc_zeroed_page(void) {
+    // Fast path: take a page the idle task already cleared
+    uint64_t flags = spin_lock_irqsave(&zero_pool_lock);
+    if (zero_pool_count > 0) {
+        void* page = zero_pool[--zero_pool_count];
+        spin_unlock_irqrestore(&zero_pool_lock, flags);
+        return page;
+    }
+    spin_unlock_irqrestore(&zero_pool_lock, flags);
+    
+    void* page = pmm_alloc_page();
+
+    if (page) {
+        zero_page(page);
+    }
+    return page;
+}
+
+// Zero one page into the pre-zeroed pool
+int pmm_prezero_page(void) {
+    // Unlocked peek - a stale answer only costs one extra page zeroing
+    if (zero_pool_count >= PMM_ZERO_POOL_SIZE) {
+        return 0;
+    }
+    void* page = pmm_alloc_page();
+
+    if (!page) {
+        return 0;
+    }
+
+    // Clear with interrupts enabled - this is the expensive part
+    zero_page(page);
+
+    uint64_t flags = spin_lock_irqsave(&zero_pool_lock);
+    if (zero_pool_count < PMM_ZERO_POOL_SIZE) {
+        zero_pool[zero_pool_count++] = page;
+        page = 0;
+    }
+    spin_unlock_irqrestore(&zero_pool_lock, flags);
+
+    // Pool filled up behind our back - give the page back
+    if (page) {
+        pmm_free_page(page);
+    }
+    return 1;
 }
 
 // Get total memory
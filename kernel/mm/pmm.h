@@ -7,6 +7,9 @@
 // Page size (4 KB)
 #define PAGE_SIZE 4096
 
+// Number of pre-zeroed pages kept ready by the idle task
+#define PMM_ZERO_POOL_SIZE 32
+
 // Page frame number
 typedef uint64_t pfn_t;
 
@@ -19,6 +22,13 @@ void* pmm_alloc_page(void);
 // Free a physical page frame
 void pmm_free_page(void* page);
 
+// Allocate a zero-filled physical page frame (from the pre-zeroed pool if possible)
+void* pmm_alloc_zeroed_page(void);
+
+// Zero one free page into the pre-zeroed pool (idle-time background work)
+// Returns 1 if a page was zeroed, 0 if the pool is already full
+int pmm_prezero_page(void);
+
 // Get total memory in bytes
 uint64_t pmm_get_total_memory(void);
 
@@ -0,0 +1,311 @@
+#include "balance.h"
+#include "../arch/x86_64/percpu.h"
+#include "../arch/x86_64/lapic.h"
+#include "../arch/x86_64/interrupts.h"
+#include "../../drivers/vga.h"
+#include "../../drivers/pit.h"
+
+// Balancer counters (all CPUs)
+static volatile uint32_t idle_steals = 0;   // Tasks taken by idle CPUs
+static volatile uint32_t periodic_pulls = 0; // Tasks moved by the periodic pass
+
+/**
+ * Runnable tasks on a CPU, counting the one it is running
+ * (read without the lock - only used as a heuristic)
+ */
+static uint32_t cpu_load(scheduler_t* rq)
+{
+    process_t* current = rq->current_process;
+    return rq->nr_ready + (current && current != rq->idle_process ? 1 : 0);
+}
+
+/**
+ * Find the CPU with the highest load that has something to give away
+ * Returns -1 if no other CPU has a ready task
+ */
+static int balance_find_busiest(uint32_t self, uint32_t* load_out)
+{
+    int busiest = -1;
+    uint32_t busiest_load = 0;
+    
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        scheduler_t* rq = &cpu_get(i)->sched;
+        if (i == self || rq->nr_ready == 0) {
+            continue;
+        }
+        
+        uint32_t load = cpu_load(rq);
+        if (busiest < 0 || load > busiest_load) {
+            busiest = (int)i;
+            busiest_load = load;
+        }
+    }
+    
+    *load_out = busiest_load;
+    return busiest;
+}
+
+/**
+ * Move up to max ready tasks from another CPU's queue to ours
+ * Called with interrupts disabled and no run queue lock held
+ */
+static uint32_t balance_pull(uint32_t self, uint32_t victim_id, uint32_t max)
+{
+    scheduler_t* rq = &cpu_get(self)->sched;
+    scheduler_t* victim = &cpu_get(victim_id)->sched;
+    uint32_t moved = 0;
+    
+    // Lock both queues in CPU order so two CPUs pulling from each other
+    // cannot deadlock
+    if (self < victim_id) {
+        spin_lock(&rq->lock);
+        spin_lock(&victim->lock);
+    } else {
+        spin_lock(&victim->lock);
+        spin_lock(&rq->lock);
+    }
+    
+    // Take from the tail - the owner runs from the head, and the most
+    // recently queued tasks have the coldest caches there anyway
+    process_t* it = victim->ready_queue_tail;
+    while (it && moved < max) {
+        process_t* prev = it->prev;
+        
+        // Skip tasks still leaving a CPU and tasks not allowed here
+        if (!it->on_cpu && (it->affinity & (1u << self))) {
+            rq_remove(victim, it);
+            it->cpu = self;
+            rq_enqueue(rq, it);
+            moved++;
+        }
+        it = prev;
+    }
+    
+    spin_unlock(&victim->lock);
+    spin_unlock(&rq->lock);
+    return moved;
+}
+
+/**
+ * Steal one ready task for an idle CPU
+ */
+int balance_idle_steal(void)
+{
+    uint64_t flags = irq_save();
+    uint32_t self = this_cpu()->id;
+    uint32_t moved = 0;
+    uint32_t load;
+    
+    if (this_cpu()->sched.nr_ready == 0) {
+        int busiest = balance_find_busiest(self, &load);
+        if (busiest >= 0) {
+            moved = balance_pull(self, (uint32_t)busiest, 1);
+        }
+    }
+    
+    irq_restore(flags);
+    
+    if (moved) {
+        __atomic_fetch_add(&idle_steals, moved, __ATOMIC_RELAXED);
+    }
+    return moved != 0;
+}
+
+/**
+ * Periodic rebalance - even out queues that idle stealing did not
+ * (a CPU running one task never goes idle but may still be underloaded)
+ */
+void balance_tick(scheduler_t* rq)
+{
+    if ((int32_t)(rq->total_ticks - rq->next_balance) < 0) {
+        return;
+    }
+    rq->next_balance = rq->total_ticks + BALANCE_INTERVAL_TICKS;
+    
+    uint32_t self = this_cpu()->id;
+    uint32_t load;
+    int busiest = balance_find_busiest(self, &load);
+    uint32_t my_load = cpu_load(rq);
+    
+    if (busiest < 0 || load < my_load + BALANCE_IMBALANCE) {
+        return;
+    }
+    
+    // Split the difference
+    uint32_t moved = balance_pull(self, (uint32_t)busiest, (load - my_load) / 2);
+    if (moved) {
+        __atomic_fetch_add(&periodic_pulls, moved, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Send a reschedule IPI to a CPU that is sitting in its idle task
+ */
+void balance_kick_cpu(uint32_t id)
+{
+    cpu_t* cpu = cpu_get(id);
+    
+    if (!cpu || id == this_cpu()->id || !lapic_available()) {
+        return;
+    }
+    if (cpu->sched.current_process == cpu->sched.idle_process) {
+        lapic_send_ipi(cpu->apic_id, LAPIC_RESCHED_VECTOR);
+    }
+}
+
+/**
+ * Wake the first idle CPU with an empty queue
+ */
+void balance_kick_idle(void)
+{
+    uint64_t flags = irq_save();
+    uint32_t self = this_cpu()->id;
+    
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        scheduler_t* rq = &cpu_get(i)->sched;
+        if (i != self && rq->nr_ready == 0 && rq->current_process == rq->idle_process) {
+            balance_kick_cpu(i);
+            break;
+        }
+    }
+    
+    irq_restore(flags);
+}
+
+/**
+ * Print balancer counters
+ */
+void balance_print_stats(void)
+{
+    vga_print("[BAL] Idle steals: ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(idle_steals, VGA_COLOR_LIGHT_GREEN);
+    vga_print(", periodic pulls: ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(periodic_pulls, VGA_COLOR_LIGHT_GREEN);
+    vga_print("\n", VGA_COLOR_WHITE);
+}
+
+#if BALANCE_BENCH
+// Unbalanced task tree: the first child on every level fans out wide,
+// every other node continues as a thin chain. All tasks start on the CPU
+// of their parent, so without balancing the whole tree runs on CPU 0.
+#define BENCH_DEPTH 4                  // Levels below the root node
+#define BENCH_WIDE_FANOUT 4            // Children of the first node on a level
+#define BENCH_WORK_LOOPS 20000000ULL   // CPU-bound work per node
+#define BENCH_SLOTS 256                // Node descriptors, indexed by PID
+
+static volatile uint32_t bench_slot[BENCH_SLOTS];  // ((depth << 8) | index) + 1
+static volatile uint32_t bench_spawned = 0;
+static volatile uint32_t bench_done = 0;
+static volatile uint32_t bench_work_ticks = 0;
+static volatile uint32_t bench_cpu_nodes[MAX_CPUS];
+
+static void bench_node(void);
+
+/**
+ * Create one tree node
+ */
+static void bench_spawn(uint32_t depth, uint32_t index)
+{
+    process_t* child = process_create("bench", bench_node, DEFAULT_PRIORITY);
+    if (!child) {
+        return;
+    }
+    
+    __atomic_fetch_add(&bench_spawned, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&bench_slot[child->pid % BENCH_SLOTS], ((depth << 8) | index) + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Tree node: spawn children, then burn CPU
+ */
+static void bench_node(void)
+{
+    process_t* self = get_current_process();
+    
+    // The child may be stolen and run before its parent fills in the slot
+    uint32_t slot;
+    while ((slot = __atomic_load_n(&bench_slot[self->pid % BENCH_SLOTS], __ATOMIC_ACQUIRE)) == 0) {
+        cpu_relax();
+    }
+    uint32_t depth = (slot - 1) >> 8;
+    uint32_t index = (slot - 1) & 0xFF;
+    
+    if (depth < BENCH_DEPTH) {
+        uint32_t fanout = index == 0 ? BENCH_WIDE_FANOUT : 1;
+        for (uint32_t i = 0; i < fanout; i++) {
+            bench_spawn(depth + 1, i);
+        }
+    }
+    
+    for (volatile uint64_t i = 0; i < BENCH_WORK_LOOPS; i++) {
+    }
+    
+    // Yielding brings this CPU's tick accounting up to date
+    scheduler_yield();
+    
+    uint64_t flags = irq_save();
+    __atomic_fetch_add(&bench_work_ticks, self->total_ticks, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&bench_cpu_nodes[this_cpu()->id], 1, __ATOMIC_RELAXED);
+    irq_restore(flags);
+    
+    __atomic_fetch_add(&bench_done, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Coordinator: start the tree, wait for every node, report the speedup
+ * (pinned to CPU 0, which keeps the global tick count)
+ */
+static void bench_main(void)
+{
+    uint32_t start = (uint32_t)pit_get_ticks();
+    
+    bench_spawn(0, 0);
+    if (bench_spawned == 0) {
+        vga_print("[BENCH] balance: failed to create the tree\n", VGA_COLOR_LIGHT_RED);
+        return;
+    }
+    
+    // A node counts itself done only after spawning its children, so
+    // done == spawned means the whole tree has finished
+    while (__atomic_load_n(&bench_done, __ATOMIC_ACQUIRE) != bench_spawned) {
+        process_sleep(1);
+    }
+    
+    uint32_t elapsed = (uint32_t)pit_get_ticks() - start;
+    uint32_t speedup = elapsed ? (bench_work_ticks * 100) / elapsed : 0;
+    
+    vga_print("\n[BENCH] balance: ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(bench_spawned, VGA_COLOR_LIGHT_GREEN);
+    vga_print(" tasks on ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(cpu_count(), VGA_COLOR_LIGHT_GREEN);
+    vga_print(" CPUs, work ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(bench_work_ticks, VGA_COLOR_LIGHT_GREEN);
+    vga_print(" ticks, wall ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(elapsed, VGA_COLOR_LIGHT_GREEN);
+    vga_print(" ticks, speedup ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(speedup / 100, VGA_COLOR_LIGHT_GREEN);
+    vga_print(".", VGA_COLOR_LIGHT_GREEN);
+    if (speedup % 100 < 10) {
+        vga_print("0", VGA_COLOR_LIGHT_GREEN);
+    }
+    vga_print_int(speedup % 100, VGA_COLOR_LIGHT_GREEN);
+    vga_print("x\n[BENCH] nodes per CPU:", VGA_COLOR_LIGHT_GREEN);
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        vga_print(" ", VGA_COLOR_LIGHT_GREEN);
+        vga_print_int(bench_cpu_nodes[i], VGA_COLOR_LIGHT_GREEN);
+    }
+    vga_print("\n", VGA_COLOR_WHITE);
+    balance_print_stats();
+}
+
+/**
+ * Queue the benchmark coordinator
+ */
+void balance_bench_start(void)
+{
+    process_t* proc = process_create("balbench", bench_main, DEFAULT_PRIORITY);
+    if (proc) {
+        process_set_affinity(proc, 1u << 0);
+    }
+}
+#endif
@@ -0,0 +1,35 @@
+#ifndef KERNEL_PROC_BALANCE_H
+#define KERNEL_PROC_BALANCE_H
+
+#include <stdint.h>
+#include "process.h"
+
+// Periodic rebalancing interval (ticks of the balancing CPU)
+#define BALANCE_INTERVAL_TICKS 10
+// Load gap (runnable tasks) that makes the periodic pass pull work
+#define BALANCE_IMBALANCE 2
+// Set to 1 to run the unbalanced task-tree benchmark at scheduler start
+#define BALANCE_BENCH 0
+
+// Idle-task job: steal one ready task from the busiest CPU
+// Returns nonzero if a task was stolen
+int balance_idle_steal(void);
+
+// Periodic pass from the timer interrupt (before rq->lock is taken)
+void balance_tick(scheduler_t* rq);
+
+// Wake one idle CPU so it can steal newly queued work
+void balance_kick_idle(void);
+
+// Wake a specific CPU if it is idling (work was queued on it)
+void balance_kick_cpu(uint32_t id);
+
+// Print steal/pull counters
+void balance_print_stats(void);
+
+#if BALANCE_BENCH
+// Spawn the benchmark coordinator (before scheduler_start runs tasks)
+void balance_bench_start(void);
+#endif
+
+#endif // KERNEL_PROC_BALANCE_H
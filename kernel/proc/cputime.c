@@ -0,0 +1,98 @@
+#include "cputime.h"
+#include "../arch/x86_64/cpu.h"
+#include "../arch/x86_64/percpu.h"
+
+/**
+ * Start the clocks of a CPU and of its first task
+ */
+void cputime_start(scheduler_t* rq, process_t* first)
+{
+    uint64_t now = rdtsc();
+    
+    rq->clock_start = now;
+    first->exec_start = now;
+    first->irq_mark = rq->irq_cycles;
+    first->user_mark = rq->user_cycles;
+}
+
+/**
+ * Charge the run that just ended to prev, start next's
+ */
+void cputime_switch(scheduler_t* rq, process_t* prev, process_t* next)
+{
+    uint64_t now = rdtsc();
+    uint64_t run = now - prev->exec_start;
+    uint64_t irq = rq->irq_cycles - prev->irq_mark;
+    uint64_t user = rq->user_cycles - prev->user_mark;
+    uint64_t task = run > irq + user ? run - irq - user : 0;
+    
+    prev->kernel_cycles += task;
+    prev->user_cycles += user;
+    prev->irq_cycles += irq;
+    if (prev == rq->idle_process) {
+        rq->idle_cycles += task;
+    } else if (run > rq->max_run_cycles) {
+        rq->max_run_cycles = run;
+        rq->max_run_pid = prev->pid;
+    }
+    if (run > prev->max_run_cycles) {
+        prev->max_run_cycles = run;
+    }
+    
+    next->exec_start = now;
+    next->irq_mark = rq->irq_cycles;
+    next->user_mark = rq->user_cycles;
+}
+
+/**
+ * Enter interrupt / softirq context
+ */
+uint64_t cputime_irq_enter(void)
+{
+    this_cpu()->sched.irq_depth++;
+    return rdtsc();
+}
+
+/**
+ * Leave it again - the outermost region is charged to the CPU
+ */
+void cputime_irq_exit(uint64_t start)
+{
+    scheduler_t* rq = &this_cpu()->sched;
+    
+    if (--rq->irq_depth == 0) {
+        rq->irq_cycles += rdtsc() - start;
+    }
+}
+
+uint64_t cputime_task_cycles(process_t* proc)
+{
+    uint64_t cycles = proc->user_cycles + proc->kernel_cycles;
+    
+    if (proc->state == PROCESS_RUNNING) {
+        uint64_t now = rdtsc();
+        if (now > proc->exec_start) {
+            cycles += now - proc->exec_start;
+        }
+    }
+    return cycles;
+}
+
+uint64_t cputime_elapsed(scheduler_t* rq)
+{
+    return rq->clock_start ? rdtsc() - rq->clock_start : 0;
+}
+
+uint64_t cputime_idle(scheduler_t* rq)
+{
+    uint64_t idle = rq->idle_cycles;
+    process_t* idle_task = rq->idle_process;
+    
+    if (idle_task && rq->current_process == idle_task) {
+        uint64_t now = rdtsc();
+        if (now > idle_task->exec_start) {
+            idle += now - idle_task->exec_start;
+        }
+    }
+    return idle;
+}
@@ -0,0 +1,39 @@
+#ifndef KERNEL_PROC_CPUTIME_H
+#define KERNEL_PROC_CPUTIME_H
+
+#include <stdint.h>
+#include "process.h"
+
+// CPU time accounting in TSC cycles.
+//
+// A task is charged when it is switched out: the cycles since it was
+// switched in, minus the interrupt and softirq time that hit it in the
+// meantime, which is kept separately (per task and per CPU). Short runs
+// that end in a yield are charged exactly, unlike the tick counters.
+// Time in ring 3 is split off the same way: the kernel entry and exit
+// stubs (isr.asm, syscall_entry.asm) add every stretch in user mode to
+// the CPU's user_cycles (user_time.inc), and a task gets the part that
+// accrued while it ran.
+
+// First task on this CPU starts running (rq->lock held)
+void cputime_start(scheduler_t* rq, process_t* first);
+
+// Charge prev and start the clock for next (rq->lock held, prev != next)
+void cputime_switch(scheduler_t* rq, process_t* prev, process_t* next);
+
+// Bracket hard interrupt handlers and softirq processing (interrupts
+// disabled). Only the outermost region on a CPU is counted.
+uint64_t cputime_irq_enter(void);
+void cputime_irq_exit(uint64_t start);
+
+// Cycles a task has run so far, including a run in progress (racy
+// snapshot for statistics)
+uint64_t cputime_task_cycles(process_t* proc);
+
+// Cycles since this CPU started scheduling
+uint64_t cputime_elapsed(scheduler_t* rq);
+
+// Idle cycles of a CPU, including an idle run in progress
+uint64_t cputime_idle(scheduler_t* rq);
+
+#endif // KERNEL_PROC_CPUTIME_H
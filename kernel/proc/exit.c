@@ -0,0 +1,196 @@
+#include "exit.h"
+#include "pid.h"
+#include "user.h"
+#include "../mm/kheap.h"
+#include "../mm/kstack.h"
+#include "../arch/x86_64/fpu.h"
+#include "../sync/waitqueue.h"
+#include "../sync/rcu.h"
+#include "../../drivers/vga.h"
+
+// Exited tasks waiting for the reaper (lock-free LIFO through proc->next -
+// an exited task is on no other queue)
+static process_t* volatile reap_list = NULL;
+
+// Parents blocked in process_wait(); also serializes exit reporting
+static wait_queue_t child_exit_wq = WAIT_QUEUE_INIT;
+
+static volatile uint32_t reaped_total = 0;
+static volatile uint32_t reap_batches = 0;
+
+/**
+ * Queue a process for the reaper
+ */
+void reaper_push(process_t* proc)
+{
+    process_t* head = __atomic_load_n(&reap_list, __ATOMIC_RELAXED);
+    do {
+        proc->next = head;
+    } while (!__atomic_compare_exchange_n(&reap_list, &head, proc, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+struct wait_queue* reaper_child_exit_queue(void)
+{
+    return &child_exit_wq;
+}
+
+/**
+ * Is proc's parent still around to collect its exit code?
+ * (child_exit_wq.lock held, interrupts off - an RCU read-side section)
+ */
+static int reaper_parent_alive(process_t* proc)
+{
+    if (proc->parent_pid == IDLE_PID) {
+        return 0;
+    }
+    
+    uint64_t handle = ((uint64_t)proc->parent_generation << 32) | proc->parent_pid;
+    process_t* parent = process_find_handle(handle);
+    return parent && !parent->exiting;
+}
+
+/**
+ * Does child belong to parent? (generation guards against PID reuse)
+ */
+static int reaper_is_child(process_t* child, process_t* parent)
+{
+    return child->parent_pid == parent->pid &&
+           child->parent_generation == parent->generation;
+}
+
+int reaper_take_child(process_t* parent, uint32_t pid, int* exit_code)
+{
+    int have_child = 0;
+    process_t* child;
+    
+    for_each_process(child, cursor) {
+        if (!reaper_is_child(child, parent) || (pid && child->pid != pid)) {
+            continue;
+        }
+        have_child = 1;
+        
+        // Reported only once it is off-CPU with its stacks gone
+        if (child->state == PROCESS_ZOMBIE && child->exit_reported) {
+            if (exit_code) {
+                *exit_code = child->exit_code;
+            }
+            child->state = PROCESS_TERMINATED;
+            reaper_push(child);
+            return (int)child->pid;
+        }
+    }
+    
+    return have_child ? 0 : -1;
+}
+
+/**
+ * Report an exited task to its parent, or give it up if nobody will wait
+ */
+static void reaper_report_exit(process_t* proc)
+{
+    uint64_t flags = spin_lock_irqsave(&child_exit_wq.lock);
+    
+    proc->exit_reported = 1;
+    if (reaper_parent_alive(proc)) {
+        wake_up_all_locked(&child_exit_wq);
+    } else {
+        proc->state = PROCESS_TERMINATED;
+    }
+    
+    // Its own exited children are orphans now
+    process_t* child;
+    for_each_process(child, cursor) {
+        if (reaper_is_child(child, proc) && child->state == PROCESS_ZOMBIE &&
+            child->exit_reported) {
+            child->state = PROCESS_TERMINATED;
+            reaper_push(child);
+        }
+    }
+    
+    spin_unlock_irqrestore(&child_exit_wq.lock, flags);
+}
+
+/**
+ * Process everything queued since the last round
+ */
+static void reaper_run(void)
+{
+    process_t* list = __atomic_exchange_n(&reap_list, NULL, __ATOMIC_ACQUIRE);
+    process_t* dead = NULL;
+    
+    while (list) {
+        process_t* proc = list;
+        list = proc->next;
+        
+        // Still switching out on its CPU - look again next round
+        if (__atomic_load_n(&proc->on_cpu, __ATOMIC_ACQUIRE)) {
+            reaper_push(proc);
+            continue;
+        }
+        
+        if (proc->state == PROCESS_ZOMBIE && !proc->exit_reported) {
+            // Nothing runs on these stacks any more
+            kstack_free(proc->kernel_stack);
+            if (proc->user_stack) {
+                user_stack_free(proc->user_stack);
+            }
+            fpu_release(proc);
+            proc->kernel_stack = NULL;
+            proc->user_stack = NULL;
+            reaper_report_exit(proc);
+        }
+        
+        if (proc->state == PROCESS_TERMINATED) {
+            proc->next = dead;
+            dead = proc;
+        }
+    }
+    
+    if (!dead) {
+        return;
+    }
+    
+    // One grace period for the whole batch, then free the TCBs that PID
+    // lookups might still have been looking at
+    for (process_t* proc = dead; proc; proc = proc->next) {
+        pid_detach(proc);
+    }
+    synchronize_rcu();
+    
+    uint32_t count = 0;
+    while (dead) {
+        process_t* proc = dead;
+        dead = proc->next;
+        kfree(proc);
+        count++;
+    }
+    
+    __atomic_fetch_add(&reaped_total, count, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&reap_batches, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Reaper task - frees exited tasks in batches, away from the exit path
+ */
+static void reaper_task(void)
+{
+    for (;;) {
+        reaper_run();
+        process_sleep(REAPER_INTERVAL_TICKS);
+    }
+}
+
+void reaper_start(void)
+{
+    process_create("reaper", reaper_task, DEFAULT_PRIORITY);
+}
+
+void reaper_print_stats(void)
+{
+    vga_print("[REAP] Reaped: ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(reaped_total, VGA_COLOR_LIGHT_GREEN);
+    vga_print(" in ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(reap_batches, VGA_COLOR_LIGHT_GREEN);
+    vga_print(" batches\n", VGA_COLOR_LIGHT_GREEN);
+}
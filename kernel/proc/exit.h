@@ -0,0 +1,28 @@
+#ifndef KERNEL_PROC_EXIT_H
+#define KERNEL_PROC_EXIT_H
+
+#include <stdint.h>
+#include "process.h"
+
+// How often the reaper frees exited tasks (ticks)
+#define REAPER_INTERVAL_TICKS 5
+
+// Hand an exited (PROCESS_ZOMBIE) or waited-for (PROCESS_TERMINATED)
+// process to the reaper. Lock-free; safe with rq->lock held.
+void reaper_push(process_t* proc);
+
+// Spawn the reaper task
+void reaper_start(void);
+
+// Reap a zombie child of parent (wait queue lock held, interrupts off).
+// Returns its PID, 0 if matching children exist but none has exited, or
+// -1 if there is no matching child.
+int reaper_take_child(process_t* parent, uint32_t pid, int* exit_code);
+
+// Wait queue parents sleep on in process_wait()
+struct wait_queue* reaper_child_exit_queue(void);
+
+// Print reaper counters
+void reaper_print_stats(void);
+
+#endif // KERNEL_PROC_EXIT_H
@@ -0,0 +1,256 @@
+#include "group.h"
+#include "../arch/x86_64/cpu.h"
+#include "../arch/x86_64/interrupts.h"
+#include "../time/tsc.h"
+#include "../../drivers/vga.h"
+
+static task_group_t task_groups[TASK_GROUP_MAX];
+static uint32_t task_group_count = 0;
+static spinlock_t task_group_table_lock = SPINLOCK_INIT_NAMED("task_group");
+
+/**
+ * Convert milliseconds to TSC cycles
+ */
+static uint64_t ms_to_cycles(uint32_t ms)
+{
+    return tsc_khz() * ms;
+}
+
+/**
+ * Start a new period if the current one is over (group->lock held)
+ * Any overrun of the old period is forgiven
+ */
+static void group_roll_period(task_group_t* group, uint64_t now)
+{
+    uint64_t elapsed = now - group->period_start;
+    
+    if (elapsed >= group->period_cycles) {
+        if (group->period_used) {
+            group->nr_periods++;
+        }
+        group->period_start += (elapsed / group->period_cycles) * group->period_cycles;
+        group->period_used = 0;
+    }
+}
+
+/**
+ * Create a task group with a CPU bandwidth limit
+ */
+task_group_t* task_group_create(const char* name, uint32_t quota_ms, uint32_t period_ms)
+{
+    if (quota_ms && (!period_ms || quota_ms > period_ms)) {
+        return NULL;
+    }
+    
+    uint64_t flags = spin_lock_irqsave(&task_group_table_lock);
+    if (task_group_count >= TASK_GROUP_MAX) {
+        spin_unlock_irqrestore(&task_group_table_lock, flags);
+        return NULL;
+    }
+    task_group_t* group = &task_groups[task_group_count];
+    group->name = name;
+    spin_lock_init_named(&group->lock, "task_group");
+    group->quota_cycles = ms_to_cycles(quota_ms);
+    group->period_cycles = ms_to_cycles(period_ms);
+    group->period_start = rdtsc();
+    group->period_used = 0;
+    group->throttled = 0;
+    group->throttled_at = 0;
+    group->usage_cycles = 0;
+    group->throttled_cycles = 0;
+    group->nr_periods = 0;
+    group->nr_throttled = 0;
+    group->nr_tasks = 0;
+    task_group_count++;
+    spin_unlock_irqrestore(&task_group_table_lock, flags);
+    
+    return group;
+}
+
+/**
+ * Change the bandwidth limit of a group
+ */
+int task_group_set_bandwidth(task_group_t* group, uint32_t quota_ms, uint32_t period_ms)
+{
+    if (!group || (quota_ms && (!period_ms || quota_ms > period_ms))) {
+        return -1;
+    }
+    
+    uint64_t flags = spin_lock_irqsave(&group->lock);
+    group->quota_cycles = ms_to_cycles(quota_ms);
+    group->period_cycles = ms_to_cycles(period_ms);
+    spin_unlock_irqrestore(&group->lock, flags);
+    return 0;
+}
+
+/**
+ * Move a task into a group
+ */
+void task_group_attach(process_t* proc, task_group_t* group)
+{
+    if (!proc) {
+        return;
+    }
+    
+    uint64_t flags = irq_save();
+    if (proc->group) {
+        __atomic_sub_fetch(&proc->group->nr_tasks, 1, __ATOMIC_RELAXED);
+    }
+    if (group) {
+        __atomic_add_fetch(&group->nr_tasks, 1, __ATOMIC_RELAXED);
+    }
+    
+    // Time before the move is not billed to the new group
+    proc->group_mark = rdtsc();
+    proc->group = group;
+    irq_restore(flags);
+}
+
+/**
+ * Bill a task's group for the time since its last charge
+ */
+int task_group_charge(process_t* proc, uint64_t now)
+{
+    task_group_t* group = proc->group;
+    uint64_t delta = now - proc->group_mark;
+    
+    proc->group_mark = now;
+    if (!group) {
+        return 0;
+    }
+    
+    spin_lock(&group->lock);
+    group->usage_cycles += delta;
+    if (group->quota_cycles) {
+        // A throttled group is refilled by task_group_tick(), which also
+        // has to bring its parked tasks back
+        if (!group->throttled) {
+            group_roll_period(group, now);
+        }
+        group->period_used += delta;
+        if (!group->throttled && group->period_used >= group->quota_cycles) {
+            group->throttled = 1;
+            group->throttled_at = now;
+            group->nr_throttled++;
+        }
+    }
+    int throttled = group->throttled;
+    spin_unlock(&group->lock);
+    
+    return throttled;
+}
+
+/**
+ * Refill throttled groups whose period has ended
+ * Called from every CPU's timer tick; CPUs with parked tasks keep
+ * ticking, so a throttled group is never left waiting
+ */
+void task_group_tick(void)
+{
+    uint64_t now = rdtsc();
+    
+    for (uint32_t i = 0; i < task_group_count; i++) {
+        task_group_t* group = &task_groups[i];
+        if (!group->throttled) {
+            continue;
+        }
+        
+        spin_lock(&group->lock);
+        int refill = group->throttled &&
+                     (!group->quota_cycles || now - group->period_start >= group->period_cycles);
+        if (refill) {
+            // Rolling the period counts it (it was used); a group whose
+            // quota was lifted ends its last one here
+            if (group->quota_cycles) {
+                group_roll_period(group, now);
+            } else {
+                group->nr_periods++;
+            }
+            group->period_used = 0;
+            group->throttled = 0;
+            group->throttled_cycles += now - group->throttled_at;
+        }
+        spin_unlock(&group->lock);
+        
+        // Outside the group lock: the switch path takes it under rq->lock
+        if (refill) {
+            scheduler_unthrottle(group);
+        }
+    }
+}
+
+/**
+ * Print per-group counters
+ */
+void task_group_print_stats(void)
+{
+    for (uint32_t i = 0; i < task_group_count; i++) {
+        task_group_t* group = &task_groups[i];
+        
+        vga_print("[GROUP] ", VGA_COLOR_LIGHT_GREEN);
+        vga_print(group->name, VGA_COLOR_LIGHT_GREEN);
+        vga_print(": tasks ", VGA_COLOR_LIGHT_GREEN);
+        vga_print_int(group->nr_tasks, VGA_COLOR_LIGHT_GREEN);
+        if (group->quota_cycles) {
+            vga_print(", quota ", VGA_COLOR_LIGHT_GREEN);
+            vga_print_int((int32_t)(group->quota_cycles / tsc_khz()), VGA_COLOR_LIGHT_GREEN);
+            vga_print("/", VGA_COLOR_LIGHT_GREEN);
+            vga_print_int((int32_t)(group->period_cycles / tsc_khz()), VGA_COLOR_LIGHT_GREEN);
+            vga_print(" ms", VGA_COLOR_LIGHT_GREEN);
+        }
+        vga_print(", used ", VGA_COLOR_LIGHT_GREEN);
+        vga_print_int((int32_t)(tsc_cycles_to_us(group->usage_cycles) / 1000), VGA_COLOR_LIGHT_GREEN);
+        vga_print(" ms, throttled ", VGA_COLOR_LIGHT_GREEN);
+        vga_print_int(group->nr_throttled, VGA_COLOR_LIGHT_GREEN);
+        vga_print("/", VGA_COLOR_LIGHT_GREEN);
+        vga_print_int(group->nr_periods, VGA_COLOR_LIGHT_GREEN);
+        vga_print(" periods (", VGA_COLOR_LIGHT_GREEN);
+        vga_print_int((int32_t)(tsc_cycles_to_us(group->throttled_cycles) / 1000), VGA_COLOR_LIGHT_GREEN);
+        vga_print(" ms)", VGA_COLOR_LIGHT_GREEN);
+        vga_print("\n", VGA_COLOR_WHITE);
+    }
+}
+
+#if GROUP_BENCH
+static volatile uint64_t group_bench_loops[2];
+
+/**
+ * Busy loop that never blocks (index 0: throttled, 1: unlimited)
+ */
+static void group_bench_spin(uint32_t index)
+{
+    for (;;) {
+        group_bench_loops[index]++;
+        if ((group_bench_loops[index] & 0xFFFFF) == 0 && index == 0) {
+            process_t* self = get_current_process();
+            vga_print("[GROUP] bench: limited ", VGA_COLOR_LIGHT_CYAN);
+            vga_print_int((int32_t)(tsc_cycles_to_us(self->kernel_cycles) / 1000), VGA_COLOR_LIGHT_CYAN);
+            vga_print(" ms, throttled ", VGA_COLOR_LIGHT_CYAN);
+            vga_print_int(self->group->nr_throttled, VGA_COLOR_LIGHT_CYAN);
+            vga_print("\n", VGA_COLOR_WHITE);
+        }
+    }
+}
+
+static void group_bench_limited(void)
+{
+    group_bench_spin(0);
+}
+
+static void group_bench_free(void)
+{
+    group_bench_spin(1);
+}
+
+/**
+ * Two spinning tasks: one capped at 20 ms per 100 ms, one unlimited
+ */
+void group_bench_start(void)
+{
+    task_group_t* group = task_group_create("bench", 20, 100);
+    process_t* limited = process_create("grp_lim", group_bench_limited, DEFAULT_PRIORITY);
+    process_create("grp_free", group_bench_free, DEFAULT_PRIORITY);
+    
+    task_group_attach(limited, group);
+}
+#endif
@@ -0,0 +1,77 @@
+#ifndef KERNEL_PROC_GROUP_H
+#define KERNEL_PROC_GROUP_H
+
+#include <stdint.h>
+#include "process.h"
+
+// CPU bandwidth control. A task group may use at most 'quota' of CPU
+// time in every 'period', summed over all its tasks and CPUs. Usage is
+// charged in TSC cycles at every switch and timer tick; once the quota
+// is gone the group is throttled: its tasks are parked on their CPU's
+// throttled list (PROCESS_THROTTLED) until the timer tick that sees the
+// period end refills the quota and puts them back on the run queues.
+
+// Maximum number of task groups
+#define TASK_GROUP_MAX 8
+// Set to 1 to run a throttled busy-loop group at scheduler start
+#define GROUP_BENCH 0
+
+typedef struct task_group {
+    const char* name;
+    spinlock_t lock;           // Guards the period state below
+
+    // Bandwidth (quota_cycles == 0: unlimited)
+    uint64_t quota_cycles;
+    uint64_t period_cycles;
+    uint64_t period_start;     // TSC when the current period began
+    uint64_t period_used;      // Cycles used in the current period
+    volatile uint8_t throttled;
+    uint64_t throttled_at;     // TSC when the quota ran out
+
+    // Statistics
+    uint64_t usage_cycles;     // Total CPU time of all its tasks
+    uint64_t throttled_cycles; // Total time spent throttled
+    uint32_t nr_periods;       // Periods in which the group ran
+    uint32_t nr_throttled;     // Periods that ran out of quota
+    uint32_t nr_tasks;         // Tasks attached
+} task_group_t;
+
+// Create a group limited to quota_ms of CPU time every period_ms
+// (quota_ms = 0: no limit). Returns NULL if the table is full.
+task_group_t* task_group_create(const char* name, uint32_t quota_ms, uint32_t period_ms);
+
+// Change a group's bandwidth; a throttled group is released at the
+// next period boundary. Returns -1 on bad arguments.
+int task_group_set_bandwidth(task_group_t* group, uint32_t quota_ms, uint32_t period_ms);
+
+// Move a task into a group (NULL: no group). Meant for tasks that have
+// not started yet or for the calling task itself.
+void task_group_attach(process_t* proc, task_group_t* group);
+
+// Charge the cycles since the task's last charge (rq->lock held)
+// Returns nonzero if its group is throttled
+int task_group_charge(process_t* proc, uint64_t now);
+
+// Nonzero if the task belongs to a group that is out of quota
+static inline int task_group_throttled(process_t* proc) {
+    return proc->group && proc->group->throttled;
+}
+
+// Nonzero if the task's usage must be checked every tick
+static inline int task_group_limited(process_t* proc) {
+    return proc->group && proc->group->quota_cycles;
+}
+
+// Timer tick (before rq->lock is taken): refill groups whose period
+// has ended and unthrottle their tasks
+void task_group_tick(void);
+
+// Print per-group usage and throttle counters
+void task_group_print_stats(void);
+
+#if GROUP_BENCH
+// Spawn the benchmark tasks (before scheduler_start runs tasks)
+void group_bench_start(void);
+#endif
+
+#endif // KERNEL_PROC_GROUP_H
@@ -0,0 +1,82 @@
+#include "idle.h"
+#include "process.h"
+#include "balance.h"
+#include "../mm/pmm.h"
+#include "../arch/x86_64/interrupts.h"
+
+// Registered background jobs
+static idle_work_fn idle_work[IDLE_MAX_WORK];
+static uint32_t idle_work_count = 0;
+
+/**
+ * Register a background job for the idle task
+ */
+int idle_register_work(idle_work_fn fn)
+{
+    if (!fn || idle_work_count >= IDLE_MAX_WORK) {
+        return -1;
+    }
+    
+    idle_work[idle_work_count++] = fn;
+    return 0;
+}
+
+/**
+ * Run every registered job once
+ */
+int idle_run_work(void)
+{
+    int did_work = 0;
+    
+    for (uint32_t i = 0; i < idle_work_count; i++) {
+        // Stop as soon as real work shows up
+        if (scheduler_has_ready()) {
+            break;
+        }
+        if (idle_work[i]()) {
+            did_work = 1;
+        }
+    }
+    
+    return did_work;
+}
+
+/**
+ * Register the built-in background jobs
+ */
+void idle_init(void)
+{
+    idle_work_count = 0;
+    
+    // Pull work from busy CPUs before doing anything else
+    idle_register_work(balance_idle_steal);
+    
+    // Keep a pool of zeroed pages for page tables and new stacks
+    idle_register_work(pmm_prezero_page);
+}
+
+/**
+ * Idle task - runs only when nothing else is runnable
+ */
+void idle_task_main(void)
+{
+    for (;;) {
+        // Use spare cycles for background work first
+        if (idle_run_work()) {
+            continue;
+        }
+        
+        // Nothing left to do - halt until the next interrupt.
+        // Check for ready work with interrupts off so a wakeup between the
+        // check and hlt cannot be lost (sti only takes effect after hlt).
+        disable_interrupts();
+        if (!scheduler_has_ready()) {
+            __asm__ volatile("sti; hlt" : : : "memory");
+        } else {
+            // An interrupt made something runnable - hand over right away
+            // instead of waiting for the next (possibly far away) tick
+            scheduler_yield();
+            enable_interrupts();
+        }
+    }
+}
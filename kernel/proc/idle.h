@@ -0,0 +1,26 @@
+#ifndef KERNEL_PROC_IDLE_H
+#define KERNEL_PROC_IDLE_H
+
+#include <stdint.h>
+
+// Maximum number of registered idle-time background jobs
+#define IDLE_MAX_WORK 8
+
+// Background job run by the idle task
+// Should do a small, bounded amount of work and return nonzero if it did
+// anything (so the idle loop knows to try again before halting)
+typedef int (*idle_work_fn)(void);
+
+// Reset the job list and register the built-in jobs (work stealing, page pre-zeroing)
+void idle_init(void);
+
+// Register a background job for the idle task (returns 0 on success)
+int idle_register_work(idle_work_fn fn);
+
+// Run each registered job once (returns nonzero if any did work)
+int idle_run_work(void);
+
+// Idle task entry point - never returns
+void idle_task_main(void);
+
+#endif // KERNEL_PROC_IDLE_H
@@ -0,0 +1,178 @@
+#include "pid.h"
+#include "../sync/spinlock.h"
+#include "../sync/rcu.h"
+
+// Allocator state, all under pid_lock. Lookups read pid_table without the
+// lock; entries are published with rcu_assign_pointer(). The reaper
+// detaches a whole batch of dead TCBs, waits in synchronize_rcu() and
+// only then kfree()s them, so a TCB found inside rcu_read_lock() stays
+// valid until the matching rcu_read_unlock().
+static spinlock_t pid_lock = SPINLOCK_INIT_NAMED("pid");
+static uint64_t pid_bitmap[PID_WORDS];      // Set = PID in use
+static process_t* pid_table[PID_MAX];       // PID -> TCB
+static uint32_t pid_generation[PID_MAX];    // Bumped every time a PID is freed
+static uint32_t pid_last = 0;               // Last PID handed out
+static uint32_t pid_in_use = 0;             // Idle tasks excluded
+
+/**
+ * Reset the allocator
+ */
+void pid_init(void)
+{
+    uint64_t flags = spin_lock_irqsave(&pid_lock);
+    for (uint32_t i = 0; i < PID_WORDS; i++) {
+        pid_bitmap[i] = 0;
+    }
+    pid_bitmap[0] = 1;  // PID 0 = idle
+    pid_last = 0;
+    pid_in_use = 0;
+    spin_unlock_irqrestore(&pid_lock, flags);
+}
+
+/**
+ * Reserve the next free PID after the last one handed out
+ */
+uint32_t pid_alloc(void)
+{
+    uint64_t flags = spin_lock_irqsave(&pid_lock);
+    
+    if (pid_in_use >= MAX_PROCESSES) {
+        spin_unlock_irqrestore(&pid_lock, flags);
+        return 0;
+    }
+    
+    // At most PID_WORDS + 1 words to look at: the start word is visited
+    // again at the end for the bits below the start position
+    uint32_t start = (pid_last + 1) % PID_MAX;
+    uint32_t word = start / 64;
+    uint64_t mask = ~0ULL << (start % 64);
+    
+    for (uint32_t i = 0; i <= PID_WORDS; i++) {
+        uint64_t free = ~pid_bitmap[word] & mask;
+        if (free) {
+            uint32_t pid = word * 64 + (uint32_t)__builtin_ctzll(free);
+            pid_bitmap[word] |= 1ULL << (pid % 64);
+            pid_last = pid;
+            pid_in_use++;
+            spin_unlock_irqrestore(&pid_lock, flags);
+            return pid;
+        }
+        word = (word + 1) % PID_WORDS;
+        mask = ~0ULL;
+    }
+    
+    spin_unlock_irqrestore(&pid_lock, flags);
+    return 0;
+}
+
+/**
+ * Free a PID (pid_lock held)
+ */
+static void pid_free_locked(uint32_t pid)
+{
+    pid_bitmap[pid / 64] &= ~(1ULL << (pid % 64));
+    pid_in_use--;
+}
+
+/**
+ * Give back a PID whose process was never created
+ */
+void pid_release(uint32_t pid)
+{
+    if (pid == 0 || pid >= PID_MAX) {
+        return;
+    }
+    
+    uint64_t flags = spin_lock_irqsave(&pid_lock);
+    pid_free_locked(pid);
+    spin_unlock_irqrestore(&pid_lock, flags);
+}
+
+/**
+ * Make a process visible to lookups
+ */
+void pid_attach(process_t* proc)
+{
+    uint64_t flags = spin_lock_irqsave(&pid_lock);
+    proc->generation = pid_generation[proc->pid];
+    rcu_assign_pointer(pid_table[proc->pid], proc);
+    spin_unlock_irqrestore(&pid_lock, flags);
+}
+
+/**
+ * Remove a process from the table and free its PID
+ */
+int pid_detach(process_t* proc)
+{
+    if (proc->pid == 0 || proc->pid >= PID_MAX) {
+        return 0;
+    }
+    
+    uint64_t flags = spin_lock_irqsave(&pid_lock);
+    if (pid_table[proc->pid] != proc) {
+        spin_unlock_irqrestore(&pid_lock, flags);
+        return 0;
+    }
+    
+    rcu_assign_pointer(pid_table[proc->pid], NULL);
+    pid_generation[proc->pid]++;
+    pid_free_locked(proc->pid);
+    spin_unlock_irqrestore(&pid_lock, flags);
+    return 1;
+}
+
+uint32_t pid_count(void)
+{
+    return pid_in_use;
+}
+
+process_t* process_find(uint32_t pid)
+{
+    if (pid == 0 || pid >= PID_MAX) {
+        return NULL;
+    }
+    return rcu_dereference(pid_table[pid]);
+}
+
+uint64_t process_handle(process_t* proc)
+{
+    return ((uint64_t)proc->generation << 32) | proc->pid;
+}
+
+process_t* process_find_handle(uint64_t handle)
+{
+    process_t* proc = process_find((uint32_t)handle);
+    
+    // generation never changes for a given TCB, so one comparison is enough
+    if (proc && proc->generation == (uint32_t)(handle >> 32)) {
+        return proc;
+    }
+    return NULL;
+}
+
+/**
+ * Find the next published process, skipping empty bitmap words
+ */
+process_t* process_iter_next(uint32_t* cursor)
+{
+    uint32_t pid = *cursor;
+    
+    while (pid < PID_MAX) {
+        uint64_t bits = __atomic_load_n(&pid_bitmap[pid / 64], __ATOMIC_RELAXED) >> (pid % 64);
+        if (!bits) {
+            pid = (pid / 64 + 1) * 64;
+            continue;
+        }
+        
+        pid += (uint32_t)__builtin_ctzll(bits);
+        process_t* proc = rcu_dereference(pid_table[pid]);
+        pid++;
+        if (proc) {
+            *cursor = pid;
+            return proc;
+        }
+    }
+    
+    *cursor = PID_MAX;
+    return NULL;
+}
@@ -0,0 +1,48 @@
+#ifndef KERNEL_PROC_PID_H
+#define KERNEL_PROC_PID_H
+
+#include <stdint.h>
+#include "process.h"
+
+// Size of the PID space (PID 0 belongs to the idle tasks and is never
+// handed out). Larger than MAX_PROCESSES so a freed PID rests for a while.
+#define PID_MAX 1024
+#define PID_WORDS (PID_MAX / 64)
+
+// Reset the allocator (scheduler_init)
+void pid_init(void);
+
+// Reserve a PID. Freed PIDs are recycled through a bitmap, searched from
+// the last PID handed out so reuse is delayed as long as possible.
+// Returns 0 if MAX_PROCESSES are alive.
+uint32_t pid_alloc(void);
+
+// Give back a PID that was never attached to a process
+void pid_release(uint32_t pid);
+
+// Publish proc under proc->pid and stamp its generation
+void pid_attach(process_t* proc);
+
+// Unpublish proc and free its PID. Returns 0 if it was already detached
+// (someone else is tearing it down).
+int pid_detach(process_t* proc);
+
+// Processes holding a PID (idle tasks excluded)
+uint32_t pid_count(void);
+
+// PID -> process in O(1), NULL if unused. Call under rcu_read_lock(); the
+// process stays valid until rcu_read_unlock().
+process_t* process_find(uint32_t pid);
+
+// PID plus generation - does not match a later process reusing the PID
+uint64_t process_handle(process_t* proc);
+process_t* process_find_handle(uint64_t handle);
+
+// Next process at or after *cursor in PID order (rcu_read_lock() held)
+process_t* process_iter_next(uint32_t* cursor);
+
+// Visit every process, ready, sleeping or blocked (rcu_read_lock() held)
+#define for_each_process(proc, cursor) \
+    for (uint32_t cursor = 0; ((proc) = process_iter_next(&cursor)) != NULL; )
+
+#endif // KERNEL_PROC_PID_H
@@ -0,0 +1,44 @@
+#ifndef KERNEL_PROC_PREEMPT_H
+#define KERNEL_PROC_PREEMPT_H
+
+#include <stddef.h>
+#include "../arch/x86_64/percpu.h"
+
+// Per-CPU preemption counter. While it is nonzero the timer and IPI
+// handlers leave the running task alone and note the missed switch in
+// need_resched; the last preempt_enable() then yields. Code in between
+// must not block or yield. The counter is updated with a single %gs-
+// relative instruction so an interrupt can never split the access.
+
+static inline uint32_t preempt_count(void) {
+    uint32_t count;
+    __asm__ volatile("movl %%gs:%c1, %0"
+                     : "=r"(count) : "i"(offsetof(cpu_t, preempt_count)));
+    return count;
+}
+
+static inline void preempt_disable(void) {
+    __asm__ volatile("incl %%gs:%c0" : : "i"(offsetof(cpu_t, preempt_count)) : "memory");
+}
+
+// Drop the count without catching up on a held-back switch (the caller
+// deals with need_resched itself)
+static inline void preempt_enable_no_resched(void) {
+    __asm__ volatile("decl %%gs:%c0" : : "i"(offsetof(cpu_t, preempt_count)) : "memory");
+}
+
+static inline void preempt_enable(void) {
+    __asm__ volatile("decl %%gs:%c0" : : "i"(offsetof(cpu_t, preempt_count)) : "memory");
+    
+    // Catch up on a switch the tick wanted to make (only from task
+    // context - interrupt handlers run with IF clear)
+    if (preempt_count() == 0 && this_cpu()->need_resched) {
+        uint64_t flags;
+        __asm__ volatile("pushfq; pop %0" : "=r"(flags));
+        if (flags & 0x200) {
+            scheduler_yield();
+        }
+    }
+}
+
+#endif // KERNEL_PROC_PREEMPT_H
@@ -1,11 +1,33 @@
 #include "process.h"
 #include "../../drivers/vga.h"
 #include "../mm/kheap.h"
-
-// Port I/O for EOI
-static inline void outb(uint16_t port, uint8_t value) {
-    __asm__ volatile ("outb %0, %1" : : "a"(value), "Nd"(port));
-}
+#include "../mm/kstack.h"
+#include "../arch/x86_64/interrupts.h"
+#include "../arch/x86_64/percpu.h"
+#include "../arch/x86_64/smp.h"
+#include "../arch/x86_64/lapic.h"
+#include "../arch/x86_64/fpu.h"
+#include "../time/tick.h"
+#include "../time/tsc.h"
+#include "../time/ktime.h"
+#include "../time/hrtimer.h"
+#include "../time/vtime.h"
+#include "../../drivers/hpet.h"
+#include "idle.h"
+#include "balance.h"
+#include "../sync/waitqueue.h"
+#include "../sync/rcu.h"
+#include "preempt.h"
+#include "trace.h"
+#include "pid.h"
+#include "exit.h"
+#include "workqueue.h"
+#include "cputime.h"
+#include "group.h"
+#include "syscall.h"
+#include "user.h"
+#include "../irq/softirq.h"
+#include "../irq/irqdesc.h"
 
 // String utilities
 static inline void strncpy_safe(char* dest, const char* src, size_t n)
@@ -49,67 +71,131 @@ static inline int snprintf_safe(char* buf, size_t size, const char* fmt, uint32_
     return i;
 }
 
-// Global scheduler state
-static scheduler_t scheduler = {0};
-static process_t process_table[MAX_PROCESSES] = {0};
+static process_t* process_build(const char* name, void (*entry)(void), uint32_t priority, uint32_t pid);
+#if SWITCH_BENCH
+static void switch_bench_start(void);
+#endif
 
-// Flag to indicate reschedule is needed
-volatile uint8_t need_reschedule = 0;
+/**
+ * Run queue of the executing CPU
+ */
+static inline scheduler_t* this_rq(void)
+{
+    return &this_cpu()->sched;
+}
 
 /**
- * Initialize the scheduler
+ * Initialize the scheduler (bootstrap processor)
  */
 void scheduler_init(void)
 {
-    scheduler.ready_queue_head = NULL;
-    scheduler.ready_queue_tail = NULL;
-    scheduler.current_process = NULL;
-    scheduler.next_pid = 1;  // PID 0 reserved for idle
-    scheduler.process_count = 0;
-    scheduler.total_ticks = 0;
+    pid_init();
+    idle_init();
+    
+    // Calibration reference and clocksource, if the firmware has one
+    hpet_init();
+    tsc_init();
+    ktime_init();
+    vtime_init();
+    hrtimers_init();
+    syscall_init();
+    user_init();
+    scheduler_init_cpu();
     
     vga_print("[SCHED] Scheduler initialized", VGA_COLOR_LIGHT_GREEN);
     vga_print("\n", VGA_COLOR_WHITE);
 }
 
 /**
- * Enqueue a process to the ready queue
+ * Initialize the run queue and idle task of the executing CPU
+ */
+void scheduler_init_cpu(void)
+{
+    scheduler_t* rq = this_rq();
+    uint32_t id = this_cpu()->id;
+    
+    spin_lock_init_named(&rq->lock, "runqueue");
+    rq->ready_queue_head = NULL;
+    rq->ready_queue_tail = NULL;
+    rq->current_process = NULL;
+    rq->sleep_queue_head = NULL;
+    rq->prev_process = NULL;
+    rq->nr_ready = 0;
+    rq->next_balance = BALANCE_INTERVAL_TICKS;
+    rq->total_ticks = 0;
+    rq->idle_ticks = 0;
+    rq->clock_start = 0;
+    rq->idle_cycles = 0;
+    rq->irq_cycles = 0;
+    rq->max_run_cycles = 0;
+    rq->max_run_pid = 0;
+    rq->irq_depth = 0;
+    rq->throttled_head = NULL;
+    rq->nr_throttled = 0;
+    hrtimers_init_cpu();
+    
+    // "idle<cpu>"
+    char name[8] = "idle";
+    uint32_t len = 4;
+    if (id >= 10) {
+        name[len++] = '0' + (id / 10) % 10;
+    }
+    name[len++] = '0' + id % 10;
+    name[len] = '\0';
+    
+    // Idle task is never on the ready queue - it is picked only when
+    // nothing else is runnable
+    rq->idle_process = process_build(name, idle_task_main, 0, IDLE_PID);
+    if (!rq->idle_process) {
+        vga_print("[ERR] Failed to create idle task", VGA_COLOR_LIGHT_RED);
+        vga_print("\n", VGA_COLOR_WHITE);
+        return;
+    }
+    rq->idle_process->affinity = 1u << id;
+    
+    trace_init_cpu();
+}
+
+/**
+ * Enqueue a process to a ready queue (rq->lock held)
  */
-static void queue_enqueue(process_t* proc)
+void rq_enqueue(scheduler_t* rq, process_t* proc)
 {
     if (!proc) return;
     
     proc->next = NULL;
+    rq->nr_ready++;
     
-    if (scheduler.ready_queue_tail == NULL) {
+    if (rq->ready_queue_tail == NULL) {
         // Queue is empty
-        scheduler.ready_queue_head = proc;
-        scheduler.ready_queue_tail = proc;
+        rq->ready_queue_head = proc;
+        rq->ready_queue_tail = proc;
         proc->prev = NULL;
     } else {
         // Add to end
-        proc->prev = scheduler.ready_queue_tail;
-        scheduler.ready_queue_tail->next = proc;
-        scheduler.ready_queue_tail = proc;
+        proc->prev = rq->ready_queue_tail;
+        rq->ready_queue_tail->next = proc;
+        rq->ready_queue_tail = proc;
     }
 }
 
 /**
- * Dequeue a process from the ready queue
+ * Dequeue a process from a ready queue (rq->lock held)
  */
-static process_t* queue_dequeue(void)
+static process_t* queue_dequeue(scheduler_t* rq)
 {
-    if (scheduler.ready_queue_head == NULL) {
+    if (rq->ready_queue_head == NULL) {
         return NULL;
     }
     
-    process_t* proc = scheduler.ready_queue_head;
-    scheduler.ready_queue_head = proc->next;
+    process_t* proc = rq->ready_queue_head;
+    rq->ready_queue_head = proc->next;
+    rq->nr_ready--;
     
-    if (scheduler.ready_queue_head == NULL) {
-        scheduler.ready_queue_tail = NULL;
+    if (rq->ready_queue_head == NULL) {
+        rq->ready_queue_tail = NULL;
     } else {
-        scheduler.ready_queue_head->prev = NULL;
+        rq->ready_queue_head->prev = NULL;
     }
     
     proc->next = NULL;
@@ -119,17 +205,83 @@ static process_t* queue_dequeue(void)
 }
 
 /**
- * Create a new process
- * Returns NULL if failed (out of memory or max processes reached)
+ * Unlink a process from anywhere in a ready queue (rq->lock held)
  */
-process_t* process_create(const char* name, void (*entry)(void), uint32_t priority)
+void rq_remove(scheduler_t* rq, process_t* proc)
 {
-    if (scheduler.process_count >= MAX_PROCESSES) {
-        vga_print("[ERR] Max processes reached", VGA_COLOR_LIGHT_RED);
-        vga_print("\n", VGA_COLOR_WHITE);
-        return NULL;
+    if (proc->prev) proc->prev->next = proc->next;
+    if (proc->next) proc->next->prev = proc->prev;
+    if (rq->ready_queue_head == proc) rq->ready_queue_head = proc->next;
+    if (rq->ready_queue_tail == proc) rq->ready_queue_tail = proc->prev;
+    rq->nr_ready--;
+    
+    proc->next = NULL;
+    proc->prev = NULL;
+}
+
+/**
+ * Park a process whose group ran out of quota (rq->lock held)
+ */
+static void rq_throttle(scheduler_t* rq, process_t* proc)
+{
+    proc->state = PROCESS_THROTTLED;
+    proc->prev = NULL;
+    proc->next = rq->throttled_head;
+    if (rq->throttled_head) {
+        rq->throttled_head->prev = proc;
+    }
+    rq->throttled_head = proc;
+    rq->nr_throttled++;
+    trace_sched(TRACE_THROTTLE, proc->pid, proc->cpu);
+}
+
+/**
+ * Unlink a parked process (rq->lock held)
+ */
+static void rq_unthrottle(scheduler_t* rq, process_t* proc)
+{
+    if (proc->prev) proc->prev->next = proc->next;
+    if (proc->next) proc->next->prev = proc->prev;
+    if (rq->throttled_head == proc) rq->throttled_head = proc->next;
+    rq->nr_throttled--;
+    
+    proc->next = NULL;
+    proc->prev = NULL;
+}
+
+/**
+ * Queue a process that became ready on this CPU (rq->lock held)
+ * A process whose affinity excludes this CPU is handed to an allowed CPU,
+ * as long as that CPU's lock can be taken without waiting
+ */
+static void rq_enqueue_allowed(scheduler_t* rq, process_t* proc)
+{
+    uint32_t self = this_cpu()->id;
+    
+    if (!(proc->affinity & (1u << self))) {
+        for (uint32_t i = 0; i < cpu_count(); i++) {
+            scheduler_t* target = &cpu_get(i)->sched;
+            if (!(proc->affinity & (1u << i)) || !spin_trylock(&target->lock)) {
+                continue;
+            }
+            proc->cpu = i;
+            rq_enqueue(target, proc);
+            spin_unlock(&target->lock);
+            balance_kick_cpu(i);
+            return;
+        }
     }
     
+    // Allowed here, or every allowed CPU is busy - try again next switch
+    rq_enqueue(rq, proc);
+}
+
+/**
+ * Allocate a TCB and build its initial stack frame (not queued)
+ * Returns NULL if out of memory
+ */
+static process_t* process_build(const char* name, void (*entry)(void), uint32_t priority, uint32_t pid)
+{
     // Allocate process structure
     process_t* proc = (process_t*)kmalloc(sizeof(process_t));
     if (!proc) {
@@ -139,8 +291,11 @@ process_t* process_create(const char* name, void (*entry)(void), uint32_t priori
     }
     
     // Initialize process fields
-    proc->pid = scheduler.next_pid++;
-    proc->parent_pid = scheduler.current_process ? scheduler.current_process->pid : 0;
+    proc->pid = pid;
+    process_t* parent = get_current_process();
+    proc->parent_pid = parent ? parent->pid : 0;
+    proc->parent_generation = parent ? parent->generation : 0;
+    proc->cpu = 0;  // Set when it is queued
     
     if (name) {
         strncpy_safe(proc->name, name, sizeof(proc->name));
@@ -154,9 +309,26 @@ process_t* process_create(const char* name, void (*entry)(void), uint32_t priori
     proc->time_slice_remaining = TIME_SLICE_TICKS;
     proc->total_ticks = 0;
     proc->wake_time = 0;
+    proc->affinity = AFFINITY_ALL;
+    proc->on_cpu = 0;
+    proc->wait_queue = NULL;
+    proc->exec_start = 0;
+    proc->irq_mark = 0;
+    proc->user_mark = 0;
+    proc->user_cycles = 0;
+    proc->kernel_cycles = 0;
+    proc->irq_cycles = 0;
+    proc->max_run_cycles = 0;
+    proc->group = NULL;
+    proc->group_mark = 0;
+    proc->fpu_state = NULL;
+    proc->fpu_cpu = FPU_CPU_NONE;
+    proc->exiting = 0;
+    proc->exit_reported = 0;
+    proc->exit_code = 0;
     
     // Allocate stacks
-    proc->kernel_stack = kmalloc(PROCESS_STACK_SIZE);
+    proc->kernel_stack = kstack_alloc();
     if (!proc->kernel_stack) {
         kfree(proc);
         vga_print("[ERR] Failed to allocate kernel stack", VGA_COLOR_LIGHT_RED);
@@ -164,93 +336,284 @@ process_t* process_create(const char* name, void (*entry)(void), uint32_t priori
         return NULL;
     }
     
-    proc->user_stack = kmalloc(PROCESS_STACK_SIZE);
-    if (!proc->user_stack) {
-        kfree(proc->kernel_stack);
-        kfree(proc);
-        vga_print("[ERR] Failed to allocate user stack", VGA_COLOR_LIGHT_RED);
-        vga_print("\n", VGA_COLOR_WHITE);
-        return NULL;
-    }
+    // Only user tasks get one (process_create_user)
+    proc->user_stack = NULL;
+    proc->user_entry = 0;
     
-    // Initialize stack pointers to top of stacks
-    proc->kernel_stack_top = (void*)((uint64_t)proc->kernel_stack + PROCESS_STACK_SIZE);
+    // Initialize stack pointers to top of stacks (16-byte aligned)
+    proc->kernel_stack_top = (void*)(((uint64_t)proc->kernel_stack + PROCESS_STACK_SIZE) & ~0xFULL);
     
-    // Set up initial stack frame for interrupt return
-    // When preempt_handler returns this stack pointer, iretq will pop:
-    // SS, RSP, RFLAGS, CS, RIP (in that order)
+    // Set up the frame switch_to() pops on the first switch: callee-saved
+    // registers, then the return address. It "returns" into task_start
+    // with the stack aligned, which calls process_start(entry).
     uint64_t* stack = (uint64_t*)proc->kernel_stack_top;
     
-    // Build stack frame (working backwards from top)
-    stack--;  *stack = 0x10;           // SS (data segment)
-    stack--;  *stack = (uint64_t)proc->kernel_stack_top;  // RSP
-    stack--;  *stack = 0x202;          // RFLAGS (IF=1, interrupts enabled)
-    stack--;  *stack = 0x08;           // CS (code segment)
-    stack--;  *stack = (uint64_t)entry;  // RIP (entry point)
-    
-    // Build register save frame (what irq_common_stub pushes)
-    stack--;  *stack = 0;  // Interrupt number (dummy)
-    stack--;  *stack = 0;  // Error code (dummy)
-    stack--;  *stack = 0;  // RAX
-    stack--;  *stack = 0;  // RBX
-    stack--;  *stack = 0;  // RCX
-    stack--;  *stack = 0;  // RDX
-    stack--;  *stack = 0;  // RSI
-    stack--;  *stack = 0;  // RDI
-    stack--;  *stack = 0;  // RBP
-    stack--;  *stack = 0;  // R8
-    stack--;  *stack = 0;  // R9
-    stack--;  *stack = 0;  // R10
-    stack--;  *stack = 0;  // R11
-    stack--;  *stack = 0;  // R12
-    stack--;  *stack = 0;  // R13
-    stack--;  *stack = 0;  // R14
-    stack--;  *stack = 0;  // R15
-    
-    // Store stack pointer (points to R15 position)
-    proc->registers.rsp = (uint64_t)stack;
-    proc->registers.rbp = (uint64_t)proc->kernel_stack_top;
-    proc->registers.rip = (uint64_t)entry;
-    proc->registers.rflags = 0x202;  // Enable interrupts (IF flag)
+    stack--;  *stack = (uint64_t)task_start;  // Return address
+    stack--;  *stack = 0;                // RBP
+    stack--;  *stack = 0;                // RBX
+    stack--;  *stack = (uint64_t)entry;  // R12 (entry function)
+    stack--;  *stack = 0;                // R13
+    stack--;  *stack = 0;                // R14
+    stack--;  *stack = 0;                // R15
+    
+    proc->context.rsp = (uint64_t)stack;
     
     // Page table (for now, use kernel's - no isolation yet)
     proc->page_table = NULL;  // NULL means use kernel page table
     
-    // Add to ready queue
-    queue_enqueue(proc);
-    scheduler.process_count++;
+    proc->next = NULL;
+    proc->prev = NULL;
+    proc->generation = 0;  // Stamped by pid_attach()
+    
+    return proc;
+}
+
+/**
+ * Build a process and queue it on the calling CPU
+ * user_entry != NULL makes it a user task: it starts in user_task_main,
+ * which drops to ring 3 at user_entry on a user stack
+ */
+static process_t* process_spawn(const char* name, void (*entry)(void), uint32_t priority,
+                                void (*user_entry)(void))
+{
+    uint32_t pid = pid_alloc();
+    if (!pid) {
+        vga_print("[ERR] Max processes reached", VGA_COLOR_LIGHT_RED);
+        vga_print("\n", VGA_COLOR_WHITE);
+        return NULL;
+    }
+    
+    process_t* proc = process_build(name, entry, priority, pid);
+    if (!proc) {
+        pid_release(pid);
+        return NULL;
+    }
+    
+    if (user_entry) {
+        proc->user_stack = user_stack_alloc();
+        if (!proc->user_stack) {
+            kstack_free(proc->kernel_stack);
+            kfree(proc);
+            pid_release(pid);
+            vga_print("[ERR] Failed to allocate user stack", VGA_COLOR_LIGHT_RED);
+            vga_print("\n", VGA_COLOR_WHITE);
+            return NULL;
+        }
+        proc->user_entry = (uint64_t)user_entry;
+    }
+    
+    pid_attach(proc);
+    
+    // Children share their creator's CPU bandwidth
+    process_t* creator = get_current_process();
+    if (creator && creator->group) {
+        task_group_attach(proc, creator->group);
+    }
+    
+    // Add to this CPU's ready queue
+    uint64_t flags = irq_save();
+    scheduler_t* rq = this_rq();
+    proc->cpu = this_cpu()->id;
+    spin_lock(&rq->lock);
+    rq_enqueue(rq, proc);
+    spin_unlock_irqrestore(&rq->lock, flags);
+    
+    // A second runnable process means slice expiry matters again
+    scheduler_kick_tick();
+    
+    // Let an idle CPU come and take it
+    balance_kick_idle();
     
     vga_print("[SCHED] Created process: ", VGA_COLOR_LIGHT_CYAN);
     vga_print(proc->name, VGA_COLOR_LIGHT_CYAN);
     vga_print(" (PID: ", VGA_COLOR_LIGHT_CYAN);
     vga_print_int(proc->pid, VGA_COLOR_LIGHT_CYAN);
-    vga_print(")", VGA_COLOR_LIGHT_CYAN);
+    vga_print(user_entry ? ", user)" : ")", VGA_COLOR_LIGHT_CYAN);
     vga_print("\n", VGA_COLOR_WHITE);
     
     return proc;
 }
 
 /**
- * Kill a process and free resources
+ * Create a new process (queued on the calling CPU)
+ * Returns NULL if failed (out of memory or max processes reached)
+ */
+process_t* process_create(const char* name, void (*entry)(void), uint32_t priority)
+{
+    return process_spawn(name, entry, priority, NULL);
+}
+
+/**
+ * Create a process that runs entry in ring 3
+ * entry must be USER_TEXT (proc/user.h); returning from it exits
+ */
+process_t* process_create_user(const char* name, void (*entry)(void), uint32_t priority)
+{
+    if (!user_code_ok(entry)) {
+        vga_print("[ERR] User entry point outside the user section", VGA_COLOR_LIGHT_RED);
+        vga_print("\n", VGA_COLOR_WHITE);
+        return NULL;
+    }
+    
+    return process_spawn(name, user_task_main, priority, entry);
+}
+
+/**
+ * Lock the run queue a process belongs to
+ * Its CPU can change while it is queued (load balancer), so re-check
+ * once the lock is held
+ */
+static scheduler_t* process_lock_rq(process_t* proc, uint64_t* flags)
+{
+    for (;;) {
+        uint32_t cpu = __atomic_load_n(&proc->cpu, __ATOMIC_RELAXED);
+        scheduler_t* rq = &cpu_get(cpu)->sched;
+        *flags = spin_lock_irqsave(&rq->lock);
+        if (proc->cpu == cpu) {
+            return rq;
+        }
+        spin_unlock_irqrestore(&rq->lock, *flags);
+    }
+}
+
+/**
+ * Kill a process
+ * A task that is not running becomes a zombie right away; a running one
+ * is switched out by its CPU at the next scheduling point. The reaper
+ * frees it once it is off-CPU.
  */
 void process_kill(process_t* proc)
 {
-    if (!proc) return;
+    if (!proc || proc->pid == IDLE_PID) return;
     
-    proc->state = PROCESS_TERMINATED;
+    if (proc == get_current_process()) {
+        process_exit(PROCESS_EXIT_KILLED);
+    }
     
-    // Remove from ready queue if there
-    if (proc->prev) proc->prev->next = proc->next;
-    if (proc->next) proc->next->prev = proc->prev;
-    if (scheduler.ready_queue_head == proc) scheduler.ready_queue_head = proc->next;
-    if (scheduler.ready_queue_tail == proc) scheduler.ready_queue_tail = proc->prev;
+    // Only the first of exit/kill gets to tear it down
+    if (__atomic_exchange_n(&proc->exiting, 1, __ATOMIC_ACQ_REL)) return;
+    
+    // Blocked processes are only known to their wait queue
+    if (proc->state == PROCESS_WAITING && proc->wait_queue) {
+        wait_queue_remove(proc->wait_queue, proc);
+    }
     
-    // Free resources
-    if (proc->kernel_stack) kfree(proc->kernel_stack);
-    if (proc->user_stack) kfree(proc->user_stack);
-    kfree(proc);
+    uint64_t flags;
+    scheduler_t* rq = process_lock_rq(proc, &flags);
+    int running = 0;
     
-    scheduler.process_count--;
+    proc->exit_code = PROCESS_EXIT_KILLED;
+    switch (proc->state) {
+    case PROCESS_READY:
+        rq_remove(rq, proc);
+        break;
+    case PROCESS_SLEEPING:
+        if (proc->prev) proc->prev->next = proc->next;
+        if (proc->next) proc->next->prev = proc->prev;
+        if (rq->sleep_queue_head == proc) rq->sleep_queue_head = proc->next;
+        break;
+    case PROCESS_THROTTLED:
+        rq_unthrottle(rq, proc);
+        break;
+    case PROCESS_RUNNING:
+        running = 1;  // scheduler_switch() hands it to the reaper
+        break;
+    default:
+        break;        // Waiting - already off its wait queue
+    }
+    
+    if (!running) {
+        proc->state = PROCESS_ZOMBIE;
+        reaper_push(proc);
+    }
+    
+    spin_unlock_irqrestore(&rq->lock, flags);
+    
+    // Make its CPU notice now rather than at the end of the slice
+    if (running && lapic_available()) {
+        lapic_send_ipi(cpu_get(proc->cpu)->apic_id, LAPIC_RESCHED_VECTOR);
+    }
+}
+
+/**
+ * Terminate the calling process
+ */
+void process_exit(int exit_code)
+{
+    process_t* self = get_current_process();
+    
+    if (!self || self->pid == IDLE_PID) {
+        vga_print("[ERR] process_exit outside a process", VGA_COLOR_LIGHT_RED);
+        vga_print("\n", VGA_COLOR_WHITE);
+        for (;;) {
+            __asm__ volatile("hlt");
+        }
+    }
+    
+    // A concurrent process_kill() may have claimed us already
+    if (!__atomic_exchange_n(&self->exiting, 1, __ATOMIC_ACQ_REL)) {
+        self->exit_code = exit_code;
+    }
+    
+    // scheduler_switch() sees 'exiting' and never queues us again
+    for (;;) {
+        scheduler_yield();
+    }
+}
+
+/**
+ * First code of every task (called by task_start on the new stack)
+ * Finishes the switch that brought us here, then runs the entry
+ * function; returning from it exits the process
+ */
+void process_start(void (*entry)(void))
+{
+    scheduler_finish_switch();
+    enable_interrupts();
+    
+    entry();
+    process_exit(0);
+}
+
+/**
+ * Wait for a child to exit and collect its exit code
+ * pid = PROCESS_WAIT_ANY waits for any child
+ * Returns the child's PID, or -1 if there is no such child
+ */
+int process_wait(uint32_t pid, int* exit_code)
+{
+    process_t* self = get_current_process();
+    if (!self) {
+        return -1;
+    }
+    
+    int result;
+    struct wait_queue* wq = reaper_child_exit_queue();
+    wait_event(wq, (result = reaper_take_child(self, pid, exit_code)) != 0);
+    
+    return result;
+}
+
+/**
+ * Kill a process by PID
+ * Returns 0 on success, -1 if no such process
+ */
+int process_kill_pid(uint32_t pid)
+{
+    rcu_read_lock();
+    process_t* proc = process_find(pid);
+    int self = proc && proc == get_current_process();
+    if (proc && !self) {
+        process_kill(proc);
+    }
+    rcu_read_unlock();
+    
+    // Never leave the CPU inside the read-side section
+    if (self) {
+        process_exit(PROCESS_EXIT_KILLED);
+    }
+    
+    return proc ? 0 : -1;
 }
 
 /**
@@ -258,35 +621,54 @@ void process_kill(process_t* proc)
  */
 process_t* get_current_process(void)
 {
-    return scheduler.current_process;
+    // Interrupts off so we cannot move CPUs between the two reads
+    uint64_t flags = irq_save();
+    process_t* current = this_rq()->current_process;
+    irq_restore(flags);
+    return current;
+}
+
+/**
+ * Check whether any process other than idle is waiting to run
+ */
+int scheduler_has_ready(void)
+{
+    return this_rq()->ready_queue_head != NULL;
 }
 
 /**
- * Pick the next process to run (round-robin)
+ * Pick the next process to run (round-robin, rq->lock held)
+ * Falls back to the idle task when the ready queue is empty
  */
 process_t* scheduler_pick_next(void)
 {
+    scheduler_t* rq = this_rq();
+    process_t* current = rq->current_process;
+    process_t* idle = rq->idle_process;
+    
     // If current process is still running and has time left
-    if (scheduler.current_process != NULL &&
-        scheduler.current_process->state == PROCESS_RUNNING &&
-        scheduler.current_process->time_slice_remaining > 0) {
-        return scheduler.current_process;  // Keep current process
+    // (idle gives way as soon as anything else is ready)
+    if (current != NULL && current != idle &&
+        current->state == PROCESS_RUNNING &&
+        current->time_slice_remaining > 0) {
+        return current;  // Keep current process
     }
     
-    // Current process needs to wait or is done
-    if (scheduler.current_process != NULL) {
-        scheduler.current_process->state = PROCESS_READY;
-        queue_enqueue(scheduler.current_process);
+    // Current process needs to wait or is done (idle is never queued)
+    if (current != NULL && current != idle && current->state == PROCESS_RUNNING) {
+        current->state = PROCESS_READY;
+        rq_enqueue(rq, current);
     }
     
     // Get next ready process
-    process_t* next = queue_dequeue();
+    process_t* next = queue_dequeue(rq);
     
     if (next == NULL) {
-        // No processes ready - this shouldn't happen
-        vga_print("[ERR] No processes ready!", VGA_COLOR_LIGHT_RED);
-        vga_print("\n", VGA_COLOR_WHITE);
-        return NULL;
+        // Nothing runnable - run the idle task
+        if (idle) {
+            idle->state = PROCESS_RUNNING;
+        }
+        return idle;
     }
     
     next->state = PROCESS_RUNNING;
@@ -296,114 +678,667 @@ process_t* scheduler_pick_next(void)
 }
 
 /**
- * Called every timer tick (10ms with PIT @ 100Hz)
+ * Charge elapsed ticks to the running process
+ * (one timer interrupt may stand for several ticks in tickless mode)
  */
-void scheduler_tick(void)
+static void scheduler_account(scheduler_t* rq, uint32_t ticks)
 {
-    scheduler.total_ticks++;
+    process_t* current = rq->current_process;
     
-    if (scheduler.current_process) {
-        scheduler.current_process->total_ticks++;
-        scheduler.current_process->time_slice_remaining--;
+    rq->total_ticks += ticks;
+    if (!current) {
+        return;
+    }
+    
+    current->total_ticks += ticks;
+    
+    // Out of group quota: end the slice, the switch parks it
+    if (current->group && task_group_charge(current, rdtsc())) {
+        current->time_slice_remaining = 0;
+    }
+    
+    if (current == rq->idle_process) {
+        rq->idle_ticks += ticks;
+    } else if (current->time_slice_remaining > ticks) {
+        current->time_slice_remaining -= ticks;
+    } else if (current->time_slice_remaining) {
+        current->time_slice_remaining = 0;
+        trace_sched(TRACE_SLICE_EXPIRED, current->pid, 0);
+    }
+}
+
+/**
+ * Insert a process into the sleep queue (sorted by wake_time)
+ */
+static void sleep_queue_insert(scheduler_t* rq, process_t* proc)
+{
+    process_t* prev = NULL;
+    process_t* it = rq->sleep_queue_head;
+    
+    // Wrap-safe comparison of tick counts
+    while (it && (int32_t)(it->wake_time - proc->wake_time) <= 0) {
+        prev = it;
+        it = it->next;
+    }
+    
+    proc->prev = prev;
+    proc->next = it;
+    if (it) it->prev = proc;
+    if (prev) {
+        prev->next = proc;
+    } else {
+        rq->sleep_queue_head = proc;
+    }
+}
+
+/**
+ * Move every sleeper whose wake time has passed to the ready queue
+ * (wake times are in this CPU's ticks)
+ */
+static void wake_sleepers(scheduler_t* rq)
+{
+    uint32_t now = rq->total_ticks;
+    
+    while (rq->sleep_queue_head &&
+           (int32_t)(rq->sleep_queue_head->wake_time - now) <= 0) {
+        process_t* proc = rq->sleep_queue_head;
+        rq->sleep_queue_head = proc->next;
+        if (rq->sleep_queue_head) {
+            rq->sleep_queue_head->prev = NULL;
+        }
         
-        // Time quantum expired?
-        if (scheduler.current_process->time_slice_remaining == 0) {
-            need_reschedule = 1;
+        proc->state = PROCESS_READY;
+        rq_enqueue_allowed(rq, proc);
+        trace_sched(TRACE_WAKEUP, proc->pid, proc->cpu);
+    }
+}
+
+/**
+ * Program the timer for the next event the scheduler cares about
+ * Called with interrupts disabled after every scheduling decision
+ */
+static void scheduler_program_tick(scheduler_t* rq)
+{
+#if TICK_NOHZ
+    process_t* current = rq->current_process;
+    uint32_t next_event = tick_max_oneshot();
+    
+    // Slice expiry only matters if another process is waiting for the CPU
+    if (current && current != rq->idle_process && rq->ready_queue_head &&
+        current->time_slice_remaining < next_event) {
+        next_event = current->time_slice_remaining;
+    }
+    
+    // Earliest sleeper
+    if (rq->sleep_queue_head) {
+        int32_t delta = (int32_t)(rq->sleep_queue_head->wake_time - rq->total_ticks);
+        if (delta < (int32_t)next_event) {
+            next_event = delta > 0 ? (uint32_t)delta : 1;
         }
     }
+    
+    // RCU callbacks queued here, or a grace period waiting on this CPU
+    if (rcu_needs_tick()) {
+        next_event = 1;
+    }
+    
+    // Quota is checked, and refilled, from the tick
+    if (rq->throttled_head || (current && task_group_limited(current))) {
+        next_event = 1;
+    }
+    
+    // Bottom halves left pending by a switch inside an interrupt
+    // (hrtimer expiry among them) run at the next irq_exit
+    if (this_cpu()->softirq.pending) {
+        next_event = 1;
+    }
+    
+    // Next tick is needed anyway - a periodic tick saves the reprogramming
+    tick_program(next_event);
+#else
+    (void)rq;
+#endif
+}
+
+/**
+ * Bring tick accounting up to date in the middle of a one-shot interval
+ */
+static void scheduler_resync_tick(scheduler_t* rq)
+{
+    uint64_t ticks = tick_cancel_oneshot();
+    if (ticks) {
+        scheduler_account(rq, (uint32_t)ticks);
+        wake_sleepers(rq);
+    }
 }
 
 /**
- * Preemptive context switch handler (called from timer interrupt)
- * Stack pointer points to saved registers on interrupt stack
+ * Re-evaluate the next timer event after the runnable set changed
+ * outside the timer interrupt
  */
-uint64_t preempt_handler(uint64_t stack_ptr)
+void scheduler_kick_tick(void)
 {
-    // Send EOI to PIC first
-    outb(0x20, 0x20);  // Send EOI to master PIC
+#if TICK_NOHZ
+    uint64_t flags = irq_save();
+    scheduler_t* rq = this_rq();
     
-    // Update scheduler tick count
-    scheduler.total_ticks++;
+    // Not started yet - still on the boot-time periodic tick
+    if (rq->current_process) {
+        spin_lock(&rq->lock);
+        scheduler_resync_tick(rq);
+        scheduler_program_tick(rq);
+        spin_unlock(&rq->lock);
+    }
+    
+    irq_restore(flags);
+#endif
+}
 
-    // Every ~2 seconds (@100Hz), print a compact summary line
-    #if DEBUG_SCHED_SUMMARY
-    if ((scheduler.total_ticks % 200) == 0 && scheduler.total_ticks > 0) {
-        // Print total ticks
-        vga_print("\n[SUM T=", VGA_COLOR_LIGHT_CYAN);
-        vga_print_int(scheduler.total_ticks, VGA_COLOR_LIGHT_CYAN);
-        vga_print("] ", VGA_COLOR_LIGHT_CYAN);
-        
-        // Print current process first, if any
-        if (scheduler.current_process) {
-            uint32_t pct = (scheduler.current_process->total_ticks * 100) / scheduler.total_ticks;
-            vga_print(scheduler.current_process->name, VGA_COLOR_BROWN);
-            vga_print(":", VGA_COLOR_BROWN);
-            vga_print_int(scheduler.current_process->total_ticks, VGA_COLOR_BROWN);
-            vga_print(" (", VGA_COLOR_DARK_GREY);
-            vga_print_int(pct, VGA_COLOR_DARK_GREY);
-            vga_print("%)", VGA_COLOR_DARK_GREY);
+/**
+ * Pick the process to run instead of the current one (rq->lock held)
+ * Returns it with the run queue already updated, or NULL to keep running
+ * the current one. The caller drops the lock, then calls
+ * scheduler_context_switch().
+ */
+static process_t* scheduler_switch(scheduler_t* rq)
+{
+    process_t* prev = rq->current_process;
+    
+    // Passing through the scheduler ends any RCU read-side section
+    this_cpu()->need_resched = 0;
+    rcu_note_context_switch();
+    
+    // Only a still-running process goes back on the queue; sleeping or
+    // blocked ones are already on their own list (idle is never queued).
+    // An exiting one goes to the reaper, which waits for on_cpu to clear.
+    // One whose group ran out of quota is parked until the refill.
+    uint64_t now = rdtsc();
+    int throttled = task_group_charge(prev, now);
+    if (prev != rq->idle_process && prev->state == PROCESS_RUNNING) {
+        if (prev->exiting) {
+            prev->state = PROCESS_ZOMBIE;
+            reaper_push(prev);
+        } else if (throttled) {
+            rq_throttle(rq, prev);
+        } else {
+            prev->state = PROCESS_READY;
+            rq_enqueue_allowed(rq, prev);
+        }
+    }
+    
+    // Queued tasks of a group throttled meanwhile are parked as well
+    process_t* next;
+    while ((next = queue_dequeue(rq)) && task_group_throttled(next)) {
+        rq_throttle(rq, next);
+    }
+    if (!next) {
+        next = rq->idle_process;
+    }
+    if (!next) {
+        return NULL;  // No idle task - nothing else we can run
+    }
+    
+    if (next == prev) {
+        // Only runnable process here - keep going with a fresh slice
+        next->state = PROCESS_RUNNING;
+        next->time_slice_remaining = TIME_SLICE_TICKS;
+        return NULL;
+    }
+    
+    // A task pushed here by another CPU may still be leaving that CPU's
+    // stack - wait until its switch has finished
+    while (__atomic_load_n(&next->on_cpu, __ATOMIC_ACQUIRE)) {
+        cpu_relax();
+    }
+    
+    // Save prev's FPU state if it used it; arm the #NM trap for next
+    fpu_switch(prev, next);
+    cputime_switch(rq, prev, next);
+    next->group_mark = now;
+    
+    trace_sched(TRACE_SWITCH_OUT, prev->pid, prev->state);
+    trace_sched(TRACE_SWITCH_IN, next->pid, 0);
+    
+    next->on_cpu = 1;
+    next->state = PROCESS_RUNNING;
+    next->time_slice_remaining = TIME_SLICE_TICKS;
+    rq->current_process = next;
+    rq->prev_process = prev;
+    
+    return next;
+}
+
+/**
+ * Run next in place of prev (interrupts disabled, rq->lock dropped)
+ * Returns once some CPU switches back to prev
+ */
+static void scheduler_context_switch(process_t* prev, process_t* next)
+{
+    cpu_set_kernel_stack((uint64_t)next->kernel_stack_top);
+    switch_to(prev, next);
+    scheduler_finish_switch();
+}
+
+/**
+ * Finish a switch (called on the new task's stack)
+ * Until now the previous task's stack was still in use, so other CPUs
+ * must not run it yet
+ */
+void scheduler_finish_switch(void)
+{
+    scheduler_t* rq = this_rq();
+    
+    if (rq->prev_process) {
+        __atomic_store_n(&rq->prev_process->on_cpu, 0, __ATOMIC_RELEASE);
+        rq->prev_process = NULL;
+    }
+}
+
+/**
+ * Decide whether the running process should give way (rq->lock held)
+ * Idle gives way as soon as anything is ready, others when the slice
+ * expires or they stopped being runnable
+ */
+static int scheduler_switch_needed(scheduler_t* rq)
+{
+    process_t* current = rq->current_process;
+    
+    if (current == rq->idle_process) {
+        return rq->ready_queue_head != NULL;
+    }
+    return current->state != PROCESS_RUNNING || current->exiting ||
+           current->time_slice_remaining == 0;
+}
+
+/**
+ * Ask for a switch away from the interrupted task (interrupt handlers,
+ * rq->lock held). The entry stub makes it on the way out through
+ * preempt_schedule_irq(); inside preempt_disable() it is left to
+ * preempt_enable(). Returns 1 if this interrupt's exit will switch.
+ */
+static int scheduler_request_switch(scheduler_t* rq)
+{
+    cpu_t* cpu = this_cpu();
+    
+    if (scheduler_switch_needed(rq)) {
+        cpu->need_resched = 1;
+    }
+    return cpu->need_resched && preempt_count() == 0;
+}
+
+#if DEBUG_SCHED_SUMMARY
+/**
+ * Print a compact one-line summary of all runnable processes
+ * (bootstrap processor's tasks, idle share of every CPU)
+ * Lock-free: the task list is walked under RCU, task fields are a racy
+ * snapshot. Called from the trace flush task, never from an interrupt.
+ */
+void scheduler_print_summary(void)
+{
+    scheduler_t* rq = &cpu_get(0)->sched;
+    uint32_t total_ticks = rq->total_ticks ? rq->total_ticks : 1;
+    
+    // Print total ticks
+    vga_print("\n[SUM T=", VGA_COLOR_LIGHT_CYAN);
+    vga_print_int(rq->total_ticks, VGA_COLOR_LIGHT_CYAN);
+    vga_print("] ", VGA_COLOR_LIGHT_CYAN);
+    
+    // Killed processes are freed through RCU, so CPU 0's current process
+    // stays valid while we look at it
+    rcu_read_lock();
+    
+    // Print current process first, if any (idle is reported below)
+    process_t* current = rq->current_process;
+    if (current && current != rq->idle_process) {
+        uint32_t pct = (current->total_ticks * 100) / total_ticks;
+        vga_print(current->name, VGA_COLOR_BROWN);
+        vga_print(":", VGA_COLOR_BROWN);
+        vga_print_int(current->total_ticks, VGA_COLOR_BROWN);
+        vga_print(" (", VGA_COLOR_DARK_GREY);
+        vga_print_int(pct, VGA_COLOR_DARK_GREY);
+        vga_print("%)", VGA_COLOR_DARK_GREY);
+        vga_print(" | ", VGA_COLOR_DARK_GREY);
+    }
+    
+    // Walk the task list and print each ready process on CPU 0
+    int first = 1;
+    process_t* it;
+    for_each_process(it, cursor) {
+        if (it->cpu != 0 || it->state != PROCESS_READY) {
+            continue;
+        }
+        uint32_t ipct = (it->total_ticks * 100) / total_ticks;
+        if (!first) {
             vga_print(" | ", VGA_COLOR_DARK_GREY);
         }
+        first = 0;
+        vga_print(it->name, VGA_COLOR_BROWN);
+        vga_print(":", VGA_COLOR_BROWN);
+        vga_print_int(it->total_ticks, VGA_COLOR_BROWN);
+        vga_print(" (", VGA_COLOR_DARK_GREY);
+        vga_print_int(ipct, VGA_COLOR_DARK_GREY);
+        vga_print("%)", VGA_COLOR_DARK_GREY);
+    }
+    rcu_read_unlock();
+    
+    // Idle time is reported on its own so busy percentages stay honest
+    // (one figure per CPU, read without the other CPUs' locks)
+    vga_print(" || idle:", VGA_COLOR_DARK_GREY);
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        scheduler_t* cpu_rq = &cpu_get(i)->sched;
+        uint32_t total = cpu_rq->total_ticks;
+        if (i > 0) {
+            vga_print("/", VGA_COLOR_DARK_GREY);
+        }
+        vga_print_int(total ? (cpu_rq->idle_ticks * 100) / total : 100, VGA_COLOR_DARK_GREY);
+    }
+    vga_print("%", VGA_COLOR_DARK_GREY);
+    vga_print("\n", VGA_COLOR_WHITE);
+}
+#endif
+
+/**
+ * Timer interrupt handler (runs on the IRQ stack, never switches: a
+ * preemption is flagged for preempt_schedule_irq)
+ */
+void preempt_handler(void)
+{
+    scheduler_t* rq = this_rq();
+    uint64_t irq_start = cputime_irq_enter();
+    uint64_t latency = tick_latency_ns();
+    
+    // Acknowledge the tick (PIT or local APIC) and see how much time passed
+    uint64_t ticks = tick_handle_irq();
+    hrtimer_interrupt();
+    trace_sched(TRACE_TICK, rq->current_process ? rq->current_process->pid : 0, ticks);
+    
+    // Periodic rebalance (takes other CPUs' locks, so before our own)
+    balance_tick(rq);
+    
+    // Refill groups whose period ended (also takes other CPUs' locks)
+    task_group_tick();
+    
+    // Quiescent state / grace period bookkeeping (callbacks may take locks)
+    rcu_tick();
+    
+    spin_lock(&rq->lock);
+    
+    // Advance the clock by however many ticks this interrupt covers
+    scheduler_account(rq, (uint32_t)ticks);
+    wake_sleepers(rq);
+    
+    // Nothing to preempt before the scheduler has started. A switch
+    // programs the tick for the next task itself.
+    if (rq->current_process && !scheduler_request_switch(rq)) {
+        scheduler_program_tick(rq);
+    }
+    spin_unlock(&rq->lock);
+    
+    irq_account(this_cpu()->lapic_timer ? LAPIC_TIMER_VECTOR - IRQ_BASE_VECTOR : 0,
+                rdtsc() - irq_start, latency);
+    cputime_irq_exit(irq_start);
+}
+
+/**
+ * Reschedule IPI handler - another CPU queued work for us
+ */
+void resched_handler(void)
+{
+    scheduler_t* rq = this_rq();
+    uint64_t irq_start = cputime_irq_enter();
+    
+    lapic_eoi();
+    
+    // Also sent to tickless idle CPUs that owe RCU a quiescent state
+    rcu_tick();
+    
+    if (rq->current_process) {
+        spin_lock(&rq->lock);
         
-        // Walk ready queue and print each process ticks
-        process_t* it = scheduler.ready_queue_head;
-        while (it) {
-            uint32_t ipct = (it->total_ticks * 100) / scheduler.total_ticks;
-            vga_print(it->name, VGA_COLOR_BROWN);
-            vga_print(":", VGA_COLOR_BROWN);
-            vga_print_int(it->total_ticks, VGA_COLOR_BROWN);
-            vga_print(" (", VGA_COLOR_DARK_GREY);
-            vga_print_int(ipct, VGA_COLOR_DARK_GREY);
-            vga_print("%)", VGA_COLOR_DARK_GREY);
-            if (it->next) {
-                vga_print(" | ", VGA_COLOR_DARK_GREY);
+        // The new arrival may end the current slice early, or need a tick
+        // sooner than the one-shot we programmed
+        scheduler_resync_tick(rq);
+        if (!scheduler_request_switch(rq)) {
+            scheduler_program_tick(rq);
+        }
+        
+        spin_unlock(&rq->lock);
+    }
+    
+    irq_account(LAPIC_RESCHED_VECTOR - IRQ_BASE_VECTOR, rdtsc() - irq_start, 0);
+    cputime_irq_exit(irq_start);
+}
+
+/**
+ * Switch away from an interrupted task whose handler asked for it
+ * Called by the entry stub in isr.asm on its way out, interrupts off,
+ * preempt_count zero, on the task's own stack. The interrupt frame
+ * stays there until the task is resumed.
+ */
+void preempt_schedule_irq(void)
+{
+    scheduler_t* rq = this_rq();
+    process_t* prev = rq->current_process;
+    
+    if (!prev) {
+        this_cpu()->need_resched = 0;
+        return;
+    }
+    
+    spin_lock(&rq->lock);
+    
+    // Any interrupt may get here, in the middle of a one-shot interval
+    scheduler_resync_tick(rq);
+    process_t* next = NULL;
+    if (scheduler_switch_needed(rq)) {
+        next = scheduler_switch(rq);
+    } else {
+        this_cpu()->need_resched = 0;
+    }
+    scheduler_program_tick(rq);
+    
+    spin_unlock(&rq->lock);
+    
+    if (next) {
+        scheduler_context_switch(prev, next);
+    }
+}
+
+/**
+ * Wake a blocked process
+ */
+int scheduler_wake(process_t* proc)
+{
+    uint64_t flags = irq_save();
+    
+    // A waiting process is on no run queue, so its CPU cannot change
+    // under us (it may still be finishing its switch-out there)
+    uint32_t cpu = proc->cpu;
+    scheduler_t* rq = &cpu_get(cpu)->sched;
+    int woken = 0;
+    
+    spin_lock(&rq->lock);
+    if (proc->state == PROCESS_WAITING) {
+        proc->state = PROCESS_READY;
+        proc->wait_queue = NULL;
+        rq_enqueue(rq, proc);
+        trace_sched(TRACE_WAKEUP, proc->pid, cpu);
+        woken = 1;
+    }
+    spin_unlock(&rq->lock);
+    
+    if (woken) {
+        if (cpu == this_cpu()->id) {
+            scheduler_kick_tick();
+        } else if (lapic_available()) {
+            lapic_send_ipi(cpu_get(cpu)->apic_id, LAPIC_RESCHED_VECTOR);
+        }
+    }
+    
+    irq_restore(flags);
+    return woken;
+}
+
+/**
+ * Requeue every task parked for a group that got its quota back
+ * The group was marked unthrottled first: a CPU still parking one of
+ * its tasks holds that rq->lock, so we find the task once we get it
+ */
+void scheduler_unthrottle(struct task_group* group)
+{
+    uint64_t flags = irq_save();
+    uint32_t self = this_cpu()->id;
+    
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        scheduler_t* rq = &cpu_get(i)->sched;
+        uint32_t moved = 0;
+        
+        spin_lock(&rq->lock);
+        process_t* proc = rq->throttled_head;
+        while (proc) {
+            process_t* next = proc->next;
+            if (proc->group == group) {
+                rq_unthrottle(rq, proc);
+                proc->state = PROCESS_READY;
+                rq_enqueue(rq, proc);
+                trace_sched(TRACE_WAKEUP, proc->pid, i);
+                moved++;
             }
-            it = it->next;
+            proc = next;
         }
-        vga_print("\n", VGA_COLOR_WHITE);
+        spin_unlock(&rq->lock);
+        
+        // Our own tick handler reschedules on its way out
+        if (moved && i != self && lapic_available()) {
+            lapic_send_ipi(cpu_get(i)->apic_id, LAPIC_RESCHED_VECTOR);
+        }
+    }
+    
+    irq_restore(flags);
+}
+
+/**
+ * Give up the CPU right away
+ * A plain call into the scheduler: only the callee-saved registers are
+ * saved, no interrupt frame is built
+ */
+void scheduler_yield(void)
+{
+    uint64_t flags = irq_save();
+    scheduler_t* rq = this_rq();
+    process_t* prev = rq->current_process;
+    
+    if (!prev) {
+        irq_restore(flags);
+        return;
     }
-    #endif
     
-    // If no current process, just return same stack
-    if (!scheduler.current_process) {
-        return stack_ptr;
+    spin_lock(&rq->lock);
+    
+    // We may be in the middle of a one-shot interval - charge it first
+    scheduler_resync_tick(rq);
+    
+    process_t* next = scheduler_switch(rq);
+    scheduler_program_tick(rq);
+    
+    spin_unlock(&rq->lock);
+    
+    if (next) {
+        scheduler_context_switch(prev, next);
+    }
+    irq_restore(flags);
+}
+
+/**
+ * Restrict a process to a set of CPUs (bit n = CPU n)
+ * Returns 0 on success, -1 if the mask has no online CPU
+ */
+int process_set_affinity(process_t* proc, uint32_t mask)
+{
+    uint32_t online = (1u << cpu_count()) - 1;
+    if (!proc || !(mask & online)) {
+        return -1;
     }
     
-    // Update process statistics
-    scheduler.current_process->total_ticks++;
-    scheduler.current_process->time_slice_remaining--;
+    uint64_t flags = irq_save();
+    uint32_t self = this_cpu()->id;
+    proc->affinity = mask;
     
-    // Check if time slice expired
-    if (scheduler.current_process->time_slice_remaining <= 0) {
-        // Save current process's stack pointer and state
-        process_t* prev = scheduler.current_process;
-        prev->registers.rsp = stack_ptr;
-        prev->state = PROCESS_READY;
+    if (proc == this_rq()->current_process) {
+        irq_restore(flags);
         
-        // Add back to queue
-        queue_enqueue(prev);
+        // Our own mask - the switch path moves us if we may not stay here
+        if (!(mask & (1u << self))) {
+            scheduler_yield();
+        }
+        return 0;
+    }
+    
+    // A queued process on a CPU it may no longer use moves right away;
+    // running and sleeping ones move the next time they become ready
+    uint32_t owner = proc->cpu;
+    if (!(mask & (1u << owner))) {
+        scheduler_t* rq = &cpu_get(owner)->sched;
+        int dequeued = 0;
         
-        // Pick next process
-        process_t* next = queue_dequeue();
+        spin_lock(&rq->lock);
+        if (proc->state == PROCESS_READY && proc->cpu == owner) {
+            rq_remove(rq, proc);
+            dequeued = 1;
+        }
+        spin_unlock(&rq->lock);
         
-        if (next) {
-            // Switch to next process
-            next->state = PROCESS_RUNNING;
-            next->time_slice_remaining = TIME_SLICE_TICKS;
-            scheduler.current_process = next;
+        if (dequeued) {
+            uint32_t target = 0;
+            while (!(mask & (1u << target))) {
+                target++;
+            }
             
-            // Return next process's stack pointer
-            return next->registers.rsp;
+            scheduler_t* target_rq = &cpu_get(target)->sched;
+            spin_lock(&target_rq->lock);
+            proc->cpu = target;
+            rq_enqueue(target_rq, proc);
+            spin_unlock(&target_rq->lock);
+            balance_kick_cpu(target);
         }
+    }
+    
+    irq_restore(flags);
+    return 0;
+}
+
+/**
+ * Put the current process to sleep for a number of ticks
+ */
+void process_sleep(uint32_t ticks)
+{
+    uint64_t flags = irq_save();
+    scheduler_t* rq = this_rq();
+    process_t* proc = rq->current_process;
+    
+    if (!proc || proc == rq->idle_process) {
+        irq_restore(flags);
+        return;
+    }
+    
+    if (ticks > 0) {
+        spin_lock(&rq->lock);
+        
+        // Make sure "now" is exact before computing the wake time
+        scheduler_resync_tick(rq);
+        proc->wake_time = rq->total_ticks + ticks;
+        proc->state = PROCESS_SLEEPING;
+        sleep_queue_insert(rq, proc);
         
-        // No other process, reset time slice and continue
-        prev->time_slice_remaining = TIME_SLICE_TICKS;
-        prev->state = PROCESS_RUNNING;
-        scheduler.current_process = prev;
+        spin_unlock(&rq->lock);
     }
     
-    // No switch needed - return same stack
-    return stack_ptr;
+    // A sleeping task is off the run queue, so the yield switches away
+    // right here (interrupts stay off until the switch) and returns
+    // once the sleeper has been woken
+    scheduler_yield();
+    
+    irq_restore(flags);
 }
 
 /**
@@ -411,24 +1346,43 @@ uint64_t preempt_handler(uint64_t stack_ptr)
  */
 void scheduler_start(void)
 {
-    // Dequeue first process (removes from queue)
-    process_t* first = queue_dequeue();
+    // Bring up the application processors, then move the bootstrap
+    // processor's tick from the PIT to its local APIC timer as well
+#if BALANCE_BENCH
+    balance_bench_start();
+#endif
+#if SWITCH_BENCH
+    switch_bench_start();
+#endif
+#if GROUP_BENCH
+    group_bench_start();
+#endif
+#if SYSCALL_BENCH
+    syscall_bench_start();
+#endif
+#if IRQ_BENCH
+    irq_bench_start();
+#endif
+#if FPU_BENCH
+    fpu_bench_start();
+#endif
     
-    if (!first) {
-        vga_print("[ERR] No processes to run!", VGA_COLOR_LIGHT_RED);
-        vga_print("\n", VGA_COLOR_WHITE);
-        return;
-    }
+    // Frees exited tasks in batches
+    reaper_start();
     
-    vga_print("[*] Starting first process: ", VGA_COLOR_LIGHT_GREEN);
-    vga_print(first->name, VGA_COLOR_LIGHT_GREEN);
-    vga_print("\n\n", VGA_COLOR_WHITE);
+    // Worker thread for deferred work that may sleep
+    workqueue_init();
     
-    first->state = PROCESS_RUNNING;
-    scheduler.current_process = first;
+#if TRACE_ENABLED || DEBUG_SCHED_SUMMARY
+    // Decodes trace events and prints the summary line in task context
+    trace_start();
+#endif
     
-    // Switch to first process (no current process to save)
-    context_switch_asm(NULL, first);
+    smp_init();
+    tick_use_lapic();
+    tick_use_hpet();
+    
+    scheduler_start_cpu();
     
     // Should never return here
     vga_print("[ERR] Context switch returned!", VGA_COLOR_LIGHT_RED);
@@ -436,51 +1390,290 @@ void scheduler_start(void)
 }
 
 /**
- * Perform a context switch (cooperative - called by processes)
+ * Start running tasks on the executing CPU
  */
-void do_schedule(void)
+void scheduler_start_cpu(void)
 {
-    process_t* current = scheduler.current_process;
+    disable_interrupts();
+    scheduler_t* rq = this_rq();
     
-    // Pick next process to run
-    process_t* next = scheduler_pick_next();
+    spin_lock(&rq->lock);
     
-    if (!next) {
-        return;  // No process to switch to
+    // Dequeue first process (removes from queue), or idle if there is none
+    process_t* first = queue_dequeue(rq);
+    if (!first) {
+        first = rq->idle_process;
     }
     
-    // Don't switch to ourselves
-    if (next == current) {
+    if (!first) {
+        spin_unlock(&rq->lock);
+        enable_interrupts();
+        vga_print("[ERR] No processes to run!", VGA_COLOR_LIGHT_RED);
+        vga_print("\n", VGA_COLOR_WHITE);
         return;
     }
     
-    // Update scheduler state
-    scheduler.current_process = next;
+    while (__atomic_load_n(&first->on_cpu, __ATOMIC_ACQUIRE)) {
+        cpu_relax();
+    }
+    
+    first->on_cpu = 1;
+    first->state = PROCESS_RUNNING;
+    first->time_slice_remaining = TIME_SLICE_TICKS;
+    rq->current_process = first;
+    cputime_start(rq, first);
+    first->group_mark = first->exec_start;
+    scheduler_program_tick(rq);
+    
+    spin_unlock(&rq->lock);
+    
+    if (this_cpu()->id == 0) {
+        vga_print("[*] Starting first process: ", VGA_COLOR_LIGHT_GREEN);
+        vga_print(first->name, VGA_COLOR_LIGHT_GREEN);
+        vga_print("\n\n", VGA_COLOR_WHITE);
+    }
     
-    // Perform context switch: save current, load next
-    context_switch_asm(current, next);
+    // Leave the boot stack for good: its context is saved into a
+    // placeholder nobody switches back to (the task enables interrupts)
+    process_t boot_context;
+    cpu_set_kernel_stack((uint64_t)first->kernel_stack_top);
+    switch_to(&boot_context, first);
 }
 
 /**
- * Print scheduler statistics
+ * Perform a context switch (cooperative - called by processes)
+ * Kept for older callers; the same path as scheduler_yield()
+ */
+void do_schedule(void)
+{
+    scheduler_yield();
+}
+
+/**
+ * Print a cycle count as time (raw kilocycles if uncalibrated)
+ */
+static void print_cycles(uint64_t cycles, vga_color_t color)
+{
+    if (tsc_khz()) {
+        uint64_t us = tsc_cycles_to_us(cycles);
+        if (us >= 10000000) {
+            vga_print_int((int32_t)(us / 1000), color);
+            vga_print(" ms", color);
+        } else {
+            vga_print_int((int32_t)us, color);
+            vga_print(" us", color);
+        }
+    } else {
+        vga_print_int((int32_t)(cycles / 1000), color);
+        vga_print(" kcycles", color);
+    }
+}
+
+/**
+ * Share of elapsed cycles in tenths of a percent
+ */
+static uint32_t cycles_permille(uint64_t part, uint64_t total)
+{
+    if (!total) {
+        return 0;
+    }
+    if (part > total) {
+        part = total;
+    }
+    // Scale down first so part * 1000 cannot overflow
+    while (total > (~0ULL / 1000)) {
+        part >>= 4;
+        total >>= 4;
+    }
+    return (uint32_t)((part * 1000) / total);
+}
+
+static void print_permille(uint32_t permille, vga_color_t color)
+{
+    vga_print_int(permille / 10, color);
+    vga_print(".", color);
+    vga_print_int(permille % 10, color);
+    vga_print("%", color);
+}
+
+/**
+ * Print scheduler statistics (summed over all CPUs)
  */
 void scheduler_print_stats(void)
 {
+    uint32_t total_ticks = 0;
+    uint32_t idle_ticks = 0;
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        total_ticks += cpu_get(i)->sched.total_ticks;
+        idle_ticks += cpu_get(i)->sched.idle_ticks;
+    }
+    process_t* current = get_current_process();
+    
     vga_print("\n[SCHED] Scheduler Statistics:\n", VGA_COLOR_LIGHT_GREEN);
-    vga_print("  Total Ticks: ", VGA_COLOR_LIGHT_GREEN);
-    vga_print_int(scheduler.total_ticks, VGA_COLOR_LIGHT_GREEN);
+    vga_print("  CPUs: ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(cpu_count(), VGA_COLOR_LIGHT_GREEN);
+    vga_print("\n  Total Ticks: ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(total_ticks, VGA_COLOR_LIGHT_GREEN);
+    vga_print("\n  Idle Ticks: ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(idle_ticks, VGA_COLOR_LIGHT_GREEN);
+    
+    // Exact utilization from the TSC: elapsed minus idle cycles
+    uint64_t elapsed = 0;
+    uint64_t idle = 0;
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        elapsed += cputime_elapsed(&cpu_get(i)->sched);
+        idle += cputime_idle(&cpu_get(i)->sched);
+    }
+    vga_print("\n  CPU Utilization: ", VGA_COLOR_LIGHT_GREEN);
+    if (elapsed > 0) {
+        print_permille(cycles_permille(elapsed - (idle < elapsed ? idle : elapsed), elapsed),
+                       VGA_COLOR_LIGHT_GREEN);
+    } else {
+        vga_print("n/a", VGA_COLOR_LIGHT_GREEN);
+    }
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        scheduler_t* cpu_rq = &cpu_get(i)->sched;
+        uint64_t cpu_elapsed = cputime_elapsed(cpu_rq);
+        uint64_t cpu_idle = cputime_idle(cpu_rq);
+        
+        vga_print("\n    CPU", VGA_COLOR_LIGHT_GREEN);
+        vga_print_int(i, VGA_COLOR_LIGHT_GREEN);
+        vga_print(": busy ", VGA_COLOR_LIGHT_GREEN);
+        print_permille(cycles_permille(cpu_elapsed - (cpu_idle < cpu_elapsed ? cpu_idle : cpu_elapsed),
+                                       cpu_elapsed), VGA_COLOR_LIGHT_GREEN);
+        vga_print(", irq ", VGA_COLOR_LIGHT_GREEN);
+        print_permille(cycles_permille(cpu_rq->irq_cycles, cpu_elapsed), VGA_COLOR_LIGHT_GREEN);
+        vga_print(", user ", VGA_COLOR_LIGHT_GREEN);
+        print_permille(cycles_permille(cpu_rq->user_cycles, cpu_elapsed), VGA_COLOR_LIGHT_GREEN);
+        vga_print(", longest run ", VGA_COLOR_LIGHT_GREEN);
+        print_cycles(cpu_rq->max_run_cycles, VGA_COLOR_LIGHT_GREEN);
+        vga_print(" (PID ", VGA_COLOR_LIGHT_GREEN);
+        vga_print_int(cpu_rq->max_run_pid, VGA_COLOR_LIGHT_GREEN);
+        vga_print(")", VGA_COLOR_LIGHT_GREEN);
+    }
     vga_print("\n  Processes: ", VGA_COLOR_LIGHT_GREEN);
-    vga_print_int(scheduler.process_count, VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(pid_count(), VGA_COLOR_LIGHT_GREEN);
     vga_print("\n  Current: ", VGA_COLOR_LIGHT_GREEN);
-    if (scheduler.current_process) {
-        vga_print(scheduler.current_process->name, VGA_COLOR_LIGHT_GREEN);
+    if (current) {
+        vga_print(current->name, VGA_COLOR_LIGHT_GREEN);
         vga_print(" (PID ", VGA_COLOR_LIGHT_GREEN);
-        vga_print_int(scheduler.current_process->pid, VGA_COLOR_LIGHT_GREEN);
+        vga_print_int(current->pid, VGA_COLOR_LIGHT_GREEN);
         vga_print(", CPU ticks: ", VGA_COLOR_LIGHT_GREEN);
-        vga_print_int(scheduler.current_process->total_ticks, VGA_COLOR_LIGHT_GREEN);
+        vga_print_int(current->total_ticks, VGA_COLOR_LIGHT_GREEN);
+        vga_print(", CPU time: ", VGA_COLOR_LIGHT_GREEN);
+        print_cycles(cputime_task_cycles(current), VGA_COLOR_LIGHT_GREEN);
+        vga_print(", irq: ", VGA_COLOR_LIGHT_GREEN);
+        print_cycles(current->irq_cycles, VGA_COLOR_LIGHT_GREEN);
         vga_print(")", VGA_COLOR_LIGHT_GREEN);
     } else {
         vga_print("None", VGA_COLOR_LIGHT_GREEN);
     }
+    
+    // Ready tasks per CPU, counted without taking any run queue lock
+    uint32_t ready[MAX_CPUS] = {0};
+    process_t* it;
+    rcu_read_lock();
+    for_each_process(it, cursor) {
+        if (it->state == PROCESS_READY && it->cpu < MAX_CPUS) {
+            ready[it->cpu]++;
+        }
+    }
+    rcu_read_unlock();
+    vga_print("\n  Ready: ", VGA_COLOR_LIGHT_GREEN);
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        if (i > 0) {
+            vga_print("/", VGA_COLOR_LIGHT_GREEN);
+        }
+        vga_print_int(ready[i], VGA_COLOR_LIGHT_GREEN);
+    }
     vga_print("\n", VGA_COLOR_WHITE);
+    balance_print_stats();
+    rcu_print_stats();
+    reaper_print_stats();
+    softirq_print_stats();
+    irq_print_stats();
+    hrtimer_print_stats();
+    task_group_print_stats();
+    workqueue_print_stats();
+#if SPINLOCK_DEBUG
+    spin_lock_debug_print();
+#endif
+}
+
+#if SWITCH_BENCH
+#define SWITCH_BENCH_WARMUP 1000       // Yields before the clock starts
+#define SWITCH_BENCH_ROUNDS 100000     // Timed yields per side
+
+static volatile uint32_t switch_bench_cpu;
+static volatile uint8_t switch_bench_go = 0;
+static volatile uint32_t switch_bench_pid[2];
+static volatile uint64_t switch_bench_cycles[2];
+
+/**
+ * One side of the ping-pong: both sides are pinned to the same CPU, so
+ * every yield is exactly one switch to the other side
+ */
+static void switch_bench_side(void)
+{
+    while (!__atomic_load_n(&switch_bench_go, __ATOMIC_ACQUIRE) ||
+           this_cpu()->id != switch_bench_cpu) {
+        scheduler_yield();
+    }
+    uint32_t side = get_current_process()->pid == switch_bench_pid[1];
+    
+    for (uint32_t i = 0; i < SWITCH_BENCH_WARMUP; i++) {
+        scheduler_yield();
+    }
+    
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < SWITCH_BENCH_ROUNDS; i++) {
+        scheduler_yield();
+    }
+    switch_bench_cycles[side] = rdtsc() - start;
+}
+
+/**
+ * Coordinator: start both sides, wait for them, report cycles per switch
+ */
+static void switch_bench_main(void)
+{
+    // Last CPU: the bootstrap processor also runs the trace and reaper tasks
+    switch_bench_cpu = cpu_count() - 1;
+    
+    process_t* a = process_create("bench_a", switch_bench_side, DEFAULT_PRIORITY);
+    process_t* b = process_create("bench_b", switch_bench_side, DEFAULT_PRIORITY);
+    if (!a || !b) {
+        vga_print("[BENCH] switch: failed to create tasks\n", VGA_COLOR_LIGHT_RED);
+        return;
+    }
+    switch_bench_pid[0] = a->pid;
+    switch_bench_pid[1] = b->pid;
+    process_set_affinity(a, 1u << switch_bench_cpu);
+    process_set_affinity(b, 1u << switch_bench_cpu);
+    __atomic_store_n(&switch_bench_go, 1, __ATOMIC_RELEASE);
+    
+    process_wait(switch_bench_pid[0], NULL);
+    process_wait(switch_bench_pid[1], NULL);
+    
+    // Each timed yield of one side is a round trip: two switches
+    uint64_t cycles = switch_bench_cycles[0] > switch_bench_cycles[1] ?
+                      switch_bench_cycles[0] : switch_bench_cycles[1];
+    uint64_t per_switch = cycles / (2 * (uint64_t)SWITCH_BENCH_ROUNDS);
+    
+    vga_print("\n[BENCH] switch: ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(SWITCH_BENCH_ROUNDS, VGA_COLOR_LIGHT_GREEN);
+    vga_print(" yield round trips on CPU ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(switch_bench_cpu, VGA_COLOR_LIGHT_GREEN);
+    vga_print(", ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int((int32_t)per_switch, VGA_COLOR_LIGHT_GREEN);
+    vga_print(" cycles per switch\n", VGA_COLOR_LIGHT_GREEN);
+}
+
+/**
+ * Queue the benchmark coordinator
+ */
+static void switch_bench_start(void)
+{
+    process_create("swbench", switch_bench_main, DEFAULT_PRIORITY);
 }
+#endif
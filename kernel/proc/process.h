@@ -3,23 +3,37 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "../sync/spinlock.h"
 
 #define MAX_PROCESSES 256
 #define PROCESS_STACK_SIZE 8192
 #define DEFAULT_PRIORITY 128
 #define TIME_SLICE_TICKS 20
-// Set to 1 to enable periodic scheduler summary prints
+#define IDLE_PID 0
+#define AFFINITY_ALL 0xFFFFFFFF  // Allowed on every CPU (bit n = CPU n)
+#define PROCESS_EXIT_KILLED (-1) // Exit code of a process_kill() victim
+#define PROCESS_WAIT_ANY 0       // process_wait(): any child
+// Set to 1 to enable periodic scheduler summary prints (from the trace flush task)
 #define DEBUG_SCHED_SUMMARY 1
+// Set to 1 to program one-shot timer events instead of a fixed 100 Hz tick
+#define TICK_NOHZ 1
+// Set to 1 to run the yield ping-pong benchmark (cycles per switch) at start
+#define SWITCH_BENCH 0
 
 // Process states
 typedef enum {
     PROCESS_READY = 0,      // Ready to run
     PROCESS_RUNNING = 1,    // Currently running
-    PROCESS_WAITING = 2,    // Waiting for I/O
+    PROCESS_WAITING = 2,    // Blocked on a wait queue
     PROCESS_SLEEPING = 3,   // Sleeping (wake at time)
-    PROCESS_TERMINATED = 4  // Dead (cleanup needed)
+    PROCESS_TERMINATED = 4, // Dead, only the reaper still knows about it
+    PROCESS_ZOMBIE = 5,     // Exited, exit code not collected yet
+    PROCESS_THROTTLED = 6   // Runnable, but its group is out of CPU quota
 } process_state_t;
 
+struct wait_queue;
+struct task_group;
+
 // Task Control Block (TCB)
 typedef struct process_t {
     // Identity
@@ -30,68 +44,161 @@ typedef struct process_t {
     // State machine
     process_state_t state;     // Current state
     
-    // CPU context (saved for context switches)
+    // CPU context: switch_to() pushes the callee-saved registers on the
+    // task's own stack, only the stack pointer is kept here (the offset
+    // reaches the assembly through asm_offsets.inc)
     struct {
-        uint64_t rax, rbx, rcx, rdx;
-        uint64_t rsi, rdi;
-        uint64_t rbp, rsp;
-        uint64_t r8, r9, r10, r11;
-        uint64_t r12, r13, r14, r15;
-        uint64_t rip;          // Return address
-        uint64_t rflags;       // Flags register
-    } registers;
+        uint64_t rsp;          // Saved kernel stack pointer
+    } context;
     
     // Memory management
     uint64_t* page_table;      // Page table base (CR3 value)
     void* kernel_stack;        // Kernel mode stack
     void* kernel_stack_top;    // Top of kernel stack (for interrupts)
-    void* user_stack;          // User mode stack (future)
+    void* user_stack;          // User mode stack (user tasks only, proc/user.h)
+    uint64_t user_entry;       // Ring-3 entry point, 0 for kernel tasks
     
     // Scheduling
     uint32_t priority;         // 0 (low) - 255 (high)
     uint32_t time_slice_remaining;  // Ticks left in current quantum
-    uint32_t total_ticks;      // Total CPU time (ticks)
+    uint32_t total_ticks;      // Ticks charged by the timer (see cputime.h for exact time)
     uint32_t wake_time;        // When to wake from sleep (in ticks)
+    uint32_t cpu;              // CPU whose run queue owns this process
+    uint32_t affinity;         // Bitmask of CPUs allowed to run it
+    volatile uint8_t on_cpu;   // Still running or switching out (stack in use)
+    struct wait_queue* wait_queue;  // Queue it is blocked on (PROCESS_WAITING)
+    
+    // CPU time in TSC cycles (proc/cputime.h)
+    uint64_t exec_start;       // TSC when the current run began
+    uint64_t irq_mark;         // The CPU's irq_cycles at exec_start
+    uint64_t user_mark;        // The CPU's user_cycles at exec_start
+    uint64_t user_cycles;      // Running in user mode
+    uint64_t kernel_cycles;    // Running in kernel mode
+    uint64_t irq_cycles;       // Interrupts and softirqs taken while it ran
+    uint64_t max_run_cycles;   // Longest run without a switch
+    
+    // CPU bandwidth group (proc/group.h), NULL if unlimited
+    struct task_group* group;
+    uint64_t group_mark;       // TSC up to which the group was charged
+    
+    // Extended (FPU/SSE/AVX) state, see arch/x86_64/fpu.h
+    void* fpu_state;           // Save area, allocated on first FPU use
+    uint32_t fpu_cpu;          // CPU that last loaded it (FPU_CPU_NONE if none)
     
     // Linked list pointers
     struct process_t* next;
     struct process_t* prev;
     
+    uint32_t generation;       // PID reuse counter (see pid.h)
+    uint32_t parent_generation; // Parent's generation (parent_pid may be reused)
+    
+    // Exit
+    volatile uint8_t exiting;  // process_exit()/process_kill() claimed it
+    uint8_t exit_reported;     // Off-CPU, stacks freed, parent notified
+    int exit_code;
+    
 } process_t;
 
-// Scheduler state
+// Per-CPU scheduler state (run queue)
 typedef struct {
+    spinlock_t lock;              // Protects the queues below
     process_t* ready_queue_head;  // First ready process
     process_t* ready_queue_tail;  // Last ready process
     process_t* current_process;   // Currently running
-    uint32_t next_pid;            // Next available PID
-    uint32_t process_count;       // Total processes
-    uint32_t total_ticks;         // Total elapsed ticks
+    process_t* idle_process;      // Runs only when the ready queue is empty
+    process_t* sleep_queue_head;  // Sleeping processes, sorted by wake_time
+    process_t* prev_process;      // Switched out, on_cpu cleared after the stack switch
+    uint32_t nr_ready;            // Length of the ready queue
+    uint32_t next_balance;        // total_ticks of the next periodic rebalance
+    uint32_t total_ticks;         // Ticks elapsed on this CPU
+    uint32_t idle_ticks;          // Ticks spent in the idle task
+    
+    // TSC accounting (proc/cputime.h)
+    uint64_t clock_start;         // TSC when this CPU started scheduling
+    uint64_t idle_cycles;         // In the idle task, interrupts excluded
+    uint64_t irq_cycles;          // In interrupt handlers and softirqs
+    uint64_t user_cycles;         // In ring 3 (kernel entry/exit stubs)
+    uint64_t user_entry;          // TSC of the last return to ring 3
+    uint64_t max_run_cycles;      // Longest run of a non-idle task
+    uint32_t max_run_pid;         // ...and whose it was
+    uint32_t irq_depth;           // Nesting of cputime_irq_enter()
+    
+    // Tasks parked until their group's quota is refilled (proc/group.h)
+    process_t* throttled_head;
+    uint32_t nr_throttled;
 } scheduler_t;
 
 // Function declarations
 void scheduler_init(void);
+void scheduler_init_cpu(void);
 process_t* process_create(const char* name, void (*entry)(void), uint32_t priority);
+process_t* process_create_user(const char* name, void (*entry)(void), uint32_t priority);
 void process_kill(process_t* proc);
+int process_kill_pid(uint32_t pid);
+void process_exit(int exit_code) __attribute__((noreturn));
+int process_wait(uint32_t pid, int* exit_code);
 void process_sleep(uint32_t ticks);
 process_t* scheduler_pick_next(void);
-void scheduler_tick(void);
 process_t* get_current_process(void);
+int scheduler_has_ready(void);
+int process_set_affinity(process_t* proc, uint32_t mask);
 void scheduler_print_stats(void);
 
-// Assembly function for context switching
-extern void context_switch_asm(process_t* current, process_t* next);
+#if DEBUG_SCHED_SUMMARY
+// One-line summary of CPU 0's tasks and every CPU's idle share
+void scheduler_print_summary(void);
+#endif
+
+// Save prev's callee-saved registers and stack pointer, resume next
+// (interrupts disabled, no locks held). Returns the task that switched
+// back to prev. Implemented in context_switch.asm.
+extern process_t* switch_to(process_t* prev, process_t* next);
+
+// First code a new task runs (context_switch.asm, calls process_start)
+extern void task_start(void);
 
-// Preemptive context switch from interrupt (returns new stack pointer)
-uint64_t preempt_handler(uint64_t stack_ptr);
+// Timer interrupt: account the tick, flag a preemption if one is due
+void preempt_handler(void);
 
-// Reschedule flag (set by timer)
-extern volatile uint8_t need_reschedule;
+// Reschedule IPI from another CPU (flags a preemption if one is due)
+void resched_handler(void);
 
-// Trigger a context switch
+// Make the switch the handlers flagged (isr.asm, on the way out of an
+// interrupt, interrupts off and preempt_count zero)
+void preempt_schedule_irq(void);
+
+// New task entry, called by task_start (never returns)
+void process_start(void (*entry)(void)) __attribute__((noreturn));
+
+// Make a PROCESS_WAITING process runnable again on its CPU
+// Returns 1 if it was waiting, 0 otherwise
+int scheduler_wake(process_t* proc);
+
+// Re-evaluate the next timer event after the runnable set (or the
+// earliest timer) changed outside the timer interrupt
+void scheduler_kick_tick(void);
+
+// Give up the CPU right away
+void scheduler_yield(void);
+
+// Called on the new stack after switch_to() returns
+void scheduler_finish_switch(void);
+
+// Ready queue manipulation for the load balancer (rq->lock held)
+void rq_enqueue(scheduler_t* rq, process_t* proc);
+void rq_remove(scheduler_t* rq, process_t* proc);
+
+// Put a refilled group's parked tasks back on their run queues
+// (no run queue lock held)
+void scheduler_unthrottle(struct task_group* group);
+
+// Trigger a context switch (same as scheduler_yield)
 void do_schedule(void);
 
 // Start first process (called by kernel_main)
 void scheduler_start(void);
 
+// Start running tasks on the executing CPU (never returns)
+void scheduler_start_cpu(void);
+
 #endif // KERNEL_PROC_PROCESS_H
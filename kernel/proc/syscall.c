@@ -0,0 +1,225 @@
+#include "syscall.h"
+#include "process.h"
+#include "user.h"
+#include "../arch/x86_64/cpu.h"
+#include "../arch/x86_64/idt.h"
+#include "../mm/paging.h"
+#include "../time/ktime.h"
+#include "../time/hrtimer.h"
+#include "../time/tsc.h"
+#include "../time/vtime.h"
+#include "../../drivers/vga.h"
+
+// Entry stubs (syscall_entry.asm)
+extern void syscall_entry(void);
+extern void syscall_int80_entry(void);
+
+/**
+ * Check a user buffer: canonical lower half, no wrap-around, and mapped
+ * for user access all the way (writable if the kernel writes to it)
+ */
+int syscall_user_ok(uint64_t ptr, uint64_t len, int write)
+{
+    if (len == 0) {
+        return 1;
+    }
+    if (ptr + len < ptr || ptr + len > USER_SPACE_END) {
+        return 0;
+    }
+    return paging_user_range_ok(ptr, len, write);
+}
+
+static int64_t sys_null(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    (void)a0; (void)a1; (void)a2; (void)a3; (void)a4; (void)a5;
+    return 0;
+}
+
+static int64_t sys_getpid(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    (void)a0; (void)a1; (void)a2; (void)a3; (void)a4; (void)a5;
+    return get_current_process()->pid;
+}
+
+static int64_t sys_yield(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    (void)a0; (void)a1; (void)a2; (void)a3; (void)a4; (void)a5;
+    scheduler_yield();
+    return 0;
+}
+
+static int64_t sys_sleep_ns(uint64_t ns, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    (void)a1; (void)a2; (void)a3; (void)a4; (void)a5;
+    hrtimer_nanosleep(ns);
+    return 0;
+}
+
+static int64_t sys_clock_ns(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    (void)a0; (void)a1; (void)a2; (void)a3; (void)a4; (void)a5;
+    return (int64_t)ktime_get_ns();
+}
+
+/**
+ * Print a user buffer, copied through a bounce buffer so the console
+ * only ever sees NUL-terminated kernel memory
+ */
+static int64_t sys_write(uint64_t buf, uint64_t len, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    (void)a2; (void)a3; (void)a4; (void)a5;
+    
+    if (len > SYSCALL_WRITE_MAX) {
+        return -SYSCALL_EINVAL;
+    }
+    if (!syscall_user_ok(buf, len, 0)) {
+        return -SYSCALL_EFAULT;
+    }
+    
+    const char* src = (const char*)buf;
+    char chunk[128];
+    uint64_t done = 0;
+    while (done < len) {
+        uint64_t n = len - done < sizeof(chunk) - 1 ? len - done : sizeof(chunk) - 1;
+        for (uint64_t i = 0; i < n; i++) {
+            chunk[i] = src[done + i];
+        }
+        chunk[n] = '\0';
+        vga_print(chunk, VGA_COLOR_WHITE);
+        done += n;
+    }
+    return (int64_t)len;
+}
+
+static int64_t sys_exit(uint64_t code, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    (void)a1; (void)a2; (void)a3; (void)a4; (void)a5;
+    process_exit((int)code);
+}
+
+const syscall_fn_t syscall_table[SYS_COUNT] = {
+    [SYS_NULL] = sys_null,
+    [SYS_GETPID] = sys_getpid,
+    [SYS_YIELD] = sys_yield,
+    [SYS_SLEEP_NS] = sys_sleep_ns,
+    [SYS_CLOCK_NS] = sys_clock_ns,
+    [SYS_WRITE] = sys_write,
+    [SYS_EXIT] = sys_exit,
+};
+
+/**
+ * Install the int 0x80 gate
+ * DPL 3 so user code may raise it; an interrupt gate, so the stub
+ * runs with interrupts off until it has sorted out GS
+ */
+void syscall_init(void)
+{
+    idt_set_gate(SYSCALL_INT_VECTOR, (uint64_t)syscall_int80_entry, GDT_KERNEL_CODE, 0xEE);
+    syscall_init_cpu();
+    
+    vga_print("[SYSCALL] ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(SYS_COUNT, VGA_COLOR_LIGHT_CYAN);
+    vga_print(" system calls, SYSCALL/SYSRET and int 0x80\n", VGA_COLOR_LIGHT_GREEN);
+}
+
+/**
+ * Point SYSCALL at the entry stub on this CPU
+ */
+void syscall_init_cpu(void)
+{
+    wrmsr(MSR_EFER, rdmsr(MSR_EFER) | EFER_SCE);
+    
+    // SYSCALL: CS = 0x08, SS = 0x10. SYSRET: SS = 0x18|3, CS = 0x20|3.
+    wrmsr(MSR_STAR, ((uint64_t)(GDT_KERNEL_DATA | GDT_RPL_USER) << 48) |
+                    ((uint64_t)GDT_KERNEL_CODE << 32));
+    wrmsr(MSR_LSTAR, (uint64_t)syscall_entry);
+    
+    // Entered with interrupts off until the stack is switched, and with
+    // a clean direction flag as the C code expects
+    wrmsr(MSR_SFMASK, RFLAGS_IF | RFLAGS_TF | RFLAGS_DF | RFLAGS_NT | RFLAGS_AC);
+    
+    // The user's GS base while running in the kernel (swapgs partner)
+    wrmsr(MSR_KERNEL_GS_BASE, 0);
+}
+
+#if SYSCALL_BENCH
+#define SYSCALL_BENCH_CALLS 100000
+
+// Cycles per call measured by the ring-3 half: SYSCALL, int 0x80, and
+// a clock read from the time page
+static USER_DATA volatile uint64_t bench_user_cycles[3];
+
+/**
+ * Ring-3 half: the same null call through both entries
+ */
+USER_TEXT static void syscall_bench_user(void)
+{
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < SYSCALL_BENCH_CALLS; i++) {
+        syscall0(SYS_NULL);
+    }
+    bench_user_cycles[0] = (rdtsc() - start) / SYSCALL_BENCH_CALLS;
+    
+    start = rdtsc();
+    for (uint32_t i = 0; i < SYSCALL_BENCH_CALLS; i++) {
+        syscall_int0(SYS_NULL);
+    }
+    bench_user_cycles[1] = (rdtsc() - start) / SYSCALL_BENCH_CALLS;
+    
+    start = rdtsc();
+    for (uint32_t i = 0; i < SYSCALL_BENCH_CALLS; i++) {
+        vtime_get_ns();
+    }
+    bench_user_cycles[2] = (rdtsc() - start) / SYSCALL_BENCH_CALLS;
+}
+
+/**
+ * Cycles per null call through the int 0x80 gate from ring 0, against
+ * a plain indirect call of the same handler; then both entries from a
+ * user task (SYSRET only returns to ring 3)
+ */
+static void syscall_bench(void)
+{
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < SYSCALL_BENCH_CALLS; i++) {
+        syscall_int0(SYS_NULL);
+    }
+    uint64_t gate = rdtsc() - start;
+    
+    volatile syscall_fn_t fn = syscall_table[SYS_NULL];
+    start = rdtsc();
+    for (uint32_t i = 0; i < SYSCALL_BENCH_CALLS; i++) {
+        fn(0, 0, 0, 0, 0, 0);
+    }
+    uint64_t direct = rdtsc() - start;
+    
+    vga_print("[SYSCALL] bench: ring 0 int 0x80 ", VGA_COLOR_LIGHT_CYAN);
+    vga_print_int((int32_t)(gate / SYSCALL_BENCH_CALLS), VGA_COLOR_LIGHT_CYAN);
+    vga_print(" cycles, direct call ", VGA_COLOR_LIGHT_CYAN);
+    vga_print_int((int32_t)(direct / SYSCALL_BENCH_CALLS), VGA_COLOR_LIGHT_CYAN);
+    vga_print(" cycles\n", VGA_COLOR_LIGHT_CYAN);
+    
+    process_t* user = process_create_user("sys_ubench", syscall_bench_user, DEFAULT_PRIORITY);
+    int code;
+    if (!user || process_wait(user->pid, &code) <= 0 || code != 0) {
+        vga_print("[SYSCALL] bench: user task failed\n", VGA_COLOR_LIGHT_RED);
+        return;
+    }
+    
+    vga_print("[SYSCALL] bench: ring 3 SYSCALL ", VGA_COLOR_LIGHT_CYAN);
+    vga_print_int((int32_t)bench_user_cycles[0], VGA_COLOR_LIGHT_CYAN);
+    vga_print(" cycles, int 0x80 ", VGA_COLOR_LIGHT_CYAN);
+    vga_print_int((int32_t)bench_user_cycles[1], VGA_COLOR_LIGHT_CYAN);
+    vga_print(" cycles, time page read ", VGA_COLOR_LIGHT_CYAN);
+    vga_print_int((int32_t)bench_user_cycles[2], VGA_COLOR_LIGHT_CYAN);
+    vga_print(" cycles\n", VGA_COLOR_LIGHT_CYAN);
+}
+
+/**
+ * Run the benchmark in its own task
+ */
+void syscall_bench_start(void)
+{
+    process_create("sys_bench", syscall_bench, DEFAULT_PRIORITY);
+}
+#endif
@@ -0,0 +1,88 @@
+#ifndef KERNEL_PROC_SYSCALL_H
+#define KERNEL_PROC_SYSCALL_H
+
+#include <stdint.h>
+
+// System calls. User code enters through SYSCALL (the fast path: no
+// interrupt frame, no IDT lookup) or through the int 0x80 gate, which
+// is kept for comparison and for callers without SYSCALL. Both take the
+// number in RAX and up to six arguments in RDI, RSI, RDX, R10, R8, R9;
+// the result comes back in RAX, negative on error. Every register but
+// RAX survives the call (SYSCALL itself clobbers RCX and R11).
+
+// Set to 1 to measure the cost of a null system call at scheduler start
+#define SYSCALL_BENCH 0
+
+// Vector of the software-interrupt gate
+#define SYSCALL_INT_VECTOR 0x80
+
+// System call numbers
+#define SYS_NULL      0        // Does nothing (entry/exit cost)
+#define SYS_GETPID    1
+#define SYS_YIELD     2
+#define SYS_SLEEP_NS  3        // (ns)
+#define SYS_CLOCK_NS  4        // Monotonic ktime in nanoseconds
+#define SYS_WRITE     5        // (buf, len) to the console
+#define SYS_EXIT      6        // (code), does not return
+#define SYS_COUNT     7
+
+// Error codes (returned negated)
+#define SYSCALL_EFAULT 14      // Bad user pointer
+#define SYSCALL_EINVAL 22      // Bad argument
+#define SYSCALL_ENOSYS 38      // No such system call
+
+// End of the user half of the address space; SYSRET to an address
+// above USER_RIP_MAX would fault in ring 0 on some CPUs
+#define USER_SPACE_END 0x0000800000000000ULL
+#define USER_RIP_MAX   0x00007FFFFFFFF000ULL
+
+// Longest SYS_WRITE
+#define SYSCALL_WRITE_MAX 4096
+
+typedef int64_t (*syscall_fn_t)(uint64_t a0, uint64_t a1, uint64_t a2,
+                                uint64_t a3, uint64_t a4, uint64_t a5);
+
+// Indexed by number from the entry stubs (bounds checked there)
+extern const syscall_fn_t syscall_table[SYS_COUNT];
+
+// Install the int 0x80 gate (once, before the first task runs)
+void syscall_init(void);
+
+// Enable SYSCALL/SYSRET on the executing CPU (every CPU)
+void syscall_init_cpu(void);
+
+// Check a user buffer before the kernel touches it
+int syscall_user_ok(uint64_t ptr, uint64_t len, int write);
+
+// Issue a system call through either entry (for the benchmark and for
+// ring-3 code built into the kernel image)
+static inline int64_t syscall0(uint64_t nr) {
+    int64_t ret;
+    __asm__ volatile("syscall" : "=a"(ret) : "a"(nr) : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline int64_t syscall1(uint64_t nr, uint64_t a0) {
+    int64_t ret;
+    __asm__ volatile("syscall" : "=a"(ret) : "a"(nr), "D"(a0) : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline int64_t syscall2(uint64_t nr, uint64_t a0, uint64_t a1) {
+    int64_t ret;
+    __asm__ volatile("syscall" : "=a"(ret) : "a"(nr), "D"(a0), "S"(a1) : "rcx", "r11", "memory");
+    return ret;
+}
+
+static inline int64_t syscall_int0(uint64_t nr) {
+    int64_t ret;
+    __asm__ volatile("int $0x80" : "=a"(ret) : "a"(nr) : "memory");
+    return ret;
+}
+
+#if SYSCALL_BENCH
+// Time null system calls from ring 0 and ring 3
+void syscall_bench_start(void);
+#endif
+
+#endif // KERNEL_PROC_SYSCALL_H
@@ -0,0 +1,213 @@
+#include "trace.h"
+#include "process.h"
+#include "../arch/x86_64/cpu.h"
+#include "../arch/x86_64/percpu.h"
+#include "../arch/x86_64/interrupts.h"
+#include "../mm/kheap.h"
+#include "../sync/spinlock.h"
+#include "../../drivers/serial.h"
+#include "../../drivers/vga.h"
+
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+
+// Per-CPU event ring. The owning CPU is the only producer (interrupts
+// off while it writes a slot), the flush task the only consumer, so head
+// and tail need no lock - just release/acquire ordering.
+typedef struct {
+    trace_event_t* events;
+    volatile uint32_t head;     // Next slot to write (producer)
+    volatile uint32_t tail;     // Next slot to read (consumer)
+    volatile uint32_t dropped;  // Events lost to a full ring
+} trace_ring_t;
+
+static trace_ring_t trace_rings[MAX_CPUS];
+static spinlock_t trace_flush_lock = SPINLOCK_INIT_NAMED("trace_flush");
+
+static const char* const trace_names[] = {
+    "?", "out", "in", "wake", "tick", "expire", "throttle"
+};
+
+/**
+ * Allocate the ring of the executing CPU
+ */
+void trace_init_cpu(void)
+{
+    trace_ring_t* ring = &trace_rings[this_cpu()->id];
+    
+    if (!ring->events) {
+        ring->events = (trace_event_t*)kmalloc(TRACE_RING_SIZE * sizeof(trace_event_t));
+    }
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+}
+
+/**
+ * Append an event to the executing CPU's ring
+ */
+void trace_record(uint16_t type, uint32_t pid, uint16_t arg)
+{
+    uint64_t flags = irq_save();
+    trace_ring_t* ring = &trace_rings[this_cpu()->id];
+    
+    if (ring->events) {
+        uint32_t head = ring->head;
+        if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= TRACE_RING_SIZE) {
+            __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        } else {
+            trace_event_t* ev = &ring->events[head & TRACE_RING_MASK];
+            ev->tsc = rdtsc();
+            ev->pid = pid;
+            ev->type = type;
+            ev->arg = arg;
+            __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+        }
+    }
+    
+    irq_restore(flags);
+}
+
+// Line building helpers (no printf in the kernel)
+static uint32_t trace_put_str(char* buf, uint32_t pos, const char* str)
+{
+    while (*str) {
+        buf[pos++] = *str++;
+    }
+    return pos;
+}
+
+static uint32_t trace_put_dec(char* buf, uint32_t pos, uint64_t value)
+{
+    char digits[20];
+    int count = 0;
+    
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    
+    while (count > 0) {
+        buf[pos++] = digits[--count];
+    }
+    return pos;
+}
+
+/**
+ * Write one decoded event: "T <cpu> <tsc> <event> <pid> <arg>"
+ * The format is stable so serial logs can be sorted by TSC offline
+ */
+static void trace_emit(uint32_t cpu, const trace_event_t* ev)
+{
+    char line[80];
+    uint32_t pos = 0;
+    uint16_t type = ev->type < sizeof(trace_names) / sizeof(trace_names[0]) ? ev->type : 0;
+    
+    pos = trace_put_str(line, pos, "T ");
+    pos = trace_put_dec(line, pos, cpu);
+    line[pos++] = ' ';
+    pos = trace_put_dec(line, pos, ev->tsc);
+    line[pos++] = ' ';
+    pos = trace_put_str(line, pos, trace_names[type]);
+    line[pos++] = ' ';
+    pos = trace_put_dec(line, pos, ev->pid);
+    line[pos++] = ' ';
+    pos = trace_put_dec(line, pos, ev->arg);
+    line[pos++] = '\n';
+    line[pos] = '\0';
+    
+    serial_print(line);
+#if TRACE_VGA_EVENTS
+    vga_print(line, VGA_COLOR_DARK_GREY);
+#endif
+}
+
+/**
+ * Report events lost to a full ring: "D <cpu> <count>"
+ */
+static void trace_emit_dropped(uint32_t cpu, uint32_t count)
+{
+    char line[40];
+    uint32_t pos = 0;
+    
+    pos = trace_put_str(line, pos, "D ");
+    pos = trace_put_dec(line, pos, cpu);
+    line[pos++] = ' ';
+    pos = trace_put_dec(line, pos, count);
+    line[pos++] = '\n';
+    line[pos] = '\0';
+    
+    serial_print(line);
+}
+
+/**
+ * Drain every CPU's ring
+ */
+void trace_flush(void)
+{
+    // Rings have a single consumer - let a concurrent flush do the work
+    if (!spin_trylock(&trace_flush_lock)) {
+        return;
+    }
+    
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        trace_ring_t* ring = &trace_rings[i];
+        if (!ring->events) {
+            continue;
+        }
+        
+        uint32_t tail = ring->tail;
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        while (tail != head) {
+            // Copy the slot out before handing it back to the producer
+            trace_event_t ev = ring->events[tail & TRACE_RING_MASK];
+            tail++;
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+            trace_emit(i, &ev);
+        }
+        
+        uint32_t dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+        if (dropped) {
+            trace_emit_dropped(i, dropped);
+        }
+    }
+    
+    spin_unlock(&trace_flush_lock);
+}
+
+/**
+ * Flush task - decodes trace events and prints the scheduler summary
+ * outside of interrupt context
+ */
+static void trace_flush_task(void)
+{
+#if DEBUG_SCHED_SUMMARY
+    uint32_t rounds = 0;
+#endif
+    
+    serial_print("# trace: T <cpu> <tsc> <out|in|wake|tick|expire|throttle> <pid> <arg>\n");
+    
+    for (;;) {
+        trace_flush();
+        
+        // Every ~2 seconds (@100Hz), print a compact summary line
+#if DEBUG_SCHED_SUMMARY
+        if (++rounds % (200 / TRACE_FLUSH_INTERVAL_TICKS) == 0) {
+            scheduler_print_summary();
+        }
+#endif
+        
+        process_sleep(TRACE_FLUSH_INTERVAL_TICKS);
+    }
+}
+
+/**
+ * Spawn the flush task (serial port is set up here if nobody did yet)
+ */
+void trace_start(void)
+{
+    if (!serial_ready()) {
+        serial_init();
+    }
+    
+    process_create("trace", trace_flush_task, DEFAULT_PRIORITY);
+}
@@ -0,0 +1,51 @@
+#ifndef KERNEL_PROC_TRACE_H
+#define KERNEL_PROC_TRACE_H
+
+#include <stdint.h>
+
+// Set to 0 to compile every trace point out
+#define TRACE_ENABLED 1
+// Events buffered per CPU (power of two); new events are dropped when full
+#define TRACE_RING_SIZE 512
+// How often the flush task drains the rings (ticks)
+#define TRACE_FLUSH_INTERVAL_TICKS 20
+// Set to 1 to also decode every event on screen (serial always gets them)
+#define TRACE_VGA_EVENTS 0
+
+// Scheduler event types
+typedef enum {
+    TRACE_SWITCH_OUT = 1,      // pid left the CPU, arg = its new state
+    TRACE_SWITCH_IN = 2,       // pid got the CPU
+    TRACE_WAKEUP = 3,          // pid became runnable, arg = target CPU
+    TRACE_TICK = 4,            // Timer interrupt, pid = current, arg = ticks
+    TRACE_SLICE_EXPIRED = 5,   // pid used up its time slice
+    TRACE_THROTTLE = 6         // pid parked, its group is out of quota
+} trace_event_type_t;
+
+// Binary event record (16 bytes)
+typedef struct {
+    uint64_t tsc;
+    uint32_t pid;
+    uint16_t type;
+    uint16_t arg;
+} trace_event_t;
+
+// Set up the ring of the executing CPU
+void trace_init_cpu(void);
+
+// Append an event to the executing CPU's ring (any context, lock-free)
+void trace_record(uint16_t type, uint32_t pid, uint16_t arg);
+
+// Drain every ring and decode the events (one flusher at a time)
+void trace_flush(void);
+
+// Spawn the low-priority flush task
+void trace_start(void);
+
+#if TRACE_ENABLED
+#define trace_sched(type, pid, arg) trace_record((type), (pid), (uint16_t)(arg))
+#else
+#define trace_sched(type, pid, arg) ((void)0)
+#endif
+
+#endif // KERNEL_PROC_TRACE_H
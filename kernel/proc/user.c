@@ -0,0 +1,115 @@
+#include "user.h"
+#include "syscall.h"
+#include "../mm/kheap.h"
+#include "../mm/paging.h"
+#include "../mm/pmm.h"
+#include "../sync/spinlock.h"
+#include "../../drivers/vga.h"
+
+// Bounds of the .user section (scripts/linker.ld)
+extern uint8_t user_start[];
+extern uint8_t user_end[];
+
+// Recycled user stacks, linked through their first word
+static spinlock_t user_stack_lock = SPINLOCK_INIT_NAMED("user_stack");
+static void* user_stack_pool = NULL;
+
+// Also serializes paging_grant_user(), which may split page tables
+static spinlock_t user_map_lock = SPINLOCK_INIT_NAMED("user_map");
+
+/**
+ * Where user tasks go when their entry function returns
+ */
+USER_TEXT static void user_return(void)
+{
+    syscall1(SYS_EXIT, 0);
+}
+
+/**
+ * Open the .user section to ring 3
+ * Writable as a whole: USER_DATA shares it with the code
+ */
+void user_init(void)
+{
+    uint64_t size = (uint64_t)(user_end - user_start);
+    
+    uint64_t flags = spin_lock_irqsave(&user_map_lock);
+    int err = paging_grant_user((uint64_t)user_start, size, 1);
+    spin_unlock_irqrestore(&user_map_lock, flags);
+    
+    if (err) {
+        vga_print("[USER] Could not map the user section\n", VGA_COLOR_LIGHT_RED);
+        return;
+    }
+    
+    vga_print("[USER] ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int((int32_t)(size / PAGE_SIZE), VGA_COLOR_LIGHT_CYAN);
+    vga_print(" user pages\n", VGA_COLOR_LIGHT_GREEN);
+}
+
+int user_code_ok(void (*entry)(void))
+{
+    uint8_t* addr = (uint8_t*)entry;
+    return addr >= user_start && addr < user_end;
+}
+
+/**
+ * Get a user stack from the pool, or carve a page-aligned one out of
+ * the kernel heap and open it to ring 3
+ */
+void* user_stack_alloc(void)
+{
+    uint64_t flags = spin_lock_irqsave(&user_stack_lock);
+    void* stack = user_stack_pool;
+    if (stack) {
+        user_stack_pool = *(void**)stack;
+    }
+    spin_unlock_irqrestore(&user_stack_lock, flags);
+    
+    if (!stack) {
+        // Never freed, so the unaligned start can be dropped
+        uint8_t* raw = (uint8_t*)kmalloc(USER_STACK_SIZE + PAGE_SIZE);
+        if (!raw) {
+            return NULL;
+        }
+        stack = (void*)(((uint64_t)raw + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1));
+        
+        flags = spin_lock_irqsave(&user_map_lock);
+        int err = paging_grant_user((uint64_t)stack, USER_STACK_SIZE, 1);
+        spin_unlock_irqrestore(&user_map_lock, flags);
+        if (err) {
+            kfree(raw);
+            return NULL;
+        }
+    }
+    
+    // Nothing of the previous owner is left for the next
+    uint64_t* words = (uint64_t*)stack;
+    for (uint32_t i = 0; i < USER_STACK_SIZE / sizeof(uint64_t); i++) {
+        words[i] = 0;
+    }
+    return stack;
+}
+
+void user_stack_free(void* stack)
+{
+    uint64_t flags = spin_lock_irqsave(&user_stack_lock);
+    *(void**)stack = user_stack_pool;
+    user_stack_pool = stack;
+    spin_unlock_irqrestore(&user_stack_lock, flags);
+}
+
+/**
+ * First kernel code of a user task (called through process_start)
+ * The entry function "returns" into user_return, which exits
+ */
+void user_task_main(void)
+{
+    process_t* self = get_current_process();
+    uint64_t* sp = (uint64_t*)((uint8_t*)self->user_stack + USER_STACK_SIZE);
+    
+    // As if called: RSP + 8 is 16-byte aligned at the first instruction
+    *--sp = (uint64_t)user_return;
+    
+    user_enter(self->user_entry, (uint64_t)sp);
+}
@@ -0,0 +1,44 @@
+#ifndef KERNEL_PROC_USER_H
+#define KERNEL_PROC_USER_H
+
+#include <stdint.h>
+#include "process.h"
+
+// Ring-3 tasks.
+//
+// There is no program loader and no per-process address space yet: user
+// programs are functions built into the kernel image, placed in the
+// .user section (scripts/linker.ld). Those pages and each user task's
+// stack are the only memory ring 3 can touch. Code marked USER_TEXT may
+// only use USER_RODATA/USER_DATA objects and the inline syscall helpers
+// (syscall.h): string literals land in the kernel's .rodata and calls
+// into kernel functions fault.
+
+#define USER_TEXT   __attribute__((section(".user.text"), noinline))
+#define USER_RODATA __attribute__((section(".user.rodata")))
+#define USER_DATA   __attribute__((section(".user.data")))
+
+// Stack of a user task (page-aligned, whole pages)
+#define USER_STACK_SIZE PROCESS_STACK_SIZE
+
+// Open the .user section to ring 3 (once, before the first user task)
+void user_init(void);
+
+// Check that a user task entry point lies in the .user section
+int user_code_ok(void (*entry)(void));
+
+// Allocate a user-accessible stack / give it back. Stacks are recycled
+// rather than freed, so no page ever goes back to the kernel heap while
+// another CPU might still have it cached as user-accessible.
+void* user_stack_alloc(void);
+void user_stack_free(void* stack);
+
+// Kernel-side entry of every user task: drops to ring 3 at
+// proc->user_entry on its user stack (never returns)
+void user_task_main(void);
+
+// Return to ring 3 at rip with stack rsp, interrupts on and no kernel
+// register contents (syscall_entry.asm)
+extern void user_enter(uint64_t rip, uint64_t rsp) __attribute__((noreturn));
+
+#endif // KERNEL_PROC_USER_H
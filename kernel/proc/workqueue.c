@@ -0,0 +1,129 @@
+#include "workqueue.h"
+#include "../../drivers/vga.h"
+
+static workqueue_t workqueues[WORKQUEUE_MAX];
+static uint32_t workqueue_count = 0;
+static spinlock_t workqueue_lock = SPINLOCK_INIT_NAMED("workqueue");
+
+// Shared queue for drivers that do not need their own thread
+static workqueue_t* system_wq = NULL;
+
+/**
+ * Worker thread body
+ * Workers carry no argument: each adopts the first queue that has no
+ * worker yet (all workers are identical, so any pairing works)
+ */
+static void worker_main(void)
+{
+    process_t* self = get_current_process();
+    workqueue_t* wq = NULL;
+
+    uint64_t flags = spin_lock_irqsave(&workqueue_lock);
+    for (uint32_t i = 0; i < workqueue_count; i++) {
+        if (!workqueues[i].worker) {
+            wq = &workqueues[i];
+            wq->worker = self;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&workqueue_lock, flags);
+
+    if (!wq) {
+        return;
+    }
+
+    for (;;) {
+        wait_event(&wq->wait, wq->head != NULL);
+
+        flags = spin_lock_irqsave(&wq->wait.lock);
+        work_t* work = wq->head;
+        wq->head = work->next;
+        if (!wq->head) {
+            wq->tail = NULL;
+        }
+        // Cleared before it runs, so the function may queue itself again
+        work->pending = 0;
+        spin_unlock_irqrestore(&wq->wait.lock, flags);
+
+        work->func(work);
+        wq->executed++;
+    }
+}
+
+/**
+ * Create a workqueue with its own worker thread
+ */
+workqueue_t* workqueue_create(const char* name)
+{
+    uint64_t flags = spin_lock_irqsave(&workqueue_lock);
+    if (workqueue_count >= WORKQUEUE_MAX) {
+        spin_unlock_irqrestore(&workqueue_lock, flags);
+        return NULL;
+    }
+    workqueue_t* wq = &workqueues[workqueue_count];
+    wq->name = name;
+    wait_queue_init(&wq->wait);
+    wq->head = NULL;
+    wq->tail = NULL;
+    wq->worker = NULL;
+    wq->executed = 0;
+    workqueue_count++;
+    spin_unlock_irqrestore(&workqueue_lock, flags);
+
+    // The queue accepts work right away; it runs once the worker starts
+    if (!process_create(name, worker_main, DEFAULT_PRIORITY)) {
+        vga_print("[WQ] Failed to start worker for ", VGA_COLOR_LIGHT_RED);
+        vga_print(name, VGA_COLOR_LIGHT_RED);
+        vga_print("\n", VGA_COLOR_WHITE);
+    }
+    return wq;
+}
+
+/**
+ * Queue work at the tail (any context)
+ */
+int queue_work(workqueue_t* wq, work_t* work)
+{
+    uint64_t flags = spin_lock_irqsave(&wq->wait.lock);
+    if (work->pending) {
+        spin_unlock_irqrestore(&wq->wait.lock, flags);
+        return 0;
+    }
+
+    work->pending = 1;
+    work->next = NULL;
+    if (wq->tail) {
+        wq->tail->next = work;
+    } else {
+        wq->head = work;
+    }
+    wq->tail = work;
+    wake_up_one_locked(&wq->wait);
+    spin_unlock_irqrestore(&wq->wait.lock, flags);
+    return 1;
+}
+
+int schedule_work(work_t* work)
+{
+    return system_wq ? queue_work(system_wq, work) : 0;
+}
+
+/**
+ * Create the shared "events" workqueue
+ */
+void workqueue_init(void)
+{
+    system_wq = workqueue_create("events");
+}
+
+void workqueue_print_stats(void)
+{
+    vga_print("[WQ] Executed:", VGA_COLOR_LIGHT_GREEN);
+    for (uint32_t i = 0; i < workqueue_count; i++) {
+        vga_print(" ", VGA_COLOR_LIGHT_GREEN);
+        vga_print(workqueues[i].name, VGA_COLOR_LIGHT_GREEN);
+        vga_print("=", VGA_COLOR_LIGHT_GREEN);
+        vga_print_int(workqueues[i].executed, VGA_COLOR_LIGHT_GREEN);
+    }
+    vga_print("\n", VGA_COLOR_WHITE);
+}
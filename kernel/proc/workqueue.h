@@ -0,0 +1,54 @@
+#ifndef KERNEL_PROC_WORKQUEUE_H
+#define KERNEL_PROC_WORKQUEUE_H
+
+#include <stdint.h>
+#include "../sync/waitqueue.h"
+
+// Workqueues: deferred work run by a kernel thread, so unlike softirqs
+// and tasklets it may sleep, block on locks and allocate memory. Work is
+// queued from any context (interrupt handlers included) and runs in
+// FIFO order on the queue's worker thread.
+
+// Maximum number of workqueues (each has its own worker thread)
+#define WORKQUEUE_MAX 8
+
+typedef struct work {
+    struct work* next;
+    void (*func)(struct work* work);
+    volatile uint8_t pending;  // Queued and not started yet
+} work_t;
+
+#define WORK_INIT(fn) { NULL, (fn), 0 }
+
+typedef struct workqueue {
+    const char* name;
+    wait_queue_t wait;         // Worker sleeps here; its lock guards the list
+    work_t* head;
+    work_t* tail;
+    process_t* worker;         // Set by the worker thread once it is running
+    uint32_t executed;         // Work items completed
+} workqueue_t;
+
+static inline void work_init(work_t* work, void (*func)(work_t* work)) {
+    work->next = NULL;
+    work->func = func;
+    work->pending = 0;
+}
+
+// Create a workqueue and start its worker thread (NULL on failure)
+workqueue_t* workqueue_create(const char* name);
+
+// Queue work (any context). Returns 1 if queued, 0 if it was already
+// pending; once it has started running it can be queued again.
+int queue_work(workqueue_t* wq, work_t* work);
+
+// Queue work on the shared "events" workqueue
+int schedule_work(work_t* work);
+
+// Create the shared workqueue (before the scheduler starts)
+void workqueue_init(void);
+
+// Print per-queue completed work counts
+void workqueue_print_stats(void);
+
+#endif // KERNEL_PROC_WORKQUEUE_H
@@ -0,0 +1,31 @@
+// Condition variables built on wait queues
+
+#include "condvar.h"
+
+void condvar_init(condvar_t* cv) {
+    wait_queue_init(&cv->waiters);
+}
+
+void condvar_wait(condvar_t* cv, mutex_t* mutex) {
+    uint64_t flags = irq_save();
+    
+    // Queue ourselves before the mutex is released, so a signal sent
+    // right after the unlock finds us
+    spin_lock(&cv->waiters.lock);
+    wait_queue_prepare(&cv->waiters);
+    spin_unlock(&cv->waiters.lock);
+    
+    mutex_unlock(mutex);
+    scheduler_yield();
+    irq_restore(flags);
+    
+    mutex_lock(mutex);
+}
+
+void condvar_signal(condvar_t* cv) {
+    wake_up_one(&cv->waiters);
+}
+
+void condvar_broadcast(condvar_t* cv) {
+    wake_up_all(&cv->waiters);
+}
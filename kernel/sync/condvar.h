@@ -0,0 +1,23 @@
+#ifndef KERNEL_SYNC_CONDVAR_H
+#define KERNEL_SYNC_CONDVAR_H
+
+#include "waitqueue.h"
+#include "mutex.h"
+
+// Condition variable, used together with a mutex_t
+typedef struct {
+    wait_queue_t waiters;
+} condvar_t;
+
+#define CONDVAR_INIT { WAIT_QUEUE_INIT }
+
+void condvar_init(condvar_t* cv);
+
+// Atomically release the mutex and block; the mutex is held again on
+// return. Re-check the predicate in a loop - wakeups may be spurious.
+void condvar_wait(condvar_t* cv, mutex_t* mutex);
+
+void condvar_signal(condvar_t* cv);      // Wake one waiter
+void condvar_broadcast(condvar_t* cv);   // Wake every waiter
+
+#endif // KERNEL_SYNC_CONDVAR_H
@@ -0,0 +1,74 @@
+#ifndef KERNEL_SYNC_MCSLOCK_H
+#define KERNEL_SYNC_MCSLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../arch/x86_64/cpu.h"
+#include "../arch/x86_64/interrupts.h"
+
+// MCS queue lock: every waiter spins on its own node, so a contended lock
+// costs one cache-line transfer per handoff instead of one per spinning CPU.
+// The caller provides the node (usually on its stack) and passes the same
+// node to mcs_unlock().
+typedef struct mcs_node {
+    struct mcs_node* volatile next;
+    volatile uint32_t locked;
+} mcs_node_t;
+
+typedef struct {
+    mcs_node_t* volatile tail;
+} mcs_lock_t;
+
+#define MCS_LOCK_INIT { NULL }
+
+static inline void mcs_lock_init(mcs_lock_t* lock) {
+    lock->tail = NULL;
+}
+
+static inline void mcs_lock(mcs_lock_t* lock, mcs_node_t* node) {
+    node->next = NULL;
+    node->locked = 1;
+    
+    mcs_node_t* prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+    if (!prev) {
+        return;  // Lock was free
+    }
+    
+    // Join the queue and wait for our predecessor to hand over
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE)) {
+        cpu_relax();
+    }
+}
+
+static inline void mcs_unlock(mcs_lock_t* lock, mcs_node_t* node) {
+    mcs_node_t* next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    
+    if (!next) {
+        // No known successor - release if we are still the tail
+        mcs_node_t* expected = node;
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, NULL, 0,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        // A successor is linking itself in - wait for it
+        while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE))) {
+            cpu_relax();
+        }
+    }
+    
+    __atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t mcs_lock_irqsave(mcs_lock_t* lock, mcs_node_t* node) {
+    uint64_t flags = irq_save();
+    mcs_lock(lock, node);
+    return flags;
+}
+
+static inline void mcs_unlock_irqrestore(mcs_lock_t* lock, mcs_node_t* node, uint64_t flags) {
+    mcs_unlock(lock, node);
+    irq_restore(flags);
+}
+
+#endif // KERNEL_SYNC_MCSLOCK_H
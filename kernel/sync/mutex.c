@@ -0,0 +1,68 @@
+// Mutexes - spin briefly while the owner runs, then sleep on a wait queue
+
+#include "mutex.h"
+#include "rcu.h"
+#include "../arch/x86_64/cpu.h"
+
+void mutex_init(mutex_t* mutex) {
+    mutex->locked = 0;
+    mutex->owner = NULL;
+    wait_queue_init(&mutex->waiters);
+}
+
+int mutex_trylock(mutex_t* mutex) {
+    uint32_t expected = 0;
+    if (__atomic_compare_exchange_n(&mutex->locked, &expected, 1, 0,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        mutex->owner = get_current_process();
+        return 1;
+    }
+    return 0;
+}
+
+// Spin while the owner is on a CPU - it is likely to release soon,
+// and sleeping would cost two context switches
+static int mutex_spin(mutex_t* mutex) {
+    for (uint32_t i = 0; i < MUTEX_SPIN_LIMIT; i++) {
+        if (!mutex->locked) {
+            if (mutex_trylock(mutex)) {
+                return 1;
+            }
+            continue;
+        }
+        
+        // The owner may unlock, exit and be reaped while we look at it;
+        // the read-side section keeps its TCB alive until we are done
+        rcu_read_lock();
+        process_t* owner = mutex->owner;
+        int running = owner && owner->on_cpu;
+        rcu_read_unlock();
+        if (!running) {
+            break;  // Owner blocked or preempted - spinning is wasted
+        }
+        cpu_relax();
+    }
+    return 0;
+}
+
+void mutex_lock(mutex_t* mutex) {
+    if (mutex_trylock(mutex) || mutex_spin(mutex)) {
+        return;
+    }
+    
+    // Slow path: the acquire attempt happens under the wait queue lock,
+    // so an unlock between the attempt and the sleep still wakes us
+    wait_event(&mutex->waiters, mutex_trylock(mutex));
+}
+
+void mutex_unlock(mutex_t* mutex) {
+    mutex->owner = NULL;
+    __atomic_store_n(&mutex->locked, 0, __ATOMIC_SEQ_CST);
+    
+    // Hand the wakeup to the longest waiter; it retries the acquire
+    uint64_t flags = spin_lock_irqsave(&mutex->waiters.lock);
+    if (mutex->waiters.head) {
+        wake_up_one_locked(&mutex->waiters);
+    }
+    spin_unlock_irqrestore(&mutex->waiters.lock, flags);
+}
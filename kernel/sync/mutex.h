@@ -0,0 +1,25 @@
+#ifndef KERNEL_SYNC_MUTEX_H
+#define KERNEL_SYNC_MUTEX_H
+
+#include <stdint.h>
+#include "waitqueue.h"
+
+// Spin iterations before a contended mutex_lock() goes to sleep
+// (only while the owner is running on another CPU)
+#define MUTEX_SPIN_LIMIT 1000
+
+// Sleeping lock with adaptive spinning; task context only
+typedef struct {
+    volatile uint32_t locked;
+    process_t* volatile owner;
+    wait_queue_t waiters;
+} mutex_t;
+
+#define MUTEX_INIT { 0, NULL, WAIT_QUEUE_INIT }
+
+void mutex_init(mutex_t* mutex);
+void mutex_lock(mutex_t* mutex);
+int mutex_trylock(mutex_t* mutex);   // Returns nonzero if acquired
+void mutex_unlock(mutex_t* mutex);
+
+#endif // KERNEL_SYNC_MUTEX_H
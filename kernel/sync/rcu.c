@@ -0,0 +1,207 @@
+#include "rcu.h"
+#include "spinlock.h"
+#include "waitqueue.h"
+#include "../proc/balance.h"
+#include "../irq/softirq.h"
+#include "../../drivers/vga.h"
+
+// Global grace period state. A grace period ends once every CPU that was
+// online when it started has reported a quiescent state.
+static spinlock_t rcu_lock = SPINLOCK_INIT_NAMED("rcu");
+static volatile uint64_t rcu_gp_seq = 0;        // Last grace period started
+static volatile uint64_t rcu_gp_completed = 0;  // Last grace period finished
+static volatile uint32_t rcu_qs_pending = 0;    // CPUs still to report (bit n = CPU n)
+static uint8_t rcu_gp_requested = 0;            // Callbacks wait for the one after this
+
+// synchronize_rcu() caller, woken by its own callback
+typedef struct {
+    struct rcu_head head;
+    wait_queue_t wq;
+    uint8_t done;
+} rcu_waiter_t;
+
+// CPUs that take part in a new grace period
+static uint32_t rcu_online_mask(void) {
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        if (cpu_get(i)->online) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+
+// Begin a grace period (rcu_lock held). Returns the CPUs that must report.
+static uint32_t rcu_start_gp_locked(void) {
+    uint32_t mask = rcu_online_mask();
+    
+    rcu_gp_seq++;
+    __atomic_store_n(&rcu_qs_pending, mask, __ATOMIC_SEQ_CST);
+    return mask;
+}
+
+// Tickless idle CPUs may not interrupt for a long time - a reschedule
+// IPI makes them report right away
+static void rcu_kick_cpus(uint32_t mask) {
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        if (mask & (1u << i)) {
+            balance_kick_cpu(i);
+        }
+    }
+}
+
+// Get a grace period that starts after now (interrupts disabled).
+// Returns its sequence number.
+static uint64_t rcu_request_gp(void) {
+    uint32_t kick = 0;
+    uint64_t gp;
+    
+    spin_lock(&rcu_lock);
+    if (rcu_gp_seq == rcu_gp_completed) {
+        kick = rcu_start_gp_locked();
+        gp = rcu_gp_seq;
+    } else {
+        // The running one may have started before our callbacks were
+        // queued - wait for the next
+        rcu_gp_requested = 1;
+        gp = rcu_gp_seq + 1;
+    }
+    spin_unlock(&rcu_lock);
+    
+    rcu_kick_cpus(kick);
+    return gp;
+}
+
+// Record a quiescent state for a CPU (interrupts disabled)
+static void rcu_report_qs(uint32_t id) {
+    uint32_t bit = 1u << id;
+    uint32_t kick = 0;
+    
+    // Nothing owed - the common case, no lock
+    if (!(__atomic_load_n(&rcu_qs_pending, __ATOMIC_ACQUIRE) & bit)) {
+        return;
+    }
+    
+    spin_lock(&rcu_lock);
+    if (rcu_qs_pending & bit) {
+        uint32_t left = rcu_qs_pending & ~bit;
+        __atomic_store_n(&rcu_qs_pending, left, __ATOMIC_SEQ_CST);
+        if (!left) {
+            rcu_gp_completed = rcu_gp_seq;
+            if (rcu_gp_requested) {
+                rcu_gp_requested = 0;
+                kick = rcu_start_gp_locked();
+            }
+        }
+    }
+    spin_unlock(&rcu_lock);
+    
+    rcu_kick_cpus(kick);
+}
+
+void call_rcu(struct rcu_head* head, void (*func)(struct rcu_head* head)) {
+    head->func = func;
+    head->next = NULL;
+    
+    uint64_t flags = irq_save();
+    rcu_cpu_t* rdp = &this_cpu()->rcu;
+    if (rdp->next_tail) {
+        rdp->next_tail->next = head;
+    } else {
+        rdp->next_head = head;
+    }
+    rdp->next_tail = head;
+    irq_restore(flags);
+}
+
+static void rcu_wake_waiter(struct rcu_head* head) {
+    rcu_waiter_t* waiter = rcu_container_of(head, rcu_waiter_t, head);
+    
+    spin_lock(&waiter->wq.lock);
+    waiter->done = 1;
+    wake_up_all_locked(&waiter->wq);
+    spin_unlock(&waiter->wq.lock);
+}
+
+void synchronize_rcu(void) {
+    // Before the scheduler runs there are no other readers to wait for
+    if (!get_current_process()) {
+        return;
+    }
+    
+    rcu_waiter_t waiter;
+    wait_queue_init(&waiter.wq);
+    waiter.done = 0;
+    
+    call_rcu(&waiter.head, rcu_wake_waiter);
+    wait_event(&waiter.wq, waiter.done);
+}
+
+void rcu_tick(void) {
+    cpu_t* cpu = this_cpu();
+    rcu_cpu_t* rdp = &cpu->rcu;
+    
+    // Callbacks whose grace period is over run from the softirq, with
+    // interrupts enabled, once this interrupt returns
+    if (rdp->wait_head && (int64_t)(rcu_gp_completed - rdp->wait_gp) >= 0) {
+        softirq_raise(SOFTIRQ_RCU);
+    }
+    
+    // Newly queued callbacks start waiting for a grace period
+    if (!rdp->wait_head && rdp->next_head) {
+        rdp->wait_head = rdp->next_head;
+        rdp->wait_tail = rdp->next_tail;
+        rdp->next_head = NULL;
+        rdp->next_tail = NULL;
+        rdp->wait_gp = rcu_request_gp();
+    }
+    
+    // Interrupted code was outside any read-side section
+    if (cpu->preempt_count == 0) {
+        rcu_report_qs(cpu->id);
+    }
+}
+
+void rcu_softirq(void) {
+    uint64_t flags = irq_save();
+    rcu_cpu_t* rdp = &this_cpu()->rcu;
+    struct rcu_head* head = NULL;
+    
+    if (rdp->wait_head && (int64_t)(rcu_gp_completed - rdp->wait_gp) >= 0) {
+        head = rdp->wait_head;
+        rdp->wait_head = NULL;
+        rdp->wait_tail = NULL;
+    }
+    irq_restore(flags);
+    
+    while (head) {
+        struct rcu_head* next = head->next;
+        head->func(head);
+        rdp->invoked++;
+        head = next;
+    }
+}
+
+void rcu_note_context_switch(void) {
+    rcu_report_qs(this_cpu()->id);
+}
+
+int rcu_needs_tick(void) {
+    cpu_t* cpu = this_cpu();
+    
+    return cpu->rcu.next_head || cpu->rcu.wait_head ||
+           (__atomic_load_n(&rcu_qs_pending, __ATOMIC_RELAXED) & (1u << cpu->id));
+}
+
+void rcu_print_stats(void) {
+    uint32_t invoked = 0;
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        invoked += cpu_get(i)->rcu.invoked;
+    }
+    
+    vga_print("[RCU] Grace periods: ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int((int32_t)rcu_gp_completed, VGA_COLOR_LIGHT_GREEN);
+    vga_print(", callbacks run: ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(invoked, VGA_COLOR_LIGHT_GREEN);
+    vga_print("\n", VGA_COLOR_WHITE);
+}
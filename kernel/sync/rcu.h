@@ -0,0 +1,62 @@
+#ifndef KERNEL_SYNC_RCU_H
+#define KERNEL_SYNC_RCU_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "rcu_types.h"
+#include "../proc/preempt.h"
+
+// Read-copy-update for read-mostly data.
+//
+// Readers bracket their accesses with rcu_read_lock()/rcu_read_unlock(),
+// which only disable preemption: no lock, no shared write. Updaters
+// publish new versions with rcu_assign_pointer(), unlink old ones under
+// their own lock and hand them to call_rcu(), which frees them once every
+// CPU has passed through a quiescent state (a context switch, or a tick
+// that interrupted code outside any read-side section). Read-side
+// sections must not block or yield.
+
+static inline void rcu_read_lock(void) {
+    preempt_disable();
+}
+
+static inline void rcu_read_unlock(void) {
+    preempt_enable();
+}
+
+// Load an RCU-protected pointer inside a read-side section
+#define rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_CONSUME)
+
+// Publish a pointer - initialization of *v is visible before the pointer
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+// Get the structure an rcu_head is embedded in
+#define rcu_container_of(ptr, type, member) \
+    ((type*)((uint8_t*)(ptr) - offsetof(type, member)))
+
+// Run func(head) after a grace period (from the RCU softirq of the
+// calling CPU, interrupts enabled, must not sleep)
+void call_rcu(struct rcu_head* head, void (*func)(struct rcu_head* head));
+
+// Block until every read-side section that was running has finished
+void synchronize_rcu(void);
+
+// Timer interrupt / reschedule IPI hook: report a quiescent state if the
+// interrupted code was not a reader, advance callbacks and raise
+// SOFTIRQ_RCU once some are ready
+void rcu_tick(void);
+
+// SOFTIRQ_RCU handler: run the callbacks whose grace period ended
+void rcu_softirq(void);
+
+// Context switch hook (rq->lock held) - always a quiescent state
+void rcu_note_context_switch(void);
+
+// Nonzero if this CPU must keep ticking for RCU (callbacks queued or a
+// quiescent state owed)
+int rcu_needs_tick(void);
+
+// Print grace period / callback counters
+void rcu_print_stats(void);
+
+#endif // KERNEL_SYNC_RCU_H
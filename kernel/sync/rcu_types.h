@@ -0,0 +1,22 @@
+#ifndef KERNEL_SYNC_RCU_TYPES_H
+#define KERNEL_SYNC_RCU_TYPES_H
+
+#include <stdint.h>
+
+// Callback queued by call_rcu() - embed it in the object to be reclaimed
+struct rcu_head {
+    struct rcu_head* next;
+    void (*func)(struct rcu_head* head);
+};
+
+// Per-CPU RCU callback lists (touched only by the owning CPU, IRQs off)
+typedef struct {
+    struct rcu_head* next_head;  // Queued, no grace period assigned yet
+    struct rcu_head* next_tail;
+    struct rcu_head* wait_head;  // Waiting for grace period wait_gp to end
+    struct rcu_head* wait_tail;
+    uint64_t wait_gp;
+    uint32_t invoked;            // Callbacks run on this CPU
+} rcu_cpu_t;
+
+#endif // KERNEL_SYNC_RCU_TYPES_H
@@ -0,0 +1,82 @@
+#ifndef KERNEL_SYNC_RWLOCK_H
+#define KERNEL_SYNC_RWLOCK_H
+
+#include <stdint.h>
+#include "../arch/x86_64/cpu.h"
+#include "../arch/x86_64/interrupts.h"
+
+// Reader-writer spinlock. Bit 31 = writer holds the lock, bit 30 = a
+// writer is waiting (new readers hold off so writers cannot starve),
+// low bits = number of readers.
+#define RWLOCK_WRITER  0x80000000u
+#define RWLOCK_WAITING 0x40000000u
+
+typedef struct {
+    volatile uint32_t value;
+} rwlock_t;
+
+#define RWLOCK_INIT { 0 }
+
+static inline void rwlock_init(rwlock_t* lock) {
+    lock->value = 0;
+}
+
+static inline void read_lock(rwlock_t* lock) {
+    for (;;) {
+        uint32_t v = __atomic_load_n(&lock->value, __ATOMIC_RELAXED);
+        if (!(v & (RWLOCK_WRITER | RWLOCK_WAITING)) &&
+            __atomic_compare_exchange_n(&lock->value, &v, v + 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        cpu_relax();
+    }
+}
+
+static inline void read_unlock(rwlock_t* lock) {
+    __atomic_fetch_sub(&lock->value, 1, __ATOMIC_RELEASE);
+}
+
+static inline void write_lock(rwlock_t* lock) {
+    for (;;) {
+        uint32_t v = __atomic_load_n(&lock->value, __ATOMIC_RELAXED);
+        if ((v & ~RWLOCK_WAITING) == 0 &&
+            __atomic_compare_exchange_n(&lock->value, &v, RWLOCK_WRITER, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        // Keep new readers out while we wait (re-set after every release)
+        if (!(v & RWLOCK_WAITING)) {
+            __atomic_fetch_or(&lock->value, RWLOCK_WAITING, __ATOMIC_RELAXED);
+        }
+        cpu_relax();
+    }
+}
+
+static inline void write_unlock(rwlock_t* lock) {
+    __atomic_store_n(&lock->value, 0, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t read_lock_irqsave(rwlock_t* lock) {
+    uint64_t flags = irq_save();
+    read_lock(lock);
+    return flags;
+}
+
+static inline void read_unlock_irqrestore(rwlock_t* lock, uint64_t flags) {
+    read_unlock(lock);
+    irq_restore(flags);
+}
+
+static inline uint64_t write_lock_irqsave(rwlock_t* lock) {
+    uint64_t flags = irq_save();
+    write_lock(lock);
+    return flags;
+}
+
+static inline void write_unlock_irqrestore(rwlock_t* lock, uint64_t flags) {
+    write_unlock(lock);
+    irq_restore(flags);
+}
+
+#endif // KERNEL_SYNC_RWLOCK_H
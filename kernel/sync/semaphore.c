@@ -0,0 +1,37 @@
+// Counting semaphores built on wait queues
+
+#include "semaphore.h"
+
+void semaphore_init(semaphore_t* sem, uint32_t count) {
+    sem->count = count;
+    wait_queue_init(&sem->waiters);
+}
+
+// Take one unit if available (waiters.lock held)
+static int semaphore_take_locked(semaphore_t* sem) {
+    if (sem->count == 0) {
+        return 0;
+    }
+    sem->count--;
+    return 1;
+}
+
+void semaphore_down(semaphore_t* sem) {
+    wait_event(&sem->waiters, semaphore_take_locked(sem));
+}
+
+int semaphore_trydown(semaphore_t* sem) {
+    int taken = 0;
+    
+    uint64_t flags = spin_lock_irqsave(&sem->waiters.lock);
+    taken = semaphore_take_locked(sem);
+    spin_unlock_irqrestore(&sem->waiters.lock, flags);
+    return taken;
+}
+
+void semaphore_up(semaphore_t* sem) {
+    uint64_t flags = spin_lock_irqsave(&sem->waiters.lock);
+    sem->count++;
+    wake_up_one_locked(&sem->waiters);
+    spin_unlock_irqrestore(&sem->waiters.lock, flags);
+}
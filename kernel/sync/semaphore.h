@@ -0,0 +1,20 @@
+#ifndef KERNEL_SYNC_SEMAPHORE_H
+#define KERNEL_SYNC_SEMAPHORE_H
+
+#include <stdint.h>
+#include "waitqueue.h"
+
+// Counting semaphore
+typedef struct {
+    uint32_t count;            // Protected by waiters.lock
+    wait_queue_t waiters;
+} semaphore_t;
+
+#define SEMAPHORE_INIT(n) { (n), WAIT_QUEUE_INIT }
+
+void semaphore_init(semaphore_t* sem, uint32_t count);
+void semaphore_down(semaphore_t* sem);      // Blocks while the count is 0
+int semaphore_trydown(semaphore_t* sem);    // Returns nonzero if taken
+void semaphore_up(semaphore_t* sem);        // Safe from interrupt handlers
+
+#endif // KERNEL_SYNC_SEMAPHORE_H
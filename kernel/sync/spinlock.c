@@ -0,0 +1,66 @@
+// Spinlock debug statistics (SPINLOCK_DEBUG)
+
+#include "spinlock.h"
+
+#if SPINLOCK_DEBUG
+#include "../../drivers/vga.h"
+
+#define SPINLOCK_DEBUG_MAX_LOCKS 64
+
+// Every lock seen so far (registered on first acquisition)
+static spinlock_t* debug_locks[SPINLOCK_DEBUG_MAX_LOCKS];
+static volatile uint32_t debug_lock_count = 0;
+
+void spin_lock_debug_acquired(spinlock_t* lock, int contended) {
+    if (!lock->debug.registered) {
+        lock->debug.registered = 1;
+        uint32_t slot = __atomic_fetch_add(&debug_lock_count, 1, __ATOMIC_RELAXED);
+        if (slot < SPINLOCK_DEBUG_MAX_LOCKS) {
+            debug_locks[slot] = lock;
+        }
+    }
+    
+    lock->debug.acquisitions++;
+    if (contended) {
+        lock->debug.contended++;
+    }
+    lock->debug.acquired_at = rdtsc();
+}
+
+void spin_lock_debug_release(spinlock_t* lock) {
+    uint64_t held = rdtsc() - lock->debug.acquired_at;
+    
+    lock->debug.hold_cycles += held;
+    if (held > lock->debug.max_hold_cycles) {
+        lock->debug.max_hold_cycles = held;
+    }
+}
+
+void spin_lock_debug_print(void) {
+    uint32_t count = debug_lock_count;
+    if (count > SPINLOCK_DEBUG_MAX_LOCKS) {
+        count = SPINLOCK_DEBUG_MAX_LOCKS;
+    }
+    
+    vga_print("[LOCK] name: acquisitions / contended / avg hold / max hold (cycles)\n", VGA_COLOR_LIGHT_GREEN);
+    for (uint32_t i = 0; i < count; i++) {
+        spinlock_t* lock = debug_locks[i];
+        if (!lock) {
+            continue;
+        }
+        
+        uint32_t acq = lock->debug.acquisitions;
+        vga_print("  ", VGA_COLOR_WHITE);
+        vga_print(lock->debug.name, VGA_COLOR_LIGHT_CYAN);
+        vga_print(": ", VGA_COLOR_WHITE);
+        vga_print_int(acq, VGA_COLOR_WHITE);
+        vga_print(" / ", VGA_COLOR_WHITE);
+        vga_print_int(lock->debug.contended, VGA_COLOR_WHITE);
+        vga_print(" / ", VGA_COLOR_WHITE);
+        vga_print_int(acq ? (int32_t)(lock->debug.hold_cycles / acq) : 0, VGA_COLOR_WHITE);
+        vga_print(" / ", VGA_COLOR_WHITE);
+        vga_print_int((int32_t)lock->debug.max_hold_cycles, VGA_COLOR_WHITE);
+        vga_print("\n", VGA_COLOR_WHITE);
+    }
+}
+#endif
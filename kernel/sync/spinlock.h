@@ -0,0 +1,135 @@
+#ifndef KERNEL_SYNC_SPINLOCK_H
+#define KERNEL_SYNC_SPINLOCK_H
+
+#include <stdint.h>
+#include "../arch/x86_64/cpu.h"
+#include "../arch/x86_64/interrupts.h"
+
+// Set to 1 to record hold times and contention for every spinlock
+// (dump them with spin_lock_debug_print())
+#define SPINLOCK_DEBUG 0
+
+// Ticket word: CPUs take a ticket from 'next' and wait for 'owner'
+typedef union {
+    uint32_t value;
+    struct {
+        uint16_t owner;        // Ticket being served
+        uint16_t next;         // Next ticket to hand out
+    } t;
+} spin_ticket_t;
+
+#if SPINLOCK_DEBUG
+// Per-lock statistics (updated while the lock is held)
+typedef struct {
+    const char* name;
+    volatile uint8_t registered;
+    uint64_t acquired_at;      // TSC when the current holder got the lock
+    uint64_t hold_cycles;      // Total cycles held
+    uint64_t max_hold_cycles;
+    uint32_t acquisitions;
+    uint32_t contended;        // Acquisitions that had to wait
+} spinlock_debug_t;
+#endif
+
+// Fair ticket spinlock (FIFO between CPUs)
+typedef struct {
+    volatile spin_ticket_t ticket;
+#if SPINLOCK_DEBUG
+    spinlock_debug_t debug;
+#endif
+} spinlock_t;
+
+#if SPINLOCK_DEBUG
+#define SPINLOCK_INIT_NAMED(n) { { 0 }, { (n), 0, 0, 0, 0, 0, 0 } }
+#else
+#define SPINLOCK_INIT_NAMED(n) { { 0 } }
+#endif
+#define SPINLOCK_INIT SPINLOCK_INIT_NAMED("anonymous")
+
+#if SPINLOCK_DEBUG
+void spin_lock_debug_acquired(spinlock_t* lock, int contended);
+void spin_lock_debug_release(spinlock_t* lock);
+void spin_lock_debug_print(void);
+#endif
+
+static inline void spin_lock_init_named(spinlock_t* lock, const char* name) {
+    lock->ticket.value = 0;
+#if SPINLOCK_DEBUG
+    lock->debug.name = name;
+    lock->debug.registered = 0;
+    lock->debug.hold_cycles = 0;
+    lock->debug.max_hold_cycles = 0;
+    lock->debug.acquisitions = 0;
+    lock->debug.contended = 0;
+#else
+    (void)name;
+#endif
+}
+
+static inline void spin_lock_init(spinlock_t* lock) {
+    spin_lock_init_named(lock, "anonymous");
+}
+
+static inline void spin_lock(spinlock_t* lock) {
+    uint16_t me = __atomic_fetch_add(&lock->ticket.t.next, 1, __ATOMIC_RELAXED);
+    int contended = 0;
+
+    while (__atomic_load_n(&lock->ticket.t.owner, __ATOMIC_ACQUIRE) != me) {
+        contended = 1;
+        cpu_relax();
+    }
+#if SPINLOCK_DEBUG
+    spin_lock_debug_acquired(lock, contended);
+#else
+    (void)contended;
+#endif
+}
+
+// Take the lock only if it is free right now (returns nonzero on success)
+static inline int spin_trylock(spinlock_t* lock) {
+    spin_ticket_t old;
+    old.value = __atomic_load_n(&lock->ticket.value, __ATOMIC_RELAXED);
+    if (old.t.owner != old.t.next) {
+        return 0;
+    }
+
+    spin_ticket_t new_ticket = old;
+    new_ticket.t.next++;
+    if (!__atomic_compare_exchange_n(&lock->ticket.value, &old.value, new_ticket.value,
+                                     0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+#if SPINLOCK_DEBUG
+    spin_lock_debug_acquired(lock, 0);
+#endif
+    return 1;
+}
+
+static inline void spin_unlock(spinlock_t* lock) {
+#if SPINLOCK_DEBUG
+    spin_lock_debug_release(lock);
+#endif
+    // Only the holder writes 'owner'
+    __atomic_store_n(&lock->ticket.t.owner, (uint16_t)(lock->ticket.t.owner + 1), __ATOMIC_RELEASE);
+}
+
+static inline int spin_is_locked(spinlock_t* lock) {
+    spin_ticket_t v;
+    v.value = __atomic_load_n(&lock->ticket.value, __ATOMIC_RELAXED);
+    return v.t.owner != v.t.next;
+}
+
+// Disable local interrupts and take the lock (returns saved flags) -
+// required for any lock that an interrupt handler may also take
+static inline uint64_t spin_lock_irqsave(spinlock_t* lock) {
+    uint64_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t* lock, uint64_t flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+#endif // KERNEL_SYNC_SPINLOCK_H
@@ -0,0 +1,84 @@
+// Wait queues - block processes until an event, integrated with the scheduler
+
+#include "waitqueue.h"
+
+void wait_queue_init(wait_queue_t* wq) {
+    spin_lock_init_named(&wq->lock, "waitqueue");
+    wq->head = NULL;
+    wq->tail = NULL;
+}
+
+// Unlink a process from the list
+static void wait_queue_unlink(wait_queue_t* wq, process_t* proc) {
+    if (proc->prev) proc->prev->next = proc->next;
+    if (proc->next) proc->next->prev = proc->prev;
+    if (wq->head == proc) wq->head = proc->next;
+    if (wq->tail == proc) wq->tail = proc->prev;
+    proc->next = NULL;
+    proc->prev = NULL;
+}
+
+// Queue the current process (wq->lock held, interrupts off)
+void wait_queue_prepare(wait_queue_t* wq) {
+    process_t* proc = get_current_process();
+    
+    // The running process is on no other list, so next/prev are free
+    proc->state = PROCESS_WAITING;
+    proc->wait_queue = wq;
+    proc->next = NULL;
+    proc->prev = wq->tail;
+    if (wq->tail) {
+        wq->tail->next = proc;
+    } else {
+        wq->head = proc;
+    }
+    wq->tail = proc;
+}
+
+// Wake the longest waiter
+uint32_t wake_up_one_locked(wait_queue_t* wq) {
+    while (wq->head) {
+        process_t* proc = wq->head;
+        wait_queue_unlink(wq, proc);
+        if (scheduler_wake(proc)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Wake every waiter
+uint32_t wake_up_all_locked(wait_queue_t* wq) {
+    uint32_t woken = 0;
+    
+    while (wq->head) {
+        process_t* proc = wq->head;
+        wait_queue_unlink(wq, proc);
+        woken += scheduler_wake(proc);
+    }
+    return woken;
+}
+
+uint32_t wake_up_one(wait_queue_t* wq) {
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    uint32_t woken = wake_up_one_locked(wq);
+    spin_unlock_irqrestore(&wq->lock, flags);
+    return woken;
+}
+
+uint32_t wake_up_all(wait_queue_t* wq) {
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    uint32_t woken = wake_up_all_locked(wq);
+    spin_unlock_irqrestore(&wq->lock, flags);
+    return woken;
+}
+
+// Remove without waking
+void wait_queue_remove(wait_queue_t* wq, process_t* proc) {
+    uint64_t flags = spin_lock_irqsave(&wq->lock);
+    if (proc->wait_queue == wq) {
+        wait_queue_unlink(wq, proc);
+        proc->wait_queue = NULL;
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
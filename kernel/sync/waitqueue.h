@@ -0,0 +1,51 @@
+#ifndef KERNEL_SYNC_WAITQUEUE_H
+#define KERNEL_SYNC_WAITQUEUE_H
+
+#include <stdint.h>
+#include "spinlock.h"
+#include "../proc/process.h"
+#include "../arch/x86_64/interrupts.h"
+
+// FIFO of processes blocked on an event (linked through process_t next/prev)
+typedef struct wait_queue {
+    spinlock_t lock;           // Protects the list and the waited-on condition
+    process_t* head;
+    process_t* tail;
+} wait_queue_t;
+
+#define WAIT_QUEUE_INIT { SPINLOCK_INIT_NAMED("waitqueue"), NULL, NULL }
+
+void wait_queue_init(wait_queue_t* wq);
+
+// Mark the current process PROCESS_WAITING and append it to the queue.
+// Call with wq->lock held and interrupts disabled, then drop the lock and
+// scheduler_yield(); a wakeup that slips in before the yield is not lost.
+void wait_queue_prepare(wait_queue_t* wq);
+
+// Wake the first / every waiter (wq->lock held). Return the number woken.
+uint32_t wake_up_one_locked(wait_queue_t* wq);
+uint32_t wake_up_all_locked(wait_queue_t* wq);
+
+// Same, taking wq->lock
+uint32_t wake_up_one(wait_queue_t* wq);
+uint32_t wake_up_all(wait_queue_t* wq);
+
+// Drop a waiter without waking it (process teardown)
+void wait_queue_remove(wait_queue_t* wq, process_t* proc);
+
+// Block until cond is true; cond is evaluated with wq->lock held
+#define wait_event(wq, cond)                                  \
+    do {                                                      \
+        uint64_t wait_flags_ = irq_save();                    \
+        spin_lock(&(wq)->lock);                               \
+        while (!(cond)) {                                     \
+            wait_queue_prepare(wq);                           \
+            spin_unlock(&(wq)->lock);                         \
+            scheduler_yield();                                \
+            spin_lock(&(wq)->lock);                           \
+        }                                                     \
+        spin_unlock(&(wq)->lock);                             \
+        irq_restore(wait_flags_);                             \
+    } while (0)
+
+#endif // KERNEL_SYNC_WAITQUEUE_H
@@ -0,0 +1,42 @@
+// Clock-event devices (see clockevent.h)
+
+#include "clockevent.h"
+#include "ktime.h"
+#include "../arch/x86_64/lapic.h"
+#include "../../drivers/vga.h"
+
+static clockevent_mode_t mode = CLOCKEVENT_NONE;
+
+void clockevent_init(void) {
+    if (!lapic_available() || !ktime_is_precise()) {
+        mode = CLOCKEVENT_NONE;
+    } else if (ktime_is_tsc() && lapic_timer_has_tsc_deadline()) {
+        mode = CLOCKEVENT_TSC_DEADLINE;
+    } else {
+        mode = CLOCKEVENT_LAPIC_ONESHOT;
+    }
+    
+    static const char* const names[] = { "none (periodic tick)", "tsc-deadline", "lapic-oneshot" };
+    vga_print("[CLOCK] Clockevent: ", VGA_COLOR_LIGHT_GREEN);
+    vga_print(names[mode], VGA_COLOR_LIGHT_CYAN);
+    vga_print("\n", VGA_COLOR_WHITE);
+}
+
+clockevent_mode_t clockevent_mode(void) {
+    return mode;
+}
+
+void clockevent_program(uint64_t expires_ns) {
+    if (mode == CLOCKEVENT_TSC_DEADLINE) {
+        lapic_timer_set_deadline(ktime_to_tsc(expires_ns));
+    } else if (mode == CLOCKEVENT_LAPIC_ONESHOT) {
+        uint64_t now = ktime_get_ns();
+        lapic_timer_set_oneshot_ns(expires_ns > now ? expires_ns - now : 0);
+    }
+}
+
+void clockevent_stop(void) {
+    if (mode != CLOCKEVENT_NONE) {
+        lapic_timer_stop();
+    }
+}
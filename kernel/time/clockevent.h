@@ -0,0 +1,35 @@
+#ifndef KERNEL_TIME_CLOCKEVENT_H
+#define KERNEL_TIME_CLOCKEVENT_H
+
+#include <stdint.h>
+
+// Per-CPU clock-event device: one interrupt (on LAPIC_TIMER_VECTOR) at
+// an absolute ktime. TSC-deadline mode is used where the CPU has it,
+// else the local APIC timer in one-shot mode. The first needs the TSC
+// clocksource, the second any precise one (TSC or HPET); without one
+// the tick stays on the tick-based LAPIC timer.
+
+typedef enum {
+    CLOCKEVENT_NONE = 0,       // Not available - use the legacy tick
+    CLOCKEVENT_TSC_DEADLINE,   // IA32_TSC_DEADLINE
+    CLOCKEVENT_LAPIC_ONESHOT   // Local APIC timer counting down
+} clockevent_mode_t;
+
+// Choose the mode (once, BSP, after lapic_timer_calibrate and ktime_init)
+void clockevent_init(void);
+
+// Mode in use by every CPU
+clockevent_mode_t clockevent_mode(void);
+
+static inline int clockevent_available(void) {
+    return clockevent_mode() != CLOCKEVENT_NONE;
+}
+
+// Arm the executing CPU's device for expires_ns (ktime); replaces any
+// earlier programming. A time in the past fires right away.
+void clockevent_program(uint64_t expires_ns);
+
+// Disarm the executing CPU's device
+void clockevent_stop(void);
+
+#endif // KERNEL_TIME_CLOCKEVENT_H
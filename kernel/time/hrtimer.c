@@ -0,0 +1,351 @@
+// High-resolution timers (see hrtimer.h)
+
+#include "hrtimer.h"
+#include "ktime.h"
+#include "tick.h"
+#include "../arch/x86_64/cpu.h"
+#include "../arch/x86_64/percpu.h"
+#include "../arch/x86_64/interrupts.h"
+#include "../irq/softirq.h"
+#include "../mm/kheap.h"
+#include "../proc/process.h"
+#include "../../drivers/vga.h"
+
+static void hrtimer_run(void);
+
+// Heap helpers (base->lock held)
+
+static void heap_set(hrtimer_cpu_t* base, uint32_t i, hrtimer_t* timer) {
+    base->heap[i] = timer;
+    timer->index = (int32_t)i;
+}
+
+static void heap_sift_up(hrtimer_cpu_t* base, uint32_t i) {
+    hrtimer_t* timer = base->heap[i];
+    
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (base->heap[parent]->expires <= timer->expires) {
+            break;
+        }
+        heap_set(base, i, base->heap[parent]);
+        i = parent;
+    }
+    heap_set(base, i, timer);
+}
+
+static void heap_sift_down(hrtimer_cpu_t* base, uint32_t i) {
+    hrtimer_t* timer = base->heap[i];
+    
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= base->count) {
+            break;
+        }
+        if (child + 1 < base->count &&
+            base->heap[child + 1]->expires < base->heap[child]->expires) {
+            child++;
+        }
+        if (timer->expires <= base->heap[child]->expires) {
+            break;
+        }
+        heap_set(base, i, base->heap[child]);
+        i = child;
+    }
+    heap_set(base, i, timer);
+}
+
+// Double the heap array
+static int heap_grow(hrtimer_cpu_t* base) {
+    uint32_t capacity = base->capacity ? base->capacity * 2 : HRTIMER_HEAP_MIN;
+    hrtimer_t** heap = kmalloc(capacity * sizeof(hrtimer_t*));
+    if (!heap) {
+        return -1;
+    }
+    
+    for (uint32_t i = 0; i < base->count; i++) {
+        heap[i] = base->heap[i];
+    }
+    if (base->heap) {
+        kfree(base->heap);
+    }
+    base->heap = heap;
+    base->capacity = capacity;
+    return 0;
+}
+
+static int heap_insert(hrtimer_cpu_t* base, hrtimer_t* timer) {
+    if (base->count == base->capacity && heap_grow(base) < 0) {
+        return -1;
+    }
+    
+    heap_set(base, base->count++, timer);
+    heap_sift_up(base, base->count - 1);
+    if (base->count > base->max_count) {
+        base->max_count = base->count;
+    }
+    return 0;
+}
+
+static void heap_remove(hrtimer_cpu_t* base, hrtimer_t* timer) {
+    uint32_t i = (uint32_t)timer->index;
+    hrtimer_t* last = base->heap[--base->count];
+    
+    timer->index = -1;
+    if (i == base->count) {
+        return;
+    }
+    
+    // The last entry fills the hole and moves whichever way it must
+    heap_set(base, i, last);
+    if (i > 0 && base->heap[(i - 1) / 2]->expires > last->expires) {
+        heap_sift_up(base, i);
+    } else {
+        heap_sift_down(base, i);
+    }
+}
+
+static void base_update(hrtimer_cpu_t* base) {
+    base->next_expiry = base->count ? base->heap[0]->expires : HRTIMER_NEVER;
+}
+
+// Make the tick device fire for a new earliest timer (interrupts off)
+static void hrtimer_reprogram(void) {
+    if (tick_rearm() < 0) {
+        scheduler_kick_tick();
+    }
+}
+
+// Take a timer off whichever CPU's heap holds it (interrupts off)
+static int hrtimer_dequeue(hrtimer_t* timer) {
+    if (timer->cpu < 0) {
+        return 0;
+    }
+    
+    hrtimer_cpu_t* base = &cpu_get((uint32_t)timer->cpu)->hrtimer;
+    int removed = 0;
+    
+    spin_lock(&base->lock);
+    if (hrtimer_active(timer)) {
+        heap_remove(base, timer);
+        base_update(base);
+        base->cancelled++;
+        removed = 1;
+    }
+    spin_unlock(&base->lock);
+    
+    // A stale earlier event on that CPU just finds nothing to run
+    return removed;
+}
+
+void hrtimers_init(void) {
+    softirq_register(SOFTIRQ_TIMER, hrtimer_run);
+}
+
+void hrtimers_init_cpu(void) {
+    hrtimer_cpu_t* base = &this_cpu()->hrtimer;
+    
+    spin_lock_init_named(&base->lock, "hrtimer");
+    base->heap = NULL;
+    base->count = 0;
+    base->capacity = 0;
+    base->next_expiry = HRTIMER_NEVER;
+    base->softirq_pending = 0;
+    base->running = NULL;
+    base->max_count = 0;
+    base->started = 0;
+    base->expired = 0;
+    base->cancelled = 0;
+    heap_grow(base);
+}
+
+void hrtimer_init(hrtimer_t* timer, hrtimer_restart_t (*func)(hrtimer_t* timer), uint64_t data) {
+    timer->expires = 0;
+    timer->func = func;
+    timer->data = data;
+    timer->index = -1;
+    timer->cpu = -1;
+}
+
+int hrtimer_start_abs(hrtimer_t* timer, uint64_t expires_ns) {
+    uint64_t flags = irq_save();
+    cpu_t* cpu = this_cpu();
+    hrtimer_cpu_t* base = &cpu->hrtimer;
+    
+    hrtimer_dequeue(timer);
+    
+    spin_lock(&base->lock);
+    timer->expires = expires_ns;
+    timer->cpu = (int32_t)cpu->id;
+    int ret = heap_insert(base, timer);
+    int first = ret == 0 && timer->index == 0;
+    if (ret == 0) {
+        base->started++;
+        base_update(base);
+    }
+    spin_unlock(&base->lock);
+    
+    // Expired timers pending in the softirq reprogram once they ran
+    if (first && !base->softirq_pending) {
+        hrtimer_reprogram();
+    }
+    
+    irq_restore(flags);
+    return ret;
+}
+
+int hrtimer_start(hrtimer_t* timer, uint64_t ns, hrtimer_restart_t (*func)(hrtimer_t* timer)) {
+    timer->func = func;
+    return hrtimer_start_abs(timer, ktime_get_ns() + ns);
+}
+
+int hrtimer_restart(hrtimer_t* timer, uint64_t ns) {
+    return hrtimer_start_abs(timer, ktime_get_ns() + ns);
+}
+
+uint64_t hrtimer_forward(hrtimer_t* timer, uint64_t interval_ns) {
+    uint64_t now = ktime_get_ns();
+    
+    if (!interval_ns || timer->expires > now) {
+        return 0;
+    }
+    
+    // One division rather than a loop when many intervals were missed
+    uint64_t overruns = (now - timer->expires) / interval_ns + 1;
+    timer->expires += overruns * interval_ns;
+    return overruns;
+}
+
+int hrtimer_try_to_cancel(hrtimer_t* timer) {
+    uint64_t flags = irq_save();
+    int ret = hrtimer_dequeue(timer);
+    
+    if (!ret && timer->cpu >= 0 && cpu_get((uint32_t)timer->cpu)->hrtimer.running == timer) {
+        ret = -1;
+    }
+    
+    irq_restore(flags);
+    return ret;
+}
+
+int hrtimer_cancel(hrtimer_t* timer) {
+    for (;;) {
+        int ret = hrtimer_try_to_cancel(timer);
+        if (ret >= 0) {
+            return ret;
+        }
+        cpu_relax();
+    }
+}
+
+uint64_t hrtimer_next_expiry(void) {
+    hrtimer_cpu_t* base = &this_cpu()->hrtimer;
+    return base->softirq_pending ? HRTIMER_NEVER : base->next_expiry;
+}
+
+void hrtimer_interrupt(void) {
+    hrtimer_cpu_t* base = &this_cpu()->hrtimer;
+    
+    // Read without the lock: a racing cancel only costs an empty run
+    if (!base->softirq_pending && base->next_expiry <= ktime_get_ns()) {
+        base->softirq_pending = 1;
+        softirq_raise(SOFTIRQ_TIMER);
+    }
+}
+
+// SOFTIRQ_TIMER: run the callbacks of every expired timer on this CPU
+static void hrtimer_run(void) {
+    hrtimer_cpu_t* base = &this_cpu()->hrtimer;
+    uint64_t flags = spin_lock_irqsave(&base->lock);
+    
+    // A fixed "now" keeps a short-period timer from looping forever
+    uint64_t now = ktime_get_ns();
+    
+    while (base->count && base->heap[0]->expires <= now) {
+        hrtimer_t* timer = base->heap[0];
+        heap_remove(base, timer);
+        base_update(base);
+        base->running = timer;
+        spin_unlock_irqrestore(&base->lock, flags);
+        
+        hrtimer_restart_t restart = timer->func(timer);
+        
+        flags = spin_lock_irqsave(&base->lock);
+        base->running = NULL;
+        base->expired++;
+        
+        // Unless the callback already started it again itself
+        if (restart == HRTIMER_RESTART && !hrtimer_active(timer)) {
+            if (heap_insert(base, timer) == 0) {
+                base->started++;
+            }
+            base_update(base);
+        }
+    }
+    
+    base->softirq_pending = 0;
+    spin_unlock(&base->lock);
+    hrtimer_reprogram();
+    irq_restore(flags);
+}
+
+// Sleeper wakeup
+static hrtimer_restart_t hrtimer_wakeup(hrtimer_t* timer) {
+    scheduler_wake((process_t*)timer->data);
+    return HRTIMER_NORESTART;
+}
+
+void hrtimer_nanosleep(uint64_t ns) {
+    uint64_t flags = irq_save();
+    scheduler_t* rq = &this_cpu()->sched;
+    process_t* proc = rq->current_process;
+    
+    if (!proc || proc == rq->idle_process || ns == 0) {
+        irq_restore(flags);
+        return;
+    }
+    
+    hrtimer_t timer;
+    hrtimer_init(&timer, hrtimer_wakeup, (uint64_t)proc);
+    
+    // The timer sits on this CPU, so it cannot fire before the yield
+    if (hrtimer_start(&timer, ns, hrtimer_wakeup) == 0) {
+        proc->state = PROCESS_WAITING;
+        scheduler_yield();
+    }
+    irq_restore(flags);
+    
+    // The callback may still be returning when we run again
+    hrtimer_cancel(&timer);
+}
+
+void hrtimer_print_stats(void) {
+    uint32_t pending = 0;
+    uint32_t max = 0;
+    uint32_t started = 0;
+    uint32_t expired = 0;
+    uint32_t cancelled = 0;
+    
+    for (uint32_t i = 0; i < cpu_count(); i++) {
+        hrtimer_cpu_t* base = &cpu_get(i)->hrtimer;
+        pending += base->count;
+        if (base->max_count > max) {
+            max = base->max_count;
+        }
+        started += base->started;
+        expired += base->expired;
+        cancelled += base->cancelled;
+    }
+    
+    vga_print("[HRTIMER] pending ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(pending, VGA_COLOR_LIGHT_GREEN);
+    vga_print(" (max ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(max, VGA_COLOR_LIGHT_GREEN);
+    vga_print(" on one CPU), started ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(started, VGA_COLOR_LIGHT_GREEN);
+    vga_print(", expired ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(expired, VGA_COLOR_LIGHT_GREEN);
+    vga_print(", cancelled ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int(cancelled, VGA_COLOR_LIGHT_GREEN);
+    vga_print("\n", VGA_COLOR_WHITE);
+}
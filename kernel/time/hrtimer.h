@@ -0,0 +1,85 @@
+#ifndef KERNEL_TIME_HRTIMER_H
+#define KERNEL_TIME_HRTIMER_H
+
+#include <stdint.h>
+#include "hrtimer_types.h"
+
+// High-resolution timers. Each CPU keeps its pending timers in a
+// min-heap keyed by absolute ktime, so start and cancel are O(log n)
+// and the earliest expiry is always at hand. The tick device is armed
+// for whichever comes first, the next tick or the earliest timer; with
+// a clock-event device that is nanosecond-precise, otherwise timers
+// expire on the next tick. Callbacks run from SOFTIRQ_TIMER on the CPU
+// the timer was started on (interrupts on, no sleeping).
+
+// Expiry of an empty queue
+#define HRTIMER_NEVER UINT64_MAX
+
+// Initial heap size per CPU (doubled as needed)
+#define HRTIMER_HEAP_MIN 64
+
+typedef enum {
+    HRTIMER_NORESTART = 0,     // Done
+    HRTIMER_RESTART            // Requeue at timer->expires (see hrtimer_forward)
+} hrtimer_restart_t;
+
+typedef struct hrtimer {
+    uint64_t expires;          // Absolute ktime (ns)
+    hrtimer_restart_t (*func)(struct hrtimer* timer);
+    uint64_t data;             // For the callback
+    int32_t index;             // Heap slot, -1 when not queued
+    int32_t cpu;               // CPU whose heap holds it (or last held it)
+} hrtimer_t;
+
+#define HRTIMER_INIT(fn, d) { 0, (fn), (d), -1, -1 }
+
+// Register SOFTIRQ_TIMER (once, BSP, after ktime_init)
+void hrtimers_init(void);
+
+// Set up the executing CPU's timer queue
+void hrtimers_init_cpu(void);
+
+void hrtimer_init(hrtimer_t* timer, hrtimer_restart_t (*func)(hrtimer_t* timer), uint64_t data);
+
+// Arm a timer ns from now on the executing CPU, replacing any pending
+// expiry. Returns 0, or -1 if the queue could not grow.
+int hrtimer_start(hrtimer_t* timer, uint64_t ns, hrtimer_restart_t (*func)(hrtimer_t* timer));
+
+// Same, at an absolute ktime
+int hrtimer_start_abs(hrtimer_t* timer, uint64_t expires_ns);
+
+// Re-arm ns from now with the callback already set
+int hrtimer_restart(hrtimer_t* timer, uint64_t ns);
+
+// Push expires forward by whole intervals until it is in the future
+// (for periodic callbacks returning HRTIMER_RESTART). Returns the
+// number of intervals added.
+uint64_t hrtimer_forward(hrtimer_t* timer, uint64_t interval_ns);
+
+// Dequeue a pending timer. Returns 1 if it was pending, 0 if not,
+// -1 if its callback is running right now.
+int hrtimer_try_to_cancel(hrtimer_t* timer);
+
+// Dequeue and wait for a running callback to finish (not from the
+// timer's own callback). Returns 1 if it was pending.
+int hrtimer_cancel(hrtimer_t* timer);
+
+static inline int hrtimer_active(const hrtimer_t* timer) {
+    return timer->index >= 0;
+}
+
+// Earliest expiry on the executing CPU (HRTIMER_NEVER if none, or if
+// expired timers are already waiting for the softirq)
+uint64_t hrtimer_next_expiry(void);
+
+// Timer interrupt: raise SOFTIRQ_TIMER if the earliest timer is due
+// (interrupts disabled)
+void hrtimer_interrupt(void);
+
+// Block the calling task for at least ns
+void hrtimer_nanosleep(uint64_t ns);
+
+// Print per-CPU queue depth and expiry counters
+void hrtimer_print_stats(void);
+
+#endif // KERNEL_TIME_HRTIMER_H
@@ -0,0 +1,25 @@
+#ifndef KERNEL_TIME_HRTIMER_TYPES_H
+#define KERNEL_TIME_HRTIMER_TYPES_H
+
+#include <stdint.h>
+#include "../sync/spinlock.h"
+
+struct hrtimer;
+
+// Per-CPU high-resolution timer queue: a binary min-heap of pending
+// timers ordered by expiry (heap[0] expires first)
+typedef struct {
+    spinlock_t lock;                      // Guards the heap (other CPUs cancel)
+    struct hrtimer** heap;
+    uint32_t count;
+    uint32_t capacity;
+    volatile uint64_t next_expiry;        // heap[0]->expires, HRTIMER_NEVER if empty
+    volatile uint8_t softirq_pending;     // SOFTIRQ_TIMER raised, not yet run
+    struct hrtimer* volatile running;     // Callback in progress
+    uint32_t max_count;                   // Deepest the heap has been
+    uint32_t started;                     // Timers queued here
+    uint32_t expired;                     // Callbacks run here
+    uint32_t cancelled;                   // Timers removed before expiry
+} hrtimer_cpu_t;
+
+#endif // KERNEL_TIME_HRTIMER_TYPES_H
@@ -0,0 +1,75 @@
+// Kernel clock (see ktime.h)
+
+#include "ktime.h"
+#include "tsc.h"
+#include "../arch/x86_64/cpu.h"
+#include "../../drivers/hpet.h"
+#include "../../drivers/vga.h"
+
+static uint8_t use_tsc = 0;
+static uint8_t use_hpet = 0;
+static uint64_t hpet_base = 0;     // HPET count at ktime 0
+static uint64_t tsc_base = 0;      // TSC at ktime 0
+static uint64_t ns_per_cycle = 0;  // 32.32 fixed point
+static uint64_t cycles_per_ns = 0; // 32.32 fixed point
+
+void ktime_init(void) {
+    uint64_t khz = tsc_khz();
+    
+    // A TSC that changes rate with P-states or stops in deep C-states
+    // is no clock; take the HPET instead (or the PIT without one)
+    if (khz && tsc_invariant()) {
+        // Fixed-point factors: a multiply and a shift per conversion
+        ns_per_cycle = (NSEC_PER_MSEC << 32) / khz;
+        cycles_per_ns = (khz << 32) / NSEC_PER_MSEC;
+        tsc_base = rdtsc();
+        use_tsc = 1;
+    } else if (hpet_available()) {
+        // Slower to read than the TSC, but just as precise
+        hpet_base = hpet_read();
+        use_hpet = 1;
+    }
+    
+    vga_print("[CLOCK] Clocksource: ", VGA_COLOR_LIGHT_GREEN);
+    vga_print(use_tsc ? "tsc" : use_hpet ? "hpet" : "pit (tick resolution)", VGA_COLOR_LIGHT_CYAN);
+    vga_print("\n", VGA_COLOR_WHITE);
+}
+
+uint64_t ktime_get_ns(void) {
+    if (use_hpet) {
+        return hpet_ticks_to_ns(hpet_read() - hpet_base);
+    }
+    if (!use_tsc) {
+        return pit_get_ticks() * TICK_NSEC;
+    }
+    uint64_t cycles = rdtsc() - tsc_base;
+    return (uint64_t)(((unsigned __int128)cycles * ns_per_cycle) >> 32);
+}
+
+int ktime_is_tsc(void) {
+    return use_tsc;
+}
+
+int ktime_is_precise(void) {
+    return use_tsc || use_hpet;
+}
+
+void ktime_tsc_params(uint64_t* base, uint64_t* mult) {
+    *base = tsc_base;
+    *mult = ns_per_cycle;
+}
+
+uint64_t ktime_to_tsc(uint64_t ns) {
+    return tsc_base + (uint64_t)(((unsigned __int128)ns * cycles_per_ns) >> 32);
+}
+
+void ktime_udelay(uint32_t us) {
+    if (!ktime_is_precise()) {
+        pit_delay_us(us);
+        return;
+    }
+    uint64_t end = ktime_get_ns() + us * NSEC_PER_USEC;
+    while (ktime_get_ns() < end) {
+        cpu_relax();
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef KERNEL_TIME_KTIME_H
+#define KERNEL_TIME_KTIME_H
+
+#include <stdint.h>
+#include "../../drivers/pit.h"
+
+// Monotonic kernel clock in nanoseconds since ktime_init(). The
+// clocksource is the TSC (calibrated by tsc_init()) if it is invariant,
+// else the HPET main counter; with neither the PIT tick count is used,
+// at tick resolution.
+
+#define NSEC_PER_USEC 1000ULL
+#define NSEC_PER_MSEC 1000000ULL
+#define NSEC_PER_SEC  1000000000ULL
+
+// Length of one scheduler tick
+#define TICK_NSEC (NSEC_PER_SEC / TIMER_FREQUENCY)
+
+// Pick the clocksource (after tsc_init, before any ktime_get_ns user)
+void ktime_init(void);
+
+// Nanoseconds since boot (any CPU, any context)
+uint64_t ktime_get_ns(void);
+
+static inline uint64_t ktime_get_us(void) {
+    return ktime_get_ns() / NSEC_PER_USEC;
+}
+
+// Nonzero if the clock runs on the TSC (nanosecond resolution)
+int ktime_is_tsc(void);
+
+// Nonzero if the clock has sub-tick resolution (TSC or HPET)
+int ktime_is_precise(void);
+
+// The TSC conversion behind ktime_get_ns(): ns = ((tsc - base) * mult)
+// >> 32 (TSC clocksource only)
+void ktime_tsc_params(uint64_t* base, uint64_t* mult);
+
+// TSC value at which ktime_get_ns() reaches ns (TSC clocksource only)
+uint64_t ktime_to_tsc(uint64_t ns);
+
+// Busy-wait, independent of interrupts and of the tick
+void ktime_udelay(uint32_t us);
+
+#endif // KERNEL_TIME_KTIME_H
@@ -0,0 +1,250 @@
+// Per-CPU tick device selection (PIT, HPET, local APIC timer or clock event)
+
+#include "tick.h"
+#include "ktime.h"
+#include "clockevent.h"
+#include "hrtimer.h"
+#include "vtime.h"
+#include "../arch/x86_64/percpu.h"
+#include "../arch/x86_64/lapic.h"
+#include "../arch/x86_64/interrupts.h"
+#include "../../drivers/pit.h"
+#include "../../drivers/hpet.h"
+
+// The boot CPU ticks from HPET timer 0 instead of the PIT
+static uint8_t tick_hpet = 0;
+
+// With a clock-event device the tick grid is kept in ktime: the last
+// tick boundary accounted on each CPU. Events are programmed on the
+// grid, and elapsed ticks are read off the clock rather than counted.
+static uint64_t tick_base_ns[MAX_CPUS];
+
+// Next tick boundary the scheduler asked for on each CPU; the device is
+// armed for it or for the earliest hrtimer, whichever comes first
+static uint64_t tick_next_ns[MAX_CPUS];
+
+// Deadline the device was last armed for on each CPU (0 once the event
+// it belongs to has been handled), for the delivery latency
+static uint64_t tick_armed_ns[MAX_CPUS];
+
+// Check whether this CPU's events are deadlines on the ktime grid
+static int tick_on_grid(cpu_t* cpu) {
+    return cpu->lapic_timer ? clockevent_available() : tick_hpet;
+}
+
+// Arm the clock event for the next tick or hrtimer
+static void tick_arm(cpu_t* cpu) {
+    uint64_t expires = tick_next_ns[cpu->id];
+    uint64_t timer = hrtimer_next_expiry();
+    
+    if (timer < expires) {
+        expires = timer;
+    }
+    tick_armed_ns[cpu->id] = expires;
+    if (cpu->lapic_timer) {
+        clockevent_program(expires);
+    } else {
+        uint64_t now = ktime_get_ns();
+        hpet_event_program(expires > now ? expires - now : 0);
+    }
+}
+
+// Whole ticks since the last boundary accounted, moving the boundary
+static uint64_t tick_advance(uint32_t id) {
+    uint64_t now = ktime_get_ns();
+    uint64_t ticks = 0;
+    
+    if (now > tick_base_ns[id]) {
+        ticks = (now - tick_base_ns[id]) / TICK_NSEC;
+        tick_base_ns[id] += ticks * TICK_NSEC;
+    }
+    return ticks;
+}
+
+// Advance the global tick count (CPU 0) and republish it
+static void tick_credit(uint64_t ticks) {
+    if (ticks) {
+        pit_credit_ticks(ticks);
+        vtime_update();
+    }
+}
+
+// Delivery latency of the event being handled
+uint64_t tick_latency_ns(void) {
+    cpu_t* cpu = this_cpu();
+    uint64_t armed = tick_armed_ns[cpu->id];
+    
+    if (!armed || !tick_on_grid(cpu)) {
+        return 0;
+    }
+    tick_armed_ns[cpu->id] = 0;
+    
+    uint64_t now = ktime_get_ns();
+    return now > armed ? now - armed : 0;
+}
+
+// Acknowledge a tick interrupt
+uint64_t tick_handle_irq(void) {
+    cpu_t* cpu = this_cpu();
+    
+    if (cpu->lapic_timer) {
+        // Early or already-accounted events just report 0 ticks
+        uint64_t ticks = clockevent_available() ? tick_advance(cpu->id) : lapic_timer_handler();
+        lapic_eoi();
+        
+        // The bootstrap processor keeps the global tick count
+        if (cpu->id == 0) {
+            tick_credit(ticks);
+        }
+        return ticks;
+    }
+    
+    irq_eoi(0);
+    if (tick_hpet) {
+        uint64_t ticks = tick_advance(cpu->id);
+        tick_credit(ticks);
+        return ticks;
+    }
+    uint64_t ticks = pit_handler();
+    vtime_update();
+    return ticks;
+}
+
+// Program the next tick event
+void tick_program(uint32_t ticks) {
+    cpu_t* cpu = this_cpu();
+    
+    if (tick_on_grid(cpu)) {
+        tick_next_ns[cpu->id] = tick_base_ns[cpu->id] + (ticks ? ticks : 1) * TICK_NSEC;
+        tick_arm(cpu);
+        return;
+    }
+    
+    // Without a clock event hrtimers expire on the tick that follows them
+    uint64_t timer = hrtimer_next_expiry();
+    if (timer != HRTIMER_NEVER && ticks > 1) {
+        uint64_t now = ktime_get_ns();
+        uint64_t timer_ticks = timer > now ? (timer - now + TICK_NSEC - 1) / TICK_NSEC : 1;
+        if (timer_ticks < ticks) {
+            ticks = (uint32_t)timer_ticks;
+        }
+    }
+    
+    if (cpu->lapic_timer) {
+        if (ticks <= 1) {
+            lapic_timer_set_periodic();
+        } else {
+            lapic_timer_set_oneshot(ticks);
+        }
+        return;
+    }
+    
+    if (ticks <= 1) {
+        pit_set_periodic();
+    } else {
+        pit_set_oneshot(ticks);
+    }
+}
+
+// Re-arm after the earliest hrtimer changed
+int tick_rearm(void) {
+    cpu_t* cpu = this_cpu();
+    
+    if (!tick_on_grid(cpu)) {
+        return -1;
+    }
+    tick_arm(cpu);
+    return 0;
+}
+
+// Cancel a pending one-shot
+uint64_t tick_cancel_oneshot(void) {
+    cpu_t* cpu = this_cpu();
+    
+    if (cpu->lapic_timer) {
+        // A clock event stays armed: tick_program() replaces it, and if
+        // it fires first it finds no whole tick left to report
+        uint64_t ticks = clockevent_available() ? tick_advance(cpu->id) : lapic_timer_cancel_oneshot();
+        if (cpu->id == 0) {
+            tick_credit(ticks);
+        }
+        return ticks;
+    }
+    if (tick_hpet) {
+        uint64_t ticks = tick_advance(cpu->id);
+        tick_credit(ticks);
+        return ticks;
+    }
+    
+    uint64_t ticks = pit_cancel_oneshot();
+    vtime_update();
+    return ticks;
+}
+
+// Longest one-shot interval
+uint32_t tick_max_oneshot(void) {
+    uint32_t max = tick_hpet ? TICK_MAX_ONESHOT : PIT_MAX_ONESHOT_TICKS;
+    if (this_cpu()->lapic_timer) {
+        max = clockevent_mode() == CLOCKEVENT_TSC_DEADLINE ? TICK_MAX_ONESHOT : lapic_timer_max_ticks();
+    }
+    return max < TICK_MAX_ONESHOT ? max : TICK_MAX_ONESHOT;
+}
+
+// Switch this CPU to its local APIC timer
+void tick_use_lapic(void) {
+    cpu_t* cpu = this_cpu();
+    
+    if (cpu->lapic_timer || !lapic_available()) {
+        return;
+    }
+    
+    uint64_t flags = irq_save();
+    
+    if (cpu->id == 0) {
+        // Settle any pending one-shot, then silence the IRQ0 interrupt
+        tick_cancel_oneshot();
+        if (tick_hpet) {
+            hpet_event_disable();
+            tick_hpet = 0;
+        }
+        pit_set_periodic();
+        irq_mask(0);
+    }
+    
+    cpu->lapic_timer = 1;
+    if (clockevent_available()) {
+        // The grid carries on where the HPET left it
+        if (!tick_base_ns[cpu->id]) {
+            tick_base_ns[cpu->id] = ktime_get_ns();
+        }
+        tick_next_ns[cpu->id] = tick_base_ns[cpu->id] + TICK_NSEC;
+        tick_arm(cpu);
+    } else {
+        lapic_timer_set_periodic();
+    }
+    
+    irq_restore(flags);
+}
+
+// Move the boot CPU's tick from the PIT to HPET timer 0
+void tick_use_hpet(void) {
+    cpu_t* cpu = this_cpu();
+    
+    if (cpu->id != 0 || cpu->lapic_timer || tick_hpet ||
+        !hpet_event_available() || !ktime_is_precise()) {
+        return;
+    }
+    
+    uint64_t flags = irq_save();
+    
+    // Ticks up to here were counted by the PIT
+    pit_cancel_oneshot();
+    pit_set_periodic();
+    hpet_event_enable();
+    tick_hpet = 1;
+    tick_base_ns[cpu->id] = ktime_get_ns();
+    tick_next_ns[cpu->id] = tick_base_ns[cpu->id] + TICK_NSEC;
+    tick_arm(cpu);
+    
+    irq_restore(flags);
+}
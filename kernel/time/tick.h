@@ -0,0 +1,45 @@
+#ifndef KERNEL_TIME_TICK_H
+#define KERNEL_TIME_TICK_H
+
+#include <stdint.h>
+
+// Upper bound for a one-shot interval (ticks) - keeps the global tick
+// count reasonably fresh even when the CPU owning it is idle
+#define TICK_MAX_ONESHOT 100
+
+// Per-CPU tick device: the PIT (or HPET) until the local APIC timer
+// takes over. With a clock-event device (clockevent.h, or the HPET)
+// ticks are deadlines on a ktime grid instead of timer counts. All
+// functions act on the executing CPU and expect interrupts disabled.
+
+// Nanoseconds from the deadline the device was armed for to now, on
+// entry to the handler of that event. 0 if ticks are not deadlines on
+// the ktime grid, the event came early, or it was already measured.
+uint64_t tick_latency_ns(void);
+
+// Acknowledge a tick interrupt and return the ticks it covers
+// (CPU 0 also advances the global tick count)
+uint64_t tick_handle_irq(void);
+
+// Program the next tick event: <= 1 tick means periodic, else one-shot
+void tick_program(uint32_t ticks);
+
+// Re-arm the clock event after the earliest hrtimer on this CPU
+// changed. Returns -1 if ticks are not clock events; the tick interval
+// then has to be recomputed by the scheduler instead.
+int tick_rearm(void);
+
+// Stop a pending one-shot early and return the whole ticks elapsed
+uint64_t tick_cancel_oneshot(void);
+
+// Longest one-shot interval this CPU's tick device supports
+uint32_t tick_max_oneshot(void);
+
+// Move this CPU's tick from the PIT (or HPET) to its local APIC timer
+void tick_use_lapic(void);
+
+// Boot CPU without a local APIC timer: tick from HPET timer 0, on the
+// ktime grid, instead of the PIT (no-op without an HPET)
+void tick_use_hpet(void);
+
+#endif // KERNEL_TIME_TICK_H
@@ -0,0 +1,67 @@
+// TSC calibration (see tsc.h)
+
+#include "tsc.h"
+#include "../arch/x86_64/cpu.h"
+#include "../../drivers/pit.h"
+#include "../../drivers/hpet.h"
+#include "../../drivers/vga.h"
+
+#define CPUID_80000007_EDX_INVARIANT_TSC (1U << 8)
+
+static uint64_t tsc_freq_khz = 0;
+static uint8_t tsc_is_invariant = 0;
+
+void tsc_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid(0x80000000, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 0x80000007) {
+        cpuid(0x80000007, 0, &eax, &ebx, &ecx, &edx);
+        tsc_is_invariant = (edx & CPUID_80000007_EDX_INVARIANT_TSC) != 0;
+    }
+
+    if (hpet_available()) {
+        // Both counters are read at each end, so the window needs no
+        // exact length and one round is enough
+        uint64_t hpet_start = hpet_read();
+        uint64_t start = rdtsc();
+        hpet_delay_us(TSC_CALIBRATE_US);
+        uint64_t cycles = rdtsc() - start;
+        uint64_t ns = hpet_ticks_to_ns(hpet_read() - hpet_start);
+        tsc_freq_khz = (cycles * 1000000) / ns;
+    } else {
+        // Channel 2 busy-wait: no interrupts needed
+        uint64_t best = ~0ULL;
+        for (uint32_t i = 0; i < TSC_CALIBRATE_ROUNDS; i++) {
+            uint64_t start = rdtsc();
+            pit_delay_us(TSC_CALIBRATE_US);
+            uint64_t cycles = rdtsc() - start;
+            if (cycles < best) {
+                best = cycles;
+            }
+        }
+        tsc_freq_khz = best / (TSC_CALIBRATE_US / 1000);
+    }
+
+    vga_print("[TSC] ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_int((int32_t)(tsc_freq_khz / 1000), VGA_COLOR_LIGHT_CYAN);
+    vga_print(hpet_available() ? " MHz (hpet)" : " MHz (pit)", VGA_COLOR_LIGHT_GREEN);
+    vga_print(tsc_is_invariant ? " (invariant)\n" : " (not invariant - times are approximate)\n",
+              tsc_is_invariant ? VGA_COLOR_LIGHT_GREEN : VGA_COLOR_LIGHT_RED);
+}
+
+uint64_t tsc_khz(void) {
+    return tsc_freq_khz;
+}
+
+int tsc_invariant(void) {
+    return tsc_is_invariant;
+}
+
+uint64_t tsc_cycles_to_us(uint64_t cycles) {
+    if (!tsc_freq_khz) {
+        return 0;
+    }
+    // Split to keep cycles * 1000 from overflowing on long uptimes
+    return (cycles / tsc_freq_khz) * 1000 + ((cycles % tsc_freq_khz) * 1000) / tsc_freq_khz;
+}
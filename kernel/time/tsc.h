@@ -0,0 +1,28 @@
+#ifndef KERNEL_TIME_TSC_H
+#define KERNEL_TIME_TSC_H
+
+#include <stdint.h>
+
+// Time-stamp counter: calibrated against the HPET (the PIT if there is
+// none) at boot and used for CPU time accounting. Only an invariant TSC
+// (constant rate in every P-/C-state) measures time; without one the
+// cycle counts are still kept but are reported as cycles, not as time.
+
+// Calibration window and PIT rounds (the shortest round wins - an SMI or
+// a slow port access can only make a round longer)
+#define TSC_CALIBRATE_US 10000
+#define TSC_CALIBRATE_ROUNDS 3
+
+// Measure the TSC frequency (bootstrap processor, before the scheduler)
+void tsc_init(void);
+
+// TSC frequency in kHz (0 before tsc_init)
+uint64_t tsc_khz(void);
+
+// Nonzero if CPUID reports an invariant TSC
+int tsc_invariant(void);
+
+// Convert a cycle count (0 if the TSC is not calibrated)
+uint64_t tsc_cycles_to_us(uint64_t cycles);
+
+#endif // KERNEL_TIME_TSC_H
@@ -0,0 +1,61 @@
+// Time page shared with user mode (see vtime.h)
+
+#include "vtime.h"
+#include "ktime.h"
+#include "../mm/paging.h"
+#include "../mm/pmm.h"
+#include "../../drivers/pit.h"
+#include "../../drivers/vga.h"
+
+// Kernel's writable view of the page (NULL until vtime_init)
+static vtime_page_t* vtime_page = 0;
+
+// Open an update: readers spin or retry until vtime_write_end()
+static inline void vtime_write_begin(vtime_page_t* vt) {
+    vt->seq++;
+    __asm__ volatile("" : : : "memory");
+}
+
+static inline void vtime_write_end(vtime_page_t* vt) {
+    __asm__ volatile("" : : : "memory");
+    vt->seq++;
+}
+
+void vtime_init(void) {
+    vtime_page_t* vt = (vtime_page_t*)pmm_alloc_zeroed_page();
+    if (!vt) {
+        vga_print("[VTIME] Out of memory\n", VGA_COLOR_LIGHT_RED);
+        return;
+    }
+    
+    vtime_write_begin(vt);
+    if (ktime_is_tsc()) {
+        ktime_tsc_params(&vt->tsc_base, &vt->ns_per_cycle);
+        vt->clock_mode = VTIME_CLOCK_TSC;
+    } else {
+        vt->clock_mode = VTIME_CLOCK_NONE;
+    }
+    vt->ticks = pit_get_ticks();
+    vt->tick_ns = TICK_NSEC;
+    vtime_write_end(vt);
+    
+    // Read-only for everyone but the kernel's own mapping
+    paging_map_page(VTIME_PAGE_ADDR, (uint64_t)vt, PAGE_PRESENT | PAGE_USER);
+    vtime_page = vt;
+    
+    vga_print("[VTIME] Time page at ", VGA_COLOR_LIGHT_GREEN);
+    vga_print_hex(VTIME_PAGE_ADDR);
+    vga_print(vt->clock_mode == VTIME_CLOCK_TSC ? " (tsc)\n" : " (no tsc - syscall fallback)\n",
+              VGA_COLOR_LIGHT_GREEN);
+}
+
+void vtime_update(void) {
+    vtime_page_t* vt = vtime_page;
+    if (!vt) {
+        return;
+    }
+    
+    vtime_write_begin(vt);
+    vt->ticks = pit_get_ticks();
+    vtime_write_end(vt);
+}
@@ -0,0 +1,86 @@
+#ifndef KERNEL_TIME_VTIME_H
+#define KERNEL_TIME_VTIME_H
+
+#include <stdint.h>
+#include "../arch/x86_64/cpu.h"
+#include "../proc/syscall.h"
+
+// Time page: one read-only page, mapped user-accessible at
+// VTIME_PAGE_ADDR, from which user code reads the monotonic clock with
+// an rdtsc and a few loads instead of a system call. It sits in the
+// kernel half of the address space, which paging_create_address_space()
+// shares with every new address space (like the x86-64 vsyscall page).
+// The kernel writes it through its own mapping, from the tick path.
+
+#define VTIME_PAGE_ADDR 0xFFFFFFFFFF5FF000ULL
+
+// Clock modes
+#define VTIME_CLOCK_NONE 0   // Not the TSC: user code asks the kernel
+#define VTIME_CLOCK_TSC  1   // ns = ((rdtsc - tsc_base) * ns_per_cycle) >> 32
+
+typedef struct {
+    volatile uint32_t seq;   // Odd while an update is in progress
+    uint32_t clock_mode;     // VTIME_CLOCK_*
+    uint64_t tsc_base;       // TSC at ktime 0
+    uint64_t ns_per_cycle;   // 32.32 fixed point
+    uint64_t ticks;          // Global tick count (pit_get_ticks)
+    uint64_t tick_ns;        // Length of a tick
+} vtime_page_t;
+
+// Allocate and map the page, publish the clock parameters (after
+// ktime_init)
+void vtime_init(void);
+
+// Publish the tick count (CPU 0's tick path, the only writer)
+void vtime_update(void);
+
+// Sequence-counter read loop: retry while the kernel is mid-update
+static inline uint32_t vtime_read_begin(const volatile vtime_page_t* vt) {
+    uint32_t seq;
+    while ((seq = vt->seq) & 1) {
+        cpu_relax();
+    }
+    __asm__ volatile("" : : : "memory");
+    return seq;
+}
+
+static inline int vtime_read_retry(const volatile vtime_page_t* vt, uint32_t seq) {
+    __asm__ volatile("" : : : "memory");
+    return vt->seq != seq;
+}
+
+// Monotonic nanoseconds, same clock as ktime_get_ns() (usable from
+// USER_TEXT; falls back to SYS_CLOCK_NS without a TSC clock)
+static inline uint64_t vtime_get_ns(void) {
+    const volatile vtime_page_t* vt = (const volatile vtime_page_t*)VTIME_PAGE_ADDR;
+    uint64_t base, mult, tsc;
+    uint32_t seq;
+    
+    do {
+        seq = vtime_read_begin(vt);
+        if (vt->clock_mode != VTIME_CLOCK_TSC) {
+            return (uint64_t)syscall0(SYS_CLOCK_NS);
+        }
+        base = vt->tsc_base;
+        mult = vt->ns_per_cycle;
+        tsc = rdtsc();
+    } while (vtime_read_retry(vt, seq));
+    
+    return (uint64_t)(((unsigned __int128)(tsc - base) * mult) >> 32);
+}
+
+// Global tick count, as last published
+static inline uint64_t vtime_get_ticks(void) {
+    const volatile vtime_page_t* vt = (const volatile vtime_page_t*)VTIME_PAGE_ADDR;
+    uint64_t ticks;
+    uint32_t seq;
+    
+    do {
+        seq = vtime_read_begin(vt);
+        ticks = vt->ticks;
+    } while (vtime_read_retry(vt, seq));
+    
+    return ticks;
+}
+
+#endif // KERNEL_TIME_VTIME_H
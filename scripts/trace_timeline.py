@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+"""Convert a BlitzOS scheduler trace (serial log) to Chrome trace JSON.
+
+Capture:  make run-serial > trace.log
+Convert:  scripts/trace_timeline.py trace.log > trace.json
+View:     chrome://tracing or https://ui.perfetto.dev
+
+Only "T <cpu> <tsc> <event> <pid> <arg>" lines are used; everything else
+in the log is ignored. Timestamps are raw TSC cycles (pass --mhz to scale
+them to microseconds).
+"""
+
+import argparse
+import json
+import sys
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", nargs="?", default="-")
+    parser.add_argument("--mhz", type=float, default=1.0,
+                        help="TSC frequency in MHz (default: 1, raw cycles)")
+    args = parser.parse_args()
+
+    src = sys.stdin if args.log == "-" else open(args.log, errors="replace")
+    events = []
+    for line in src:
+        parts = line.split()
+        if len(parts) != 6 or parts[0] != "T":
+            continue
+        cpu, tsc, name, pid, arg = int(parts[1]), int(parts[2]), parts[3], int(parts[4]), int(parts[5])
+        events.append((tsc, cpu, name, pid, arg))
+    events.sort()
+
+    out = []
+    running = {}  # cpu -> (pid, start tsc)
+    for tsc, cpu, name, pid, arg in events:
+        ts = tsc / args.mhz
+        if name == "in":
+            running[cpu] = (pid, ts)
+        elif name == "out" and cpu in running:
+            run_pid, start = running.pop(cpu)
+            out.append({"name": "pid %d" % run_pid, "ph": "X", "pid": 0, "tid": cpu,
+                        "ts": start, "dur": ts - start, "args": {"state": arg}})
+        elif name in ("wake", "expire", "tick", "throttle"):
+            out.append({"name": "%s %d" % (name, pid), "ph": "i", "s": "t", "pid": 0,
+                        "tid": cpu, "ts": ts, "args": {"arg": arg}})
+
+    for cpu in sorted({e[1] for e in events}):
+        out.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": cpu,
+                    "args": {"name": "CPU %d" % cpu}})
+
+    json.dump({"traceEvents": out}, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()